@@ -3,9 +3,11 @@
 #include <vector>
 
 #include "sm_api.h"
+#include "sh_vrt.h"
 
 // This example is identical to sm_example_iq_stream() except it sets the data type to
 //  16-bit complex shorts, and performs the conversion to 32-bit floats
+//  with vrtUnpack16sc (build with include/sh_vrt.cpp)
 
 void sm_example_iq_stream_16sc()
 {
@@ -61,12 +63,10 @@ void sm_example_iq_stream_16sc()
         status = smGetIQ(handle, &iqBuf16sc[0], bufLen, 0, 0, 0, smFalse, 0, 0);
 
         // Convert to float, I/Q data is interleaved, apply the same logic to all re/im samples.
-        for(int i = 0; i < iqBuf16sc.size(); i++) {
-            // Convert to floats in the range [-1.0, 1.0]
-            iqBuf32fc[i] = (((float)iqBuf16sc[i]) / 32768.0);
-            // Apply correction.
-            iqBuf32fc[i] *= iqCorrection;
-        }
+        // Equivalent to iqBuf32fc[i] = iqBuf16sc[i] / 32768.0 * iqCorrection, which
+        //   converts to floats in the range [-1.0, 1.0] and applies the correction,
+        //   vectorized with SSSE3/AVX2/AVX-512.
+        vrtUnpack16sc(&iqBuf16sc[0], &iqBuf32fc[0], (uint32_t)iqBuf16sc.size(), iqCorrection);
 
         // Process data here
 
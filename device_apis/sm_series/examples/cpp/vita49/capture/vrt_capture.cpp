@@ -0,0 +1,452 @@
+#include "vrt_capture.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t VRT_CAPTURE_PAGE_BYTES = 4096;
+// Timestamp gaps longer than this are treated as a restart of the stream and
+//   are not waited out during paced playback
+static const int64_t VRT_CAPTURE_MAX_GAP_PS = 1000000000000ll;
+
+// Writes all bytes at offset, retrying short writes
+static bool writeAll(int fd, const void *src, size_t bytes, uint64_t offset)
+{
+    const uint8_t *curr = (const uint8_t*)src;
+    while(bytes > 0) {
+        ssize_t r = pwrite(fd, curr, bytes, (off_t)offset);
+        if(r < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        curr += r;
+        bytes -= r;
+        offset += r;
+    }
+    return true;
+}
+
+// Every entry must lie within the packet data, Packet and Next read the words
+//   without further checks
+static bool indexIsValid(const VRTCaptureIndexEntry *index, uint64_t count, uint64_t dataWords)
+{
+    for(uint64_t i = 0; i < count; i++) {
+        if(index[i].size == 0 || index[i].offset > dataWords ||
+           index[i].size > dataWords - index[i].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+VRTCaptureRecorder::VRTCaptureRecorder() :
+    fd(-1),
+    directIO(false),
+    failed(false),
+    buffer(nullptr),
+    bufferBytes(0),
+    bufferUsed(0),
+    dataBytes(0),
+    dataPacketCount(0),
+    contextPacketCount(0)
+{
+    path[0] = '\0';
+}
+
+VRTCaptureRecorder::~VRTCaptureRecorder()
+{
+    Close();
+}
+
+bool VRTCaptureRecorder::Open(const char *path, uint32_t bufferBytes, bool directIO)
+{
+    Close();
+    if(!path || strlen(path) >= sizeof(this->path) || bufferBytes == 0) {
+        return false;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    fd = directIO ? open(path, flags | O_DIRECT, 0644) : -1;
+    if(fd < 0) {
+        // Not every file system supports direct I/O, e.g. tmpfs
+        directIO = false;
+        fd = open(path, flags, 0644);
+    }
+    if(fd < 0) {
+        return false;
+    }
+
+    this->bufferBytes = (bufferBytes + VRT_CAPTURE_PAGE_BYTES - 1) & ~(VRT_CAPTURE_PAGE_BYTES - 1);
+    if(posix_memalign((void**)&buffer, VRT_CAPTURE_PAGE_BYTES, this->bufferBytes) != 0) {
+        buffer = nullptr;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    // Header without an index for now, so the player recognizes the file even if
+    //   the recording never finishes. Written as a whole page for direct I/O.
+    VRTCaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VRT_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = VRT_CAPTURE_VERSION;
+    header.headerBytes = sizeof(header);
+    header.dataOffset = VRT_CAPTURE_DATA_OFFSET;
+    memset(buffer, 0, VRT_CAPTURE_DATA_OFFSET);
+    memcpy(buffer, &header, sizeof(header));
+    if(!writeAll(fd, buffer, VRT_CAPTURE_DATA_OFFSET, 0)) {
+        free(buffer);
+        buffer = nullptr;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    strcpy(this->path, path);
+    this->directIO = directIO;
+    failed = false;
+    bufferUsed = 0;
+    dataBytes = 0;
+    dataPacketCount = 0;
+    contextPacketCount = 0;
+    index.clear();
+
+    return true;
+}
+
+bool VRTCaptureRecorder::Flush(bool final)
+{
+    if(bufferUsed == 0) {
+        return true;
+    }
+
+    // Only the last write can be partial, direct I/O needs it padded to a page
+    uint32_t bytes = bufferUsed;
+    if(directIO && final) {
+        bytes = (bytes + VRT_CAPTURE_PAGE_BYTES - 1) & ~(VRT_CAPTURE_PAGE_BYTES - 1);
+        memset(buffer + bufferUsed, 0, bytes - bufferUsed);
+    }
+
+    uint64_t offset = VRT_CAPTURE_DATA_OFFSET + dataBytes - bufferUsed;
+    if(!writeAll(fd, buffer, bytes, offset)) {
+        failed = true;
+    }
+    bufferUsed = 0;
+
+    return !failed;
+}
+
+uint32_t VRTCaptureRecorder::Write(const uint32_t *words, uint32_t wordCount)
+{
+    if(fd < 0 || failed || !words) {
+        return 0;
+    }
+
+    uint32_t covered = vrtIndexPackets(words, wordCount, blobIndex);
+
+    uint64_t base = dataBytes / sizeof(uint32_t);
+    for(const VRTPacketIndexEntry &entry : blobIndex) {
+        VRTCaptureIndexEntry out;
+        out.offset = base + entry.offset;
+        out.size = entry.size;
+        out.type = entry.type;
+        index.push_back(out);
+
+        if(entry.type == smVRTDataPacket) {
+            dataPacketCount++;
+        } else if(entry.type == smVRTContextPacket) {
+            contextPacketCount++;
+        }
+    }
+
+    const uint8_t *src = (const uint8_t*)words;
+    uint64_t remaining = (uint64_t)covered * sizeof(uint32_t);
+    while(remaining > 0) {
+        uint32_t n = (uint32_t)std::min<uint64_t>(remaining, bufferBytes - bufferUsed);
+        memcpy(buffer + bufferUsed, src, n);
+        bufferUsed += n;
+        dataBytes += n;
+        src += n;
+        remaining -= n;
+
+        if(bufferUsed == bufferBytes && !Flush(false)) {
+            return 0;
+        }
+    }
+
+    return covered;
+}
+
+bool VRTCaptureRecorder::Close()
+{
+    if(fd < 0) {
+        return false;
+    }
+
+    Flush(true);
+
+    if(directIO) {
+        // The index and header are not page aligned, continue without O_DIRECT
+        close(fd);
+        fd = open(path, O_WRONLY);
+        if(fd < 0) {
+            failed = true;
+        }
+    }
+
+    if(fd >= 0) {
+        // Remove the padding of the last direct write
+        uint64_t dataEnd = VRT_CAPTURE_DATA_OFFSET + dataBytes;
+        if(ftruncate(fd, (off_t)dataEnd) != 0) {
+            failed = true;
+        }
+
+        uint64_t indexOffset = (dataEnd + 7) & ~7ull;
+        if(!index.empty() &&
+           !writeAll(fd, index.data(), index.size() * sizeof(VRTCaptureIndexEntry), indexOffset)) {
+            failed = true;
+        }
+
+        // Written last, so a header with an index offset always has a complete index
+        VRTCaptureFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, VRT_CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = VRT_CAPTURE_VERSION;
+        header.headerBytes = sizeof(header);
+        header.dataOffset = VRT_CAPTURE_DATA_OFFSET;
+        header.dataBytes = dataBytes;
+        header.indexOffset = index.empty() ? 0 : indexOffset;
+        header.packetCount = index.size();
+        header.dataPacketCount = dataPacketCount;
+        header.contextPacketCount = contextPacketCount;
+        if(!writeAll(fd, &header, sizeof(header), 0)) {
+            failed = true;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    free(buffer);
+    buffer = nullptr;
+    index.clear();
+    index.shrink_to_fit();
+
+    return !failed;
+}
+
+VRTCapturePlayer::VRTCapturePlayer() :
+    fd(-1),
+    base(nullptr),
+    mappedBytes(0),
+    data(nullptr),
+    dataWords(0),
+    index(nullptr),
+    indexCount(0),
+    rebuiltIndex(false),
+    next(0),
+    speed(0.0),
+    clockStarted(false),
+    firstPs(0),
+    lastPs(0)
+{
+}
+
+VRTCapturePlayer::~VRTCapturePlayer()
+{
+    Close();
+}
+
+bool VRTCapturePlayer::Open(const char *path)
+{
+    Close();
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(uint32_t)) {
+        Close();
+        return false;
+    }
+    mappedBytes = (size_t)st.st_size;
+
+    void *mapped = mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    base = (uint8_t*)mapped;
+    madvise(base, mappedBytes, MADV_SEQUENTIAL);
+
+    const VRTCaptureFileHeader *header = (const VRTCaptureFileHeader*)base;
+    if(mappedBytes >= sizeof(VRTCaptureFileHeader) &&
+       memcmp(header->magic, VRT_CAPTURE_MAGIC, sizeof(header->magic)) == 0) {
+        if(header->version != VRT_CAPTURE_VERSION || header->dataOffset > mappedBytes ||
+           header->dataOffset % sizeof(uint32_t) != 0) {
+            Close();
+            return false;
+        }
+        data = (const uint32_t*)(base + header->dataOffset);
+
+        // The index must follow the data, with every entry in the file. Each
+        //   difference is taken only after the comparison which keeps it from
+        //   wrapping.
+        bool layoutValid = header->indexOffset != 0 && header->indexOffset % 8 == 0 &&
+            header->indexOffset <= mappedBytes &&
+            header->dataBytes <= mappedBytes - header->dataOffset &&
+            header->indexOffset >= header->dataOffset &&
+            header->indexOffset - header->dataOffset >= header->dataBytes &&
+            header->packetCount <= (mappedBytes - header->indexOffset) / sizeof(VRTCaptureIndexEntry);
+        const VRTCaptureIndexEntry *stored = layoutValid ?
+            (const VRTCaptureIndexEntry*)(base + header->indexOffset) : nullptr;
+
+        if(layoutValid && indexIsValid(stored, header->packetCount, header->dataBytes / sizeof(uint32_t))) {
+            dataWords = header->dataBytes / sizeof(uint32_t);
+            index = stored;
+            indexCount = header->packetCount;
+        } else if(layoutValid) {
+            // Damaged index, the data itself is still bounded by the header
+            dataWords = header->dataBytes / sizeof(uint32_t);
+        } else {
+            // Interrupted recording, the data runs to the end of the file
+            dataWords = (mappedBytes - header->dataOffset) / sizeof(uint32_t);
+        }
+    } else {
+        // Raw packets without a container, e.g. smGetVrtPackets output dumped to disk
+        data = (const uint32_t*)base;
+        dataWords = mappedBytes / sizeof(uint32_t);
+    }
+
+    if(!index) {
+        // vrtIndexPackets counts words with 32 bits, index the data in sections
+        std::vector<VRTPacketIndexEntry> section;
+        uint64_t offset = 0;
+        while(offset < dataWords) {
+            uint32_t n = (uint32_t)std::min<uint64_t>(dataWords - offset, 1u << 30);
+            uint32_t covered = vrtIndexPackets(data + offset, n, section);
+            for(const VRTPacketIndexEntry &entry : section) {
+                VRTCaptureIndexEntry out;
+                out.offset = offset + entry.offset;
+                out.size = entry.size;
+                out.type = entry.type;
+                ownIndex.push_back(out);
+            }
+            // A packet may straddle the end of a section, but not the end of the data
+            if(covered == 0 || (covered < n && offset + n == dataWords)) {
+                break;
+            }
+            offset += covered;
+        }
+        index = ownIndex.data();
+        indexCount = ownIndex.size();
+        rebuiltIndex = true;
+    }
+
+    Rewind();
+
+    return true;
+}
+
+void VRTCapturePlayer::Close()
+{
+    if(base) {
+        munmap(base, mappedBytes);
+        base = nullptr;
+    }
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    mappedBytes = 0;
+    data = nullptr;
+    dataWords = 0;
+    index = nullptr;
+    indexCount = 0;
+    rebuiltIndex = false;
+    ownIndex.clear();
+    next = 0;
+}
+
+void VRTCapturePlayer::SetPacing(double speed)
+{
+    this->speed = (speed > 0.0) ? speed : 0.0;
+    clockStarted = false;
+}
+
+void VRTCapturePlayer::Rewind()
+{
+    next = 0;
+    clockStarted = false;
+}
+
+VRTCapturePacket VRTCapturePlayer::Packet(uint64_t i) const
+{
+    VRTCapturePacket pkt;
+    pkt.words = data + index[i].offset;
+    pkt.wordCount = index[i].size;
+    pkt.type = (SmVRTPacketType)index[i].type;
+    return pkt;
+}
+
+int64_t VRTCapturePlayer::PacketTimePs(const uint32_t *words) const
+{
+    uint32_t seconds = swapWord(words[2]);
+    uint64_t picoseconds = ((uint64_t)swapWord(words[3]) << 32) | swapWord(words[4]);
+    return (int64_t)seconds * 1000000000000ll + (int64_t)picoseconds;
+}
+
+int VRTCapturePlayer::Next(VRTCapturePacket *packets, int maxCount)
+{
+    if(!base || !packets || maxCount <= 0) {
+        return 0;
+    }
+
+    int count = 0;
+    while(count < maxCount && next < indexCount) {
+        VRTCapturePacket pkt = Packet(next);
+
+        if(speed > 0.0 && pkt.type != smVRTInvalidPacket &&
+           pkt.wordCount >= sizeof(VRTDataPktMetadata) / sizeof(uint32_t)) {
+            int64_t t = PacketTimePs(pkt.words);
+            if(!clockStarted) {
+                firstPs = lastPs = t;
+                startTime = std::chrono::steady_clock::now();
+                clockStarted = true;
+            }
+
+            // Packets going back in time are sent immediately, a jump forward past
+            //   the limit shifts the clock so the stream continues without a pause
+            if(t - lastPs > VRT_CAPTURE_MAX_GAP_PS) {
+                firstPs += t - lastPs;
+            }
+            lastPs = std::max(lastPs, t);
+
+            auto due = startTime + std::chrono::nanoseconds(
+                (int64_t)((lastPs - firstPs) * 1.0e-3 / speed));
+            if(due > std::chrono::steady_clock::now()) {
+                // Wait for the first packet, return the others once they are due
+                if(count > 0) {
+                    break;
+                }
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        packets[count++] = pkt;
+        next++;
+    }
+
+    return count;
+}
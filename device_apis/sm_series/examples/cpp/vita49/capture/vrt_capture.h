@@ -0,0 +1,166 @@
+#ifndef VRT_CAPTURE_H
+#define VRT_CAPTURE_H
+
+// VRT capture files, raw smGetVrtPackets output with a packet index.
+// Linux only, the player maps the file with mmap.
+//
+// File layout:
+//   VRTCaptureFileHeader, padded to VRT_CAPTURE_DATA_OFFSET bytes
+//   Packets, big endian words exactly as returned by the API
+//   Index, one VRTCaptureIndexEntry per packet, 8 byte aligned
+// The header and index are written when the recording is closed. A file whose
+//   recording was interrupted has no index, the player rebuilds it from the
+//   packet headers.
+
+#include "sh_vrt.h"
+
+#include <chrono>
+
+#define VRT_CAPTURE_MAGIC "SHVRTCAP"
+#define VRT_CAPTURE_VERSION (1)
+// Start of the packet data, one page so the data stays aligned for O_DIRECT
+#define VRT_CAPTURE_DATA_OFFSET (4096)
+
+// All fields little endian
+typedef struct VRTCaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes; // sizeof(VRTCaptureFileHeader)
+    uint64_t dataOffset; // Bytes from the start of the file
+    uint64_t dataBytes;
+    uint64_t indexOffset; // Bytes from the start of the file, 0 if there is no index
+    uint64_t packetCount;
+    uint64_t dataPacketCount;
+    uint64_t contextPacketCount;
+} VRTCaptureFileHeader;
+
+typedef struct VRTCaptureIndexEntry {
+    uint64_t offset; // Words from the start of the packet data
+    uint32_t size; // Words
+    uint32_t type; // SmVRTPacketType
+} VRTCaptureIndexEntry;
+
+// One packet of a capture, a view into the mapped file
+typedef struct VRTCapturePacket {
+    // Big endian VRT words
+    const uint32_t *words;
+    uint32_t wordCount;
+    SmVRTPacketType type;
+} VRTCapturePacket;
+
+// Writes a capture file.
+// Packets are copied into a large page aligned buffer which is written to disk
+//   with one write call each time it fills, so the device thread only pays for
+//   the copy. With direct I/O the page cache is bypassed as well, which keeps
+//   long recordings from evicting everything else.
+//
+// Example:
+//   recorder.Open("capture.vrt");
+//   while(...) {
+//       smGetVrtPackets(handle, words, &wordCount, packetCount, smFalse);
+//       recorder.Write(words, wordCount);
+//   }
+//   recorder.Close();
+class VRTCaptureRecorder
+{
+public:
+    VRTCaptureRecorder();
+    ~VRTCaptureRecorder();
+
+    // bufferBytes = size of the write buffer, rounded up to whole pages
+    // directIO = open the file with O_DIRECT
+    bool Open(const char *path, uint32_t bufferBytes = 16 << 20, bool directIO = false);
+    // Flushes the buffer, then writes the index and the header.
+    // Returns false if any write failed.
+    bool Close();
+    bool IsOpen() const { return fd >= 0; }
+
+    // Records a blob of whole big endian packets, e.g. from smGetVrtPackets or
+    //   smGetVrtContextPkt.
+    // Returns the number of words recorded. This is less than wordCount if the blob
+    //   ends in a truncated packet, pass the rest again with the following words.
+    //   Returns 0 after a write error.
+    uint32_t Write(const uint32_t *words, uint32_t wordCount);
+
+    uint64_t PacketCount() const { return index.size(); }
+    uint64_t DataBytes() const { return dataBytes; }
+
+private:
+    bool Flush(bool final);
+
+    int fd;
+    bool directIO;
+    bool failed;
+    char path[1024];
+
+    uint8_t *buffer;
+    uint32_t bufferBytes;
+    uint32_t bufferUsed;
+
+    uint64_t dataBytes;
+    uint64_t dataPacketCount;
+    uint64_t contextPacketCount;
+    std::vector<VRTCaptureIndexEntry> index;
+    std::vector<VRTPacketIndexEntry> blobIndex;
+};
+
+// Plays back a capture file from memory.
+// The file is mapped read only, packets are handed out as views into the
+//   mapping and are never copied.
+// With pacing enabled each packet is delivered when its VRT timestamp, relative
+//   to the first packet, comes due on the wall clock, scaled by the speed. This
+//   reproduces the timing of the original stream, or a multiple of it.
+class VRTCapturePlayer
+{
+public:
+    VRTCapturePlayer();
+    ~VRTCapturePlayer();
+
+    bool Open(const char *path);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    // speed = 0 to deliver packets as fast as they are read, 1 for the original
+    //   rate, 2 for twice the original rate, etc.
+    void SetPacing(double speed);
+    // Starts over with the first packet, restarts the pacing clock
+    void Rewind();
+
+    // Delivers the next packets, up to maxCount. With pacing, waits until the next
+    //   packet is due, then returns it and the packets following it which are due.
+    // Returns the number of packets, 0 at the end of the file.
+    int Next(VRTCapturePacket *packets, int maxCount);
+
+    // Random access to the whole capture
+    uint64_t PacketCount() const { return indexCount; }
+    VRTCapturePacket Packet(uint64_t i) const;
+    // All packet data as one blob, e.g. for VRTBlobParser
+    const uint32_t *Words() const { return data; }
+    uint64_t WordCount() const { return dataWords; }
+    // False if the index was rebuilt, because the recording was interrupted or the
+    //   stored index failed its checks
+    bool HasIndex() const { return !rebuiltIndex; }
+
+private:
+    int64_t PacketTimePs(const uint32_t *words) const;
+
+    int fd;
+    uint8_t *base;
+    size_t mappedBytes;
+
+    const uint32_t *data;
+    uint64_t dataWords;
+    const VRTCaptureIndexEntry *index;
+    uint64_t indexCount;
+    bool rebuiltIndex;
+    std::vector<VRTCaptureIndexEntry> ownIndex;
+
+    uint64_t next;
+    double speed;
+    bool clockStarted;
+    int64_t firstPs;
+    int64_t lastPs;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif // VRT_CAPTURE_H
@@ -0,0 +1,198 @@
+/*
+ *  Records VRT packets from an SM Series device to a capture file, and plays a
+ *  capture back through the parser without hardware.
+ *
+ *  vrt_capture record file.vrt [seconds]
+ *  vrt_capture play file.vrt [speed] [loops]
+ *  vrt_capture bench [words]
+ *
+ *  speed = 0 to replay as fast as possible, 1 for the rate of the recording
+ *  bench times the byte swap and sample unpack of packets of this many words, to
+ *  check the host keeps up with the stream before recording
+ */
+
+#include "vrt_capture.h"
+#include "vrt_parser.h"
+#include "vrt_integrity.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+static int record(const char *path, double seconds)
+{
+    int device = -1;
+    SmStatus status = smOpenDevice(&device); // USB
+    //SmStatus status = smOpenNetworkedDevice(&device, SM_ADDR_ANY, SM_DEFAULT_ADDR, SM_DEFAULT_PORT); // Networked
+    if(status != smNoError) {
+        printf("Unable to open device\n");
+        return -1;
+    }
+
+    smSetIQCenterFreq(device, 3.0e9);
+    smSetIQSampleRate(device, 1);
+    smSetIQBandwidth(device, smTrue, 20.0e6);
+    smSetRefLevel(device, -20);
+
+    smSetVrtPacketSize(device, 16384);
+    smSetVrtStreamID(device, 1);
+
+    status = smConfigure(device, smModeIQStreaming); // VRT mode
+    if(status != smNoError) {
+        printf("Unable to configure device\n");
+        smCloseDevice(device);
+        return -1;
+    }
+
+    uint32_t contextWordCount = 0;
+    uint32_t dataWordCount = 0;
+    uint16_t samplesPerPacket = 0;
+    smGetVrtContextPktSize(device, &contextWordCount);
+    smGetVrtPacketSize(device, &samplesPerPacket, &dataWordCount);
+
+    // One context packet ahead of every block of data packets
+    const uint32_t dataPacketsPerBlock = 64;
+    std::vector<uint32_t> words(contextWordCount + dataWordCount * dataPacketsPerBlock);
+
+    double sampleRate = 0.0;
+    smGetIQParameters(device, &sampleRate, nullptr);
+    uint64_t blocks = (uint64_t)(seconds * sampleRate / ((double)samplesPerPacket * dataPacketsPerBlock)) + 1;
+
+    VRTCaptureRecorder recorder;
+    if(!recorder.Open(path)) {
+        printf("Unable to create %s\n", path);
+        smCloseDevice(device);
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < blocks; i++) {
+        uint32_t contextWords = 0, dataWords = 0;
+        status = smGetVrtContextPkt(device, &words[0], &contextWords);
+        if(status != smNoError) {
+            break;
+        }
+        status = smGetVrtPackets(device, &words[contextWords], &dataWords, dataPacketsPerBlock, smFalse);
+        if(status != smNoError) {
+            break;
+        }
+        if(recorder.Write(&words[0], contextWords + dataWords) != contextWords + dataWords) {
+            printf("Write failed\n");
+            break;
+        }
+    }
+
+    smCloseDevice(device);
+
+    uint64_t packetCount = recorder.PacketCount();
+    uint64_t dataBytes = recorder.DataBytes();
+    if(!recorder.Close()) {
+        printf("Unable to finish %s\n", path);
+        return -1;
+    }
+    printf("Recorded %llu packets, %llu bytes\n",
+           (unsigned long long)packetCount, (unsigned long long)dataBytes);
+
+    return 0;
+}
+
+static int play(const char *path, double speed, int loops)
+{
+    VRTCapturePlayer player;
+    if(!player.Open(path)) {
+        printf("Unable to open %s\n", path);
+        return -1;
+    }
+    if(!player.HasIndex()) {
+        printf("No index, rebuilt from the packet headers\n");
+    }
+    player.SetPacing(speed);
+
+    VRTParser parser;
+    VRTDataPktView dataPkt;
+    VRTUserContextPkt contextPkt;
+    VRTIntegrityMonitor monitor;
+    std::vector<float> iq;
+    VRTCapturePacket packets[64];
+    uint64_t dataPackets = 0, contextPackets = 0, samples = 0, bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int loop = 0; loop < loops; loop++) {
+        player.Rewind();
+        // Each loop replays the same timestamps
+        monitor.Reset();
+
+        int count;
+        while((count = player.Next(packets, 64)) > 0) {
+            for(int i = 0; i < count; i++) {
+                const VRTCapturePacket &pkt = packets[i];
+                bytes += pkt.wordCount * sizeof(uint32_t);
+                if(pkt.type == smVRTDataPacket &&
+                   parser.ParseDataPacket(pkt.words, pkt.wordCount, dataPkt) > 0) {
+                    iq.resize(dataPkt.sampleCount * 2);
+                    parser.UnpackSamples(dataPkt, iq.data());
+                    monitor.OnDataPacket(dataPkt);
+                    dataPackets++;
+                    samples += dataPkt.sampleCount;
+                } else if(pkt.type == smVRTContextPacket &&
+                          parser.ParseContextPacket(pkt.words, pkt.wordCount, contextPkt) > 0) {
+                    monitor.OnContextPacket(contextPkt);
+                    contextPackets++;
+                }
+            }
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const VRTIntegrityCounters &integrity = monitor.Counters();
+    printf("%llu data packets, %llu context packets in %.3f s\n",
+           (unsigned long long)dataPackets, (unsigned long long)contextPackets, elapsed);
+    printf("%.0f packets/s, %.2f GB/s, %.1f MS/s\n", (dataPackets + contextPackets) / elapsed,
+           bytes / elapsed * 1.0e-9, samples / elapsed * 1.0e-6);
+    printf("Last loop: dropped packets %llu, timestamp jumps %llu\n",
+           (unsigned long long)integrity.droppedPackets, (unsigned long long)integrity.timestampJumps);
+
+    return 0;
+}
+
+static int bench(uint32_t wordCount)
+{
+    VrtSwapBenchmarkResult results[4];
+    int count = vrtBenchmarkSwapBytes(wordCount, 0.5, results);
+    if(count <= 0) {
+        printf("Unable to run the benchmark\n");
+        return -1;
+    }
+
+    printf("Packets of %u words\n", wordCount);
+    for(int i = 0; i < count; i++) {
+        printf("%-8s swap in place %6.2f GB/s, swap copy %6.2f GB/s, unpack %6.2f GB/s%s\n",
+               results[i].name, results[i].inPlaceGBps, results[i].copyGBps, results[i].unpackGBps,
+               (results[i].isa == vrtGetSwapIsa()) ? " (selected)" : "");
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int words = (argc > 2) ? atoi(argv[2]) : 16384;
+        return bench((words > 0) ? (uint32_t)words : 16384);
+    }
+
+    if(argc < 3) {
+        printf("vrt_capture record file.vrt [seconds]\n");
+        printf("vrt_capture play file.vrt [speed] [loops]\n");
+        printf("vrt_capture bench [words]\n");
+        return -1;
+    }
+
+    if(strcmp(argv[1], "record") == 0) {
+        return record(argv[2], (argc > 3) ? atof(argv[3]) : 10.0);
+    }
+    if(strcmp(argv[1], "play") == 0) {
+        return play(argv[2], (argc > 3) ? atof(argv[3]) : 0.0, (argc > 4) ? atoi(argv[4]) : 1);
+    }
+
+    printf("Unknown command %s\n", argv[1]);
+    return -1;
+}
@@ -265,7 +265,11 @@ int Central::ParseBlob(VRTParser &parser, uint32_t *words, uint32_t wordCount,
 {
     uint32_t *curr = words;
     while(curr - words < wordCount) {
-        curr += ParsePacket(parser, curr, parsedContextPackets, parsedDataPackets);
+        int size = ParsePacket(parser, curr, parsedContextPackets, parsedDataPackets);
+        if(size <= 0) {
+            break;
+        }
+        curr += size;
     }
     return curr - words;
 }
@@ -278,13 +282,24 @@ int Central::ParsePacket(VRTParser &parser, uint32_t *pkt,
     uint32_t packetSize;
     parser.Peek(pkt, &packetType, &packetSize);
 
+    // Parsed in place to avoid copying the packet, the entry is removed again if
+    //   the packet is invalid
+    int size;
     switch(packetType) {
     case smVRTDataPacket:
         parsedDataPackets.push_back(VRTUserDataPkt());
-        return parser.ParseDataPacket(pkt, packetSize, parsedDataPackets.back());
+        size = parser.ParseDataPacket(pkt, packetSize, parsedDataPackets.back());
+        if(size <= 0) {
+            parsedDataPackets.pop_back();
+        }
+        return size;
     case smVRTContextPacket:
         parsedContextPackets.push_back(VRTUserContextPkt());
-        return parser.ParseContextPacket(pkt, packetSize, parsedContextPackets.back());
+        size = parser.ParseContextPacket(pkt, packetSize, parsedContextPackets.back());
+        if(size <= 0) {
+            parsedContextPackets.pop_back();
+        }
+        return size;
     default:
         // Memory pointed to is not a valid SM200A VRT packet
         return -1;
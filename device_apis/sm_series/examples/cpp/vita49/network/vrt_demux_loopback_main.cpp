@@ -0,0 +1,159 @@
+/*
+ *  Measures the VRTDemux rate on the loopback interface.
+ *  One sender thread per simulated device replays synthetic VRT packets tagged with
+ *  its own stream ID. The main thread receives every datagram with VRTUdpReceiver
+ *  and routes it with VRTDemux, the demux workers convert each stream with its
+ *  own reference level, and a reader thread drains the output of every stream.
+ *
+ *  vrt_demux_loopback [streams] [workers] [seconds] [port]
+ */
+
+#include "vrt_udp.h"
+#include "vrt_demux.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static const uint32_t SAMPLES_PER_PACKET = 8192;
+static const uint32_t DATA_PACKETS_PER_CONTEXT = 64;
+
+static std::vector<uint32_t> makeStreamPackets(uint32_t streamIdent, float reflevel, int blocks)
+{
+    uint32_t packetSize = SAMPLES_PER_PACKET + 6;
+    std::vector<uint32_t> words;
+    uint32_t dataCount = 0;
+
+    VRTContextFields fields;
+    memset(&fields, 0, sizeof(fields));
+    fields.reference = (uint16_t)vrtConvertFloatToRef(reflevel);
+    fields.sampleRate = vrtConvertFloatToFreq(50.0e6);
+
+    for(int b = 0; b < blocks; b++) {
+        uint32_t context[VRT_MAX_CNTX_PKT_WORDS];
+        uint32_t contextSize = vrtPackContextPacket((uint8_t)b, streamIdent, 0, 0, b == 0, false,
+                                                    fields, context);
+        words.insert(words.end(), context, context + contextSize);
+
+        for(uint32_t i = 0; i < DATA_PACKETS_PER_CONTEXT; i++) {
+            words.push_back(vrtPackDataHeader((uint8_t)dataCount++, (uint16_t)packetSize));
+            words.push_back(streamIdent);
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(0);
+            for(uint32_t s = 0; s < SAMPLES_PER_PACKET; s++) {
+                words.push_back(s);
+            }
+            words.push_back(vrtPackDataTrailer(true, true, true, false, false, 0));
+        }
+    }
+
+    // To network byte order, as sent by the device
+    vrtSwapBytes(&words[0], (uint32_t)words.size());
+
+    return words;
+}
+
+int main(int argc, char **argv)
+{
+    int streamCount = (argc > 1) ? atoi(argv[1]) : 4;
+    int workerCount = (argc > 2) ? atoi(argv[2]) : 2;
+    double seconds = (argc > 3) ? atof(argv[3]) : 5.0;
+    uint16_t port = (argc > 4) ? (uint16_t)atoi(argv[4]) : 4991;
+    if(streamCount < 1) {
+        streamCount = 1;
+    }
+
+    VRTUdpReceiver receiver;
+    if(!receiver.Open(port, "127.0.0.1")) {
+        printf("Unable to open receiver on port %d\n", port);
+        return -1;
+    }
+
+    VRTDemux demux;
+    for(int i = 0; i < streamCount; i++) {
+        demux.AddStream(i + 1, SAMPLES_PER_PACKET + 6);
+    }
+    demux.Start(workerCount);
+
+    // Devices, stream ID i + 1 at a reference level of -10 * i dBm
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<uint32_t>> streamWords(streamCount);
+    std::vector<VRTUdpSender> senders(streamCount);
+    std::vector<std::thread> sendThreads;
+    for(int i = 0; i < streamCount; i++) {
+        streamWords[i] = makeStreamPackets(i + 1, -10.0f * i, 16);
+        if(!senders[i].Open("127.0.0.1", port)) {
+            printf("Unable to open sender\n");
+            return -1;
+        }
+        sendThreads.push_back(std::thread([&, i]() {
+            vrtUdpReplay(senders[i], &streamWords[i][0], (uint32_t)streamWords[i].size(),
+                         1 << 30, &stop);
+        }));
+    }
+
+    // Application side, takes the converted packets of every stream
+    std::vector<uint64_t> samples(streamCount, 0);
+    std::thread readThread([&]() {
+        const VRTDemuxBlock *blocks[64];
+        while(!stop) {
+            int total = 0;
+            for(int i = 0; i < streamCount; i++) {
+                VRTDemuxStream *stream = demux.StreamAt(i);
+                int count = stream->Read(blocks, 64);
+                for(int j = 0; j < count; j++) {
+                    samples[i] += blocks[j]->sampleCount;
+                }
+                stream->Release(count);
+                total += count;
+            }
+            if(total == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<VRTUdpPacket> packets(64);
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    while(elapsed < seconds) {
+        int count = receiver.Receive(&packets[0], 100);
+        if(count < 0) {
+            printf("Receive error\n");
+            break;
+        }
+        for(int i = 0; i < count; i++) {
+            demux.Route(packets[i].words, packets[i].wordCount);
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    stop = true;
+    for(std::thread &t : sendThreads) {
+        t.join();
+    }
+    demux.Stop();
+    readThread.join();
+
+    uint64_t totalSamples = 0;
+    for(int i = 0; i < streamCount; i++) {
+        const VRTDemuxStream *stream = demux.StreamAt(i);
+        const VRTContextCache &context = stream->Context();
+        printf("Stream %u: %llu packets, %.1f MS/s, reflevel %.1f, context decoded %llu skipped %llu, "
+               "input drops %llu, output drops %llu, packet gaps %llu\n",
+               stream->StreamIdent(), (unsigned long long)stream->Packets(),
+               samples[i] / elapsed * 1.0e-6, context.Current()->reflevel,
+               (unsigned long long)context.DecodeCount(), (unsigned long long)context.SkipCount(),
+               (unsigned long long)stream->InputDrops(), (unsigned long long)stream->OutputDrops(),
+               (unsigned long long)stream->Integrity().Counters().droppedPackets);
+        totalSamples += samples[i];
+    }
+    printf("%llu datagrams, %.1f MS/s total, unknown %llu, invalid %llu, kernel drops %llu\n",
+           (unsigned long long)receiver.Datagrams(), totalSamples / elapsed * 1.0e-6,
+           (unsigned long long)demux.UnknownPackets(), (unsigned long long)demux.InvalidPackets(),
+           (unsigned long long)receiver.KernelDrops());
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include "vrt_packetizer.h"
+#include "vrt_udp.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+static const uint64_t VRT_PS_PER_SECOND = 1000000000000ull;
+
+VRTPacketizer::VRTPacketizer()
+{
+    Configure(0, MIN_VRT_DATA_SAMPLES, 1.0, 0, 2);
+}
+
+bool VRTPacketizer::Configure(uint32_t streamIdent, uint32_t samplesPerPacket, double sampleRate,
+                              int contextInterval, int ringPackets)
+{
+    if(samplesPerPacket < MIN_VRT_DATA_SAMPLES || samplesPerPacket > MAX_VRT_DATA_SAMPLES ||
+       !(sampleRate > 0.0) || contextInterval < 0 || ringPackets < 2) {
+        return false;
+    }
+
+    this->streamIdent = streamIdent;
+    this->samplesPerPacket = samplesPerPacket;
+    this->contextInterval = contextInterval;
+
+    // Exact for the SM rates, 50 MS/s divided by a power of two
+    periodPs = 1.0e12 / sampleRate;
+    periodPsInt = (fabs(periodPs - floor(periodPs + 0.5)) < 1.0e-6) ? (uint64_t)floor(periodPs + 0.5) : 0;
+
+    memset(&context, 0, sizeof(context));
+    contextChanged = true;
+    isGPS = false;
+    trailerWord = vrtPackDataTrailer(false, true, false, false, false, 0);
+
+    startSeconds = 0;
+    startPicoseconds = 0;
+    samplesPushed = 0;
+
+    dataCount = 0;
+    contextCount = 0;
+    dataSinceContext = 0;
+
+    payloads.resize((size_t)ringPackets * samplesPerPacket);
+    slots.resize(ringPackets);
+    for(int i = 0; i < ringPackets; i++) {
+        slots[i].payload = &payloads[(size_t)i * samplesPerPacket];
+    }
+    readIndex = 0;
+    readyCount = 0;
+    fillIndex = -1;
+    fillSamples = 0;
+    fillFirstSample = 0;
+
+    return true;
+}
+
+void VRTPacketizer::SetContext(const VRTContextFields &fields, bool isGPS)
+{
+    context = fields;
+    this->isGPS = isGPS;
+    contextChanged = true;
+}
+
+void VRTPacketizer::SetStartTime(uint32_t seconds, uint64_t picoseconds)
+{
+    startSeconds = seconds + (uint32_t)(picoseconds / VRT_PS_PER_SECOND);
+    startPicoseconds = picoseconds % VRT_PS_PER_SECOND;
+    samplesPushed = 0;
+}
+
+void VRTPacketizer::SetTrailer(bool isTimeCalibrated, bool isDataValid, bool isExtRefLocked,
+                               bool isOverrange, bool isSampleLoss)
+{
+    trailerWord = vrtPackDataTrailer(isTimeCalibrated, isDataValid, isExtRefLocked,
+                                     isOverrange, isSampleLoss, 0);
+}
+
+void VRTPacketizer::TimeOfSample(uint64_t sample, uint32_t &seconds, uint64_t &picoseconds) const
+{
+    uint64_t offset = periodPsInt ? sample * periodPsInt : (uint64_t)llround(sample * periodPs);
+    uint64_t total = startPicoseconds + offset;
+    seconds = startSeconds + (uint32_t)(total / VRT_PS_PER_SECOND);
+    picoseconds = total % VRT_PS_PER_SECOND;
+}
+
+void VRTPacketizer::PackContext()
+{
+    Slot &slot = slots[(readIndex + readyCount) % slots.size()];
+
+    uint32_t seconds;
+    uint64_t picoseconds;
+    TimeOfSample(samplesPushed, seconds, picoseconds);
+
+    uint32_t size = vrtPackContextPacket(contextCount++, streamIdent, seconds, picoseconds,
+                                         contextChanged, isGPS, context, slot.header);
+    vrtSwapBytes(slot.header, size);
+
+    slot.out.iov[0].iov_base = slot.header;
+    slot.out.iov[0].iov_len = size * sizeof(uint32_t);
+    slot.out.iovCount = 1;
+    slot.out.wordCount = size;
+    slot.out.isContext = true;
+
+    readyCount++;
+    contextChanged = false;
+    dataSinceContext = 0;
+}
+
+bool VRTPacketizer::BeginPacket()
+{
+    const int ringPackets = (int)slots.size();
+
+    if(contextChanged || (contextInterval > 0 && dataSinceContext >= contextInterval)) {
+        if(readyCount >= ringPackets) {
+            return false;
+        }
+        PackContext();
+    }
+
+    if(readyCount >= ringPackets) {
+        return false;
+    }
+
+    fillIndex = (readIndex + readyCount) % ringPackets;
+    fillSamples = 0;
+    fillFirstSample = samplesPushed;
+
+    return true;
+}
+
+uint32_t VRTPacketizer::Push(const int16_t *iq, uint32_t sampleCount)
+{
+    uint32_t accepted = 0;
+    while(accepted < sampleCount) {
+        if(fillIndex < 0 && !BeginPacket()) {
+            break;
+        }
+
+        // Each IQ pair is one word, swapped straight into the packet payload
+        Slot &slot = slots[fillIndex];
+        uint32_t n = std::min(sampleCount - accepted, samplesPerPacket - fillSamples);
+        vrtSwapBytes((const uint32_t*)(iq + 2 * accepted), slot.payload + fillSamples, n);
+        fillSamples += n;
+        accepted += n;
+        samplesPushed += n;
+
+        if(fillSamples < samplesPerPacket) {
+            continue;
+        }
+
+        uint32_t seconds;
+        uint64_t picoseconds;
+        TimeOfSample(fillFirstSample, seconds, picoseconds);
+
+        uint32_t size = samplesPerPacket + sizeof(VRTDataPktMetadata) / sizeof(uint32_t) + 1;
+        slot.header[0] = swapWord(vrtPackDataHeader(dataCount++, (uint16_t)size));
+        slot.header[1] = swapWord(streamIdent);
+        slot.header[2] = swapWord(seconds);
+        slot.header[3] = swapWord((uint32_t)(picoseconds >> 32));
+        slot.header[4] = swapWord((uint32_t)(picoseconds & 0xFFFFFFFF));
+        slot.trailer = swapWord(trailerWord);
+
+        slot.out.iov[0].iov_base = slot.header;
+        slot.out.iov[0].iov_len = sizeof(VRTDataPktMetadata);
+        slot.out.iov[1].iov_base = slot.payload;
+        slot.out.iov[1].iov_len = samplesPerPacket * sizeof(uint32_t);
+        slot.out.iov[2].iov_base = &slot.trailer;
+        slot.out.iov[2].iov_len = sizeof(uint32_t);
+        slot.out.iovCount = 3;
+        slot.out.wordCount = size;
+        slot.out.isContext = false;
+
+        readyCount++;
+        dataSinceContext++;
+        fillIndex = -1;
+    }
+
+    return accepted;
+}
+
+void VRTPacketizer::Release(int count)
+{
+    count = std::min(std::max(count, 0), readyCount);
+    readIndex = (readIndex + count) % (int)slots.size();
+    readyCount -= count;
+}
+
+int vrtSendPackets(VRTUdpSender &sender, VRTPacketizer &packetizer)
+{
+    // Only the buffer descriptors are gathered, not the packets
+    iovec iov[64 * 3];
+    int iovCounts[64];
+
+    int sent = 0;
+    while(packetizer.ReadyCount() > 0) {
+        int count = std::min(packetizer.ReadyCount(), 64);
+        int iovTotal = 0;
+        for(int i = 0; i < count; i++) {
+            const VRTOutPacket &pkt = packetizer.Ready(i);
+            for(int j = 0; j < pkt.iovCount; j++) {
+                iov[iovTotal++] = pkt.iov[j];
+            }
+            iovCounts[i] = pkt.iovCount;
+        }
+
+        int r = sender.Send(iov, iovCounts, count);
+        packetizer.Release(r);
+        sent += r;
+        if(r < count) {
+            break;
+        }
+    }
+
+    return sent;
+}
+
+int vrtWritePackets(int fd, VRTPacketizer &packetizer)
+{
+    const int maxPackets = IOV_MAX / 3;
+    iovec iov[maxPackets * 3];
+
+    int written = 0;
+    while(packetizer.ReadyCount() > 0) {
+        int count = std::min(packetizer.ReadyCount(), maxPackets);
+        int iovTotal = 0;
+        for(int i = 0; i < count; i++) {
+            const VRTOutPacket &pkt = packetizer.Ready(i);
+            for(int j = 0; j < pkt.iovCount; j++) {
+                iov[iovTotal++] = pkt.iov[j];
+            }
+        }
+
+        // Stream sockets and pipes may take part of the data, continue from there
+        iovec *curr = &iov[0];
+        while(iovTotal > 0) {
+            ssize_t r = writev(fd, curr, iovTotal);
+            if(r < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            while(iovTotal > 0 && (size_t)r >= curr->iov_len) {
+                r -= curr->iov_len;
+                curr++;
+                iovTotal--;
+            }
+            if(iovTotal > 0) {
+                curr->iov_base = (uint8_t*)curr->iov_base + r;
+                curr->iov_len -= r;
+            }
+        }
+
+        packetizer.Release(count);
+        written += count;
+    }
+
+    return written;
+}
@@ -0,0 +1,127 @@
+#ifndef VRT_PACKETIZER_H
+#define VRT_PACKETIZER_H
+
+#include "sh_vrt.h"
+
+#include <sys/uio.h>
+
+class VRTUdpSender;
+
+// One packet ready to send, as a list of buffers
+typedef struct VRTOutPacket {
+    // Header and prologue, payload and trailer for data packets, the whole
+    //   packet for context packets. All big endian.
+    iovec iov[3];
+    int iovCount;
+    uint32_t wordCount;
+    bool isContext;
+} VRTOutPacket;
+
+// Turns a continuous stream of 16-bit IQ samples, e.g. from smGetIQ or bbGetIQ
+//   with the 16sc data type, into VRT data packets with a context packet at a
+//   fixed interval and whenever the context changes.
+// Each packet is handed out as a header, payload and trailer buffer to be sent
+//   with writev/sendmmsg, the parts are never assembled into one buffer. The
+//   payload has to be big endian on the wire, so the samples are byte swapped
+//   once on their way into the packet ring (vrtSwapBytes) and are not copied
+//   again after that.
+// Packets are decoded by VRTParser with the samples in their original order.
+//
+// Example:
+//   packetizer.Configure(1, 8192, 50.0e6, 16);
+//   packetizer.SetContext(fields);
+//   packetizer.SetStartTime(seconds, picoseconds);
+//   while(...) {
+//       smGetIQ(handle, iq, count, ...);
+//       uint32_t done = 0;
+//       while(done < count) {
+//           done += packetizer.Push(iq + 2 * done, count - done);
+//           vrtSendPackets(sender, packetizer);
+//       }
+//   }
+class VRTPacketizer
+{
+public:
+    VRTPacketizer();
+
+    // streamIdent = stream ID of every packet
+    // samplesPerPacket = IQ samples in each data packet, see MAX_VRT_DATA_SAMPLES
+    // sampleRate = used to timestamp each packet from the start time
+    // contextInterval = data packets between context packets, 0 to only send a
+    //   context packet at the start and when SetContext is called
+    // ringPackets = packets buffered between calls to Release
+    bool Configure(uint32_t streamIdent, uint32_t samplesPerPacket, double sampleRate,
+                   int contextInterval, int ringPackets = 64);
+
+    // Context fields of the following context packets, in VRT fixed point, see
+    //   vrtConvertFloatToFreq etc. The next packet out is a context packet with
+    //   the field change bit set.
+    // isGPS = include fields.formattedGps
+    void SetContext(const VRTContextFields &fields, bool isGPS = false);
+    // Time of the next sample pushed, call before the first Push
+    void SetStartTime(uint32_t seconds, uint64_t picoseconds);
+    // Trailer indicators of the following data packets
+    void SetTrailer(bool isTimeCalibrated, bool isDataValid, bool isExtRefLocked,
+                    bool isOverrange, bool isSampleLoss);
+
+    // Adds interleaved int16 IQ samples, little endian (smDataType16sc).
+    // Stops early when the packet ring is full, send and Release the ready packets
+    //   and push the rest.
+    // Returns the number of IQ samples accepted.
+    uint32_t Push(const int16_t *iq, uint32_t sampleCount);
+
+    // Complete packets waiting to be sent, oldest first, valid until released
+    int ReadyCount() const { return readyCount; }
+    const VRTOutPacket &Ready(int i) const { return slots[(readIndex + i) % slots.size()].out; }
+    // Frees the oldest count ready packets once they have been sent
+    void Release(int count);
+
+private:
+    struct Slot {
+        VRTOutPacket out;
+        uint32_t header[VRT_MAX_CNTX_PKT_WORDS];
+        uint32_t *payload;
+        uint32_t trailer;
+    };
+
+    bool BeginPacket();
+    void PackContext();
+    void TimeOfSample(uint64_t sample, uint32_t &seconds, uint64_t &picoseconds) const;
+
+    uint32_t streamIdent;
+    uint32_t samplesPerPacket;
+    double periodPs;
+    uint64_t periodPsInt; // periodPs when it is a whole number, otherwise 0
+    int contextInterval;
+
+    VRTContextFields context;
+    bool contextChanged;
+    bool isGPS;
+    uint32_t trailerWord;
+
+    uint32_t startSeconds;
+    uint64_t startPicoseconds;
+    uint64_t samplesPushed;
+
+    uint8_t dataCount;
+    uint8_t contextCount;
+    int dataSinceContext;
+
+    std::vector<uint32_t> payloads;
+    std::vector<Slot> slots;
+    int readIndex;
+    int readyCount;
+    // Data packet being filled, -1 if none
+    int fillIndex;
+    uint32_t fillSamples;
+    uint64_t fillFirstSample;
+};
+
+// Sends and releases every ready packet, each as one datagram.
+// Returns the number of packets sent.
+int vrtSendPackets(VRTUdpSender &sender, VRTPacketizer &packetizer);
+// Writes and releases every ready packet to a stream socket, pipe or file with
+//   writev. Returns the number of packets written, or -1 on error.
+int vrtWritePackets(int fd, VRTPacketizer &packetizer);
+
+#endif // VRT_PACKETIZER_H
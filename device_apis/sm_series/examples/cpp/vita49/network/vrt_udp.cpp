@@ -0,0 +1,353 @@
+#include "vrt_udp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Largest UDP payload over IPv4
+static const uint32_t VRT_UDP_MAX_BYTES = 65507;
+// Slot size, the largest payload rounded up to whole words
+static const uint32_t VRT_UDP_SLOT_WORDS = (VRT_UDP_MAX_BYTES + 3) / 4;
+// Datagrams per sendmmsg call
+static const int VRT_UDP_SEND_BATCH = 64;
+// Wait after sendmmsg fails with ENOBUFS, and the number of consecutive waits,
+//   about one second, before Send gives up
+static const int VRT_UDP_NOBUFS_WAIT_US = 100;
+static const int VRT_UDP_MAX_NOBUFS_WAITS = 10000;
+
+// Waits for room to send after ENOBUFS. POLLOUT covers a full socket buffer, but
+//   a full device queue has no readiness event, so a short sleep follows when
+//   the socket already reports writable.
+static void vrtUdpWaitForBuffers(int fd)
+{
+    pollfd pfd = { fd, POLLOUT, 0 };
+    if(poll(&pfd, 1, 1) != 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(VRT_UDP_NOBUFS_WAIT_US));
+    }
+}
+
+VRTUdpReceiver::VRTUdpReceiver() :
+    fd(-1),
+    ringPackets(0),
+    batchSize(0),
+    head(0),
+    rcvBufBytes(0),
+    controlWords(0),
+    kernelDrops(0),
+    truncated(0),
+    datagrams(0),
+    bytes(0)
+{
+}
+
+VRTUdpReceiver::~VRTUdpReceiver()
+{
+    Close();
+}
+
+bool VRTUdpReceiver::Open(uint16_t port, const char *bindAddr, int ringPackets,
+                          int batchSize, int rcvBufBytes)
+{
+    Close();
+    if(ringPackets <= 0 || batchSize <= 0) {
+        return false;
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        return false;
+    }
+
+    // Try to bypass rmem_max first, that needs CAP_NET_ADMIN
+    if(setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvBufBytes, sizeof(rcvBufBytes)) != 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBufBytes, sizeof(rcvBufBytes));
+    }
+    socklen_t len = sizeof(this->rcvBufBytes);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &this->rcvBufBytes, &len);
+
+    // Report the number of datagrams dropped with each received datagram
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bindAddr && inet_pton(AF_INET, bindAddr, &addr.sin_addr) != 1) {
+        Close();
+        return false;
+    }
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        Close();
+        return false;
+    }
+
+    this->ringPackets = ringPackets;
+    this->batchSize = batchSize < ringPackets ? batchSize : ringPackets;
+    head = 0;
+
+    // Every slot keeps its own descriptors, built once here
+    slots.resize((size_t)ringPackets * VRT_UDP_SLOT_WORDS);
+    msgs.resize(ringPackets);
+    iovs.resize(ringPackets);
+    controlWords = (CMSG_SPACE(sizeof(uint32_t)) + 7) / 8;
+    control.resize(ringPackets * controlWords);
+    for(int i = 0; i < ringPackets; i++) {
+        iovs[i].iov_base = &slots[(size_t)i * VRT_UDP_SLOT_WORDS];
+        iovs[i].iov_len = VRT_UDP_SLOT_WORDS * sizeof(uint32_t);
+
+        msghdr &hdr = msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &iovs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = &control[i * controlWords];
+        hdr.msg_controllen = controlWords * sizeof(uint64_t);
+    }
+
+    kernelDrops = 0;
+    truncated = 0;
+    datagrams = 0;
+    bytes = 0;
+
+    return true;
+}
+
+void VRTUdpReceiver::Close()
+{
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int VRTUdpReceiver::Receive(VRTUdpPacket *packets, int timeoutMs)
+{
+    if(fd < 0 || !packets) {
+        return -1;
+    }
+
+    pollfd pfd = { fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeoutMs);
+    if(ready <= 0) {
+        return (ready == 0 || errno == EINTR) ? 0 : -1;
+    }
+
+    // Receive into a contiguous run of slots
+    int count = ringPackets - head;
+    if(count > batchSize) {
+        count = batchSize;
+    }
+    mmsghdr *batch = &msgs[head];
+    for(int i = 0; i < count; i++) {
+        // The kernel overwrites these on each receive
+        batch[i].msg_hdr.msg_controllen = controlWords * sizeof(uint64_t);
+        batch[i].msg_hdr.msg_flags = 0;
+    }
+
+    int received = recvmmsg(fd, batch, count, MSG_DONTWAIT, nullptr);
+    if(received < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    int out = 0;
+    for(int i = 0; i < received; i++) {
+        msghdr &hdr = batch[i].msg_hdr;
+        for(cmsghdr *c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c)) {
+            if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+                // Running total for the socket
+                uint32_t dropped;
+                memcpy(&dropped, CMSG_DATA(c), sizeof(dropped));
+                kernelDrops = dropped;
+            }
+        }
+
+        datagrams++;
+        bytes += batch[i].msg_len;
+        if(hdr.msg_flags & MSG_TRUNC) {
+            truncated++;
+            continue;
+        }
+
+        packets[out].words = (const uint32_t*)hdr.msg_iov->iov_base;
+        packets[out].wordCount = batch[i].msg_len / sizeof(uint32_t);
+        out++;
+    }
+
+    head = (head + received) % ringPackets;
+
+    return out;
+}
+
+VRTUdpSender::VRTUdpSender() :
+    fd(-1),
+    msgs(VRT_UDP_SEND_BATCH),
+    iovs(VRT_UDP_SEND_BATCH)
+{
+}
+
+VRTUdpSender::~VRTUdpSender()
+{
+    Close();
+}
+
+bool VRTUdpSender::Open(const char *host, uint16_t port, int sndBufBytes)
+{
+    Close();
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if(!host || inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        return false;
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        return false;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndBufBytes, sizeof(sndBufBytes));
+
+    // Connected, so each message needs no address
+    if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void VRTUdpSender::Close()
+{
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int VRTUdpSender::Send(const uint32_t *const *packets, const uint32_t *wordCounts, int count)
+{
+    if(fd < 0) {
+        return 0;
+    }
+
+    int sent = 0;
+    int waits = 0;
+    while(sent < count) {
+        int n = count - sent;
+        if(n > VRT_UDP_SEND_BATCH) {
+            n = VRT_UDP_SEND_BATCH;
+        }
+
+        for(int i = 0; i < n; i++) {
+            iovs[i].iov_base = (void*)packets[sent + i];
+            iovs[i].iov_len = wordCounts[sent + i] * sizeof(uint32_t);
+            memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int r = sendmmsg(fd, msgs.data(), n, 0);
+        if(r < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno == ENOBUFS && ++waits <= VRT_UDP_MAX_NOBUFS_WAITS) {
+                vrtUdpWaitForBuffers(fd);
+                continue;
+            }
+            break;
+        }
+        waits = 0;
+        sent += r;
+    }
+
+    return sent;
+}
+
+int VRTUdpSender::Send(const iovec *iov, const int *iovCounts, int count)
+{
+    if(fd < 0) {
+        return 0;
+    }
+
+    int sent = 0;
+    int waits = 0;
+    while(sent < count) {
+        int n = count - sent;
+        if(n > VRT_UDP_SEND_BATCH) {
+            n = VRT_UDP_SEND_BATCH;
+        }
+
+        const iovec *curr = iov;
+        for(int i = 0; i < n; i++) {
+            memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+            msgs[i].msg_hdr.msg_iov = (iovec*)curr;
+            msgs[i].msg_hdr.msg_iovlen = iovCounts[sent + i];
+            curr += iovCounts[sent + i];
+        }
+
+        int r = sendmmsg(fd, msgs.data(), n, 0);
+        if(r < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno == ENOBUFS && ++waits <= VRT_UDP_MAX_NOBUFS_WAITS) {
+                vrtUdpWaitForBuffers(fd);
+                continue;
+            }
+            break;
+        }
+        waits = 0;
+        for(int i = 0; i < r; i++) {
+            iov += iovCounts[sent + i];
+        }
+        sent += r;
+    }
+
+    return sent;
+}
+
+uint64_t vrtUdpReplay(VRTUdpSender &sender, const uint32_t *words, uint32_t wordCount,
+                      int loops, const std::atomic<bool> *stop)
+{
+    std::vector<VRTPacketIndexEntry> index;
+    vrtIndexPackets(words, wordCount, index);
+
+    // Resolve the packet table once, every loop sends from it
+    std::vector<const uint32_t*> packets;
+    std::vector<uint32_t> wordCounts;
+    for(const VRTPacketIndexEntry &entry : index) {
+        if(entry.size * sizeof(uint32_t) > VRT_UDP_MAX_BYTES) {
+            continue;
+        }
+        packets.push_back(words + entry.offset);
+        wordCounts.push_back(entry.size);
+    }
+    if(packets.empty()) {
+        return 0;
+    }
+
+    uint64_t sent = 0;
+    for(int loop = 0; loop < loops; loop++) {
+        for(size_t i = 0; i < packets.size(); i += VRT_UDP_SEND_BATCH) {
+            if(stop && *stop) {
+                return sent;
+            }
+
+            int n = (int)std::min(packets.size() - i, (size_t)VRT_UDP_SEND_BATCH);
+            int r = sender.Send(&packets[i], &wordCounts[i], n);
+            sent += r;
+            if(r < n) {
+                return sent;
+            }
+        }
+    }
+
+    return sent;
+}
@@ -0,0 +1,116 @@
+#ifndef VRT_UDP_H
+#define VRT_UDP_H
+
+// VITA 49 (VRT) over UDP, one or more whole VRT packets per datagram.
+// Linux only, uses recvmmsg/sendmmsg to move many datagrams per system call.
+// A UDP datagram holds at most 65507 bytes, so data packets sent this way must
+//   be at most 16370 samples, see smSetVrtPacketSize.
+
+#include "sh_vrt.h"
+
+#include <atomic>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// One received datagram
+typedef struct VRTUdpPacket {
+    // Big endian VRT words, as received
+    const uint32_t *words;
+    uint32_t wordCount;
+} VRTUdpPacket;
+
+// Receives VRT datagrams into a ring of preallocated slots. The system call
+//   descriptors for every slot are built once in Open, so receiving only costs
+//   the recvmmsg call itself.
+class VRTUdpReceiver
+{
+public:
+    VRTUdpReceiver();
+    ~VRTUdpReceiver();
+
+    // port = UDP port to listen on
+    // bindAddr = local IPv4 address to listen on, nullptr for all interfaces
+    // ringPackets = number of datagram slots. A received datagram stays valid until
+    //   ringPackets more datagrams have been received.
+    // batchSize = maximum datagrams received per system call
+    // rcvBufBytes = requested socket receive buffer size. Large buffers absorb
+    //   bursts, the kernel limits them to net.core.rmem_max unless the process has
+    //   CAP_NET_ADMIN.
+    bool Open(uint16_t port, const char *bindAddr = nullptr, int ringPackets = 1024,
+              int batchSize = 64, int rcvBufBytes = 64 << 20);
+    void Close();
+    bool IsOpen() const { return fd >= 0; }
+
+    // Waits up to timeoutMs for datagrams, then receives as many as are queued,
+    //   up to batchSize, in one call.
+    // packets = at least batchSize entries, set to views of the received datagrams
+    // Returns the number of datagrams received, 0 on timeout, -1 on error.
+    int Receive(VRTUdpPacket *packets, int timeoutMs);
+
+    // Datagrams the kernel dropped because the receive buffer was full (SO_RXQ_OVFL)
+    uint64_t KernelDrops() const { return kernelDrops; }
+    // Datagrams larger than a slot, which were truncated and are not returned
+    uint64_t Truncated() const { return truncated; }
+    uint64_t Datagrams() const { return datagrams; }
+    uint64_t Bytes() const { return bytes; }
+    // Receive buffer size granted by the kernel
+    int ReceiveBufferBytes() const { return rcvBufBytes; }
+
+private:
+    int fd;
+    int ringPackets;
+    int batchSize;
+    int head;
+    int rcvBufBytes;
+
+    std::vector<uint32_t> slots;
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+    std::vector<uint64_t> control; // 64-bit words keep the cmsg headers aligned
+    size_t controlWords;
+
+    uint64_t kernelDrops;
+    uint64_t truncated;
+    uint64_t datagrams;
+    uint64_t bytes;
+};
+
+// Sends VRT packets, one per datagram, directly from the caller's buffers.
+class VRTUdpSender
+{
+public:
+    VRTUdpSender();
+    ~VRTUdpSender();
+
+    // host = IPv4 address of the receiver
+    bool Open(const char *host, uint16_t port, int sndBufBytes = 8 << 20);
+    void Close();
+
+    // Sends count big endian packets with sendmmsg, batchSize at a time. When the
+    //   device queue is full (ENOBUFS) waits briefly and retries.
+    // Returns the number of packets sent, less than count on error or if the
+    //   queue stays full for about a second.
+    int Send(const uint32_t *const *packets, const uint32_t *wordCounts, int count);
+    // Sends count packets which are each split over several buffers, e.g. header,
+    //   payload and trailer, with sendmmsg.
+    // iov = the buffers of all packets, one after the other
+    // iovCounts = number of buffers of each packet
+    // Returns the number of packets sent, as above.
+    int Send(const iovec *iov, const int *iovCounts, int count);
+
+private:
+    int fd;
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+};
+
+// Sends every packet of a blob of big endian VRT packets, e.g. a file of
+//   smGetVrtPackets output, loops times. The packets are sent from the blob
+//   without copying. Packets too large for a datagram are skipped.
+// stop = optional, checked between batches, replay ends early when it becomes true
+// Returns the number of packets sent.
+uint64_t vrtUdpReplay(VRTUdpSender &sender, const uint32_t *words, uint32_t wordCount,
+                      int loops, const std::atomic<bool> *stop = nullptr);
+
+#endif // VRT_UDP_H
@@ -0,0 +1,134 @@
+/*
+ *  Measures the VRT over UDP receive rate on the loopback interface.
+ *  A sender thread replays a file of VRT packets as fast as it can while the main
+ *  thread receives with VRTUdpReceiver and parses every data packet in place.
+ *
+ *  vrt_udp_loopback [file.vrt] [seconds] [port]
+ *
+ *  file.vrt = raw big endian VRT packets, e.g. smGetVrtPackets output written to
+ *    disk with smSetVrtPacketSize at most 16370. Without a file, synthetic data
+ *    packets of 8192 samples are sent.
+ */
+
+#include "vrt_udp.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static std::vector<uint32_t> makeTestPackets(int packetCount, uint32_t samplesPerPacket)
+{
+    uint32_t packetSize = samplesPerPacket + 6;
+    std::vector<uint32_t> words;
+    words.reserve((size_t)packetCount * packetSize);
+
+    for(int i = 0; i < packetCount; i++) {
+        words.push_back(vrtPackDataHeader((uint8_t)i, (uint16_t)packetSize));
+        words.push_back(1); // Stream ID
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(0);
+        for(uint32_t s = 0; s < samplesPerPacket; s++) {
+            words.push_back(s);
+        }
+        words.push_back(vrtPackDataTrailer(true, true, true, false, false, 0));
+    }
+
+    // To network byte order, as sent by the device
+    vrtSwapBytes(&words[0], (uint32_t)words.size());
+
+    return words;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = (argc > 2) ? atof(argv[2]) : 5.0;
+    uint16_t port = (argc > 3) ? (uint16_t)atoi(argv[3]) : 4991;
+
+    std::vector<uint32_t> words;
+    if(argc > 1) {
+        FILE *f = fopen(argv[1], "rb");
+        if(!f) {
+            printf("Unable to open %s\n", argv[1]);
+            return -1;
+        }
+        uint32_t buf[16384];
+        size_t n;
+        while((n = fread(buf, sizeof(uint32_t), 16384, f)) > 0) {
+            words.insert(words.end(), buf, buf + n);
+        }
+        fclose(f);
+        if(words.empty()) {
+            printf("%s contains no packets\n", argv[1]);
+            return -1;
+        }
+    } else {
+        words = makeTestPackets(1024, 8192);
+    }
+
+    VRTUdpReceiver receiver;
+    if(!receiver.Open(port, "127.0.0.1")) {
+        printf("Unable to open receiver on port %d\n", port);
+        return -1;
+    }
+    printf("Receive buffer %d bytes\n", receiver.ReceiveBufferBytes());
+
+    VRTUdpSender sender;
+    if(!sender.Open("127.0.0.1", port)) {
+        printf("Unable to open sender\n");
+        return -1;
+    }
+
+    std::atomic<bool> stop(false);
+    uint64_t sent = 0;
+    std::thread sendThread([&]() {
+        sent = vrtUdpReplay(sender, &words[0], (uint32_t)words.size(), 1 << 30, &stop);
+    });
+
+    std::vector<VRTUdpPacket> packets(64);
+    std::vector<VRTPacketIndexEntry> index;
+    VRTDataPktView view;
+    uint64_t dataPackets = 0, contextPackets = 0, samples = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    while(elapsed < seconds) {
+        int count = receiver.Receive(&packets[0], 100);
+        if(count < 0) {
+            printf("Receive error\n");
+            break;
+        }
+
+        // Datagrams are parsed where they were received, nothing is copied
+        for(int i = 0; i < count; i++) {
+            vrtIndexPackets(packets[i].words, packets[i].wordCount, index);
+            for(const VRTPacketIndexEntry &entry : index) {
+                if(entry.type == smVRTDataPacket &&
+                   vrtParseDataPacketView(packets[i].words + entry.offset, entry.size, view) > 0) {
+                    dataPackets++;
+                    samples += view.sampleCount;
+                } else if(entry.type == smVRTContextPacket) {
+                    contextPackets++;
+                }
+            }
+        }
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    stop = true;
+    sendThread.join();
+
+    printf("Sent %llu packets\n", (unsigned long long)sent);
+    printf("Received %llu datagrams, %llu data packets, %llu context packets\n",
+           (unsigned long long)receiver.Datagrams(), (unsigned long long)dataPackets,
+           (unsigned long long)contextPackets);
+    printf("%.0f packets/s, %.2f Gbit/s, %.1f MS/s\n",
+           receiver.Datagrams() / elapsed, receiver.Bytes() * 8.0 / elapsed * 1.0e-9,
+           samples / elapsed * 1.0e-6);
+    printf("Kernel drops %llu, truncated %llu\n",
+           (unsigned long long)receiver.KernelDrops(), (unsigned long long)receiver.Truncated());
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "vrt_blob_parser.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Data packets claimed by a thread at a time, large enough to keep the shared
+//   counter off the hot path, small enough to balance the threads
+static const size_t VRT_BLOB_PACKETS_PER_CLAIM = 4;
+
+VRTBlobParser::VRTBlobParser(int threadCount) :
+    reflevel(0.0),
+    generation(0),
+    busy(0),
+    quit(false),
+    next(0)
+{
+    if(threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+    }
+
+    // The thread calling Parse is one of the threads
+    for(int i = 1; i < threadCount; i++) {
+        workers.push_back(std::thread(&VRTBlobParser::Worker, this));
+    }
+}
+
+VRTBlobParser::~VRTBlobParser()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    startCond.notify_all();
+
+    for(std::thread &t : workers) {
+        t.join();
+    }
+}
+
+uint32_t VRTBlobParser::Parse(const uint32_t *words, uint32_t wordCount)
+{
+    contextPkts.clear();
+    dataPkts.clear();
+
+    // Phase 1, packet boundaries, context packets in stream order and the
+    //   location and scale of every data packet
+    uint32_t parsedWords = vrtIndexPackets(words, wordCount, index);
+
+    uint64_t totalSamples = 0;
+    double scaleReflevel = reflevel;
+    float scale = (float)sqrt(pow(10.0, reflevel / 10.0));
+    for(size_t i = 0; i < index.size(); i++) {
+        const VRTPacketIndexEntry &entry = index[i];
+
+        if(entry.type == smVRTContextPacket) {
+            contextPkts.push_back(VRTUserContextPkt());
+            parser.reflevel = reflevel;
+            if(parser.ParseContextPacket(words + entry.offset, entry.size, contextPkts.back()) < 0) {
+                // Data packets which follow keep the previous context
+                contextPkts.pop_back();
+                continue;
+            }
+            reflevel = parser.reflevel;
+            if(reflevel != scaleReflevel) {
+                scaleReflevel = reflevel;
+                scale = (float)sqrt(pow(10.0, reflevel / 10.0));
+            }
+        } else if(entry.type == smVRTDataPacket) {
+            VRTBlobDataPkt pkt;
+            if(vrtParseDataPacketView(words + entry.offset, entry.size, pkt.view) < 0) {
+                continue;
+            }
+            pkt.sampleOffset = totalSamples * 2;
+            pkt.contextIndex = (int)contextPkts.size() - 1;
+            pkt.scale = scale;
+            dataPkts.push_back(pkt);
+            totalSamples += pkt.view.sampleCount;
+        }
+    }
+
+    // Only allocates when the blob grows
+    samples.resize(totalSamples * 2);
+
+    // Phase 2, convert the data packets in parallel
+    if(dataPkts.empty()) {
+        return parsedWords;
+    }
+
+    next = 0;
+    if(!workers.empty()) {
+        std::lock_guard<std::mutex> guard(lock);
+        generation++;
+        busy = (int)workers.size();
+    }
+    startCond.notify_all();
+
+    ConvertPackets();
+
+    std::unique_lock<std::mutex> guard(lock);
+    doneCond.wait(guard, [this]() { return busy == 0; });
+
+    return parsedWords;
+}
+
+void VRTBlobParser::ConvertPackets()
+{
+    const size_t count = dataPkts.size();
+    while(true) {
+        size_t first = next.fetch_add(VRT_BLOB_PACKETS_PER_CLAIM);
+        if(first >= count) {
+            return;
+        }
+
+        size_t last = std::min(first + VRT_BLOB_PACKETS_PER_CLAIM, count);
+        for(size_t i = first; i < last; i++) {
+            const VRTBlobDataPkt &pkt = dataPkts[i];
+            vrtUnpackDataPayload(pkt.view, &samples[0] + pkt.sampleOffset, pkt.scale);
+        }
+    }
+}
+
+void VRTBlobParser::Worker()
+{
+    uint64_t seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            startCond.wait(guard, [&]() { return quit || generation != seen; });
+            if(quit) {
+                return;
+            }
+            seen = generation;
+        }
+
+        ConvertPackets();
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            last = (--busy == 0);
+        }
+        if(last) {
+            doneCond.notify_one();
+        }
+    }
+}
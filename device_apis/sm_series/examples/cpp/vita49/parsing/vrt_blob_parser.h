@@ -0,0 +1,80 @@
+#ifndef VRT_BLOB_PARSER_H
+#define VRT_BLOB_PARSER_H
+
+#include "vrt_parser.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Data packet of a parsed blob
+typedef struct VRTBlobDataPkt {
+    VRTDataPktView view;
+    // Offset of the packet's 2 * view.sampleCount floats in VRTBlobParser::Samples()
+    uint64_t sampleOffset;
+    // Index in VRTBlobParser::ContextPackets() of the last context packet before
+    //   this one, or -1 if there was none
+    int contextIndex;
+    // Amplitude scale the samples were converted with, from the reference level
+    //   in effect for this packet
+    float scale;
+} VRTBlobDataPkt;
+
+// Parses a large blob of VRT packets, such as many calls to smGetVrtPackets or a
+//   capture file, in two phases.
+// First the packet table is built from the header words alone (vrtIndexPackets)
+//   and the context packets are decoded in stream order, which fixes the
+//   reference level of every data packet. Then the data packets, which are
+//   independent of each other, are converted on a pool of threads.
+// The blob is not modified.
+class VRTBlobParser
+{
+public:
+    // threadCount = 0 to use one thread per core
+    VRTBlobParser(int threadCount = 0);
+    ~VRTBlobParser();
+
+    // Parses every packet in the blob.
+    // Returns the number of words parsed, less than wordCount if the blob ends in
+    //   a truncated or invalid packet.
+    uint32_t Parse(const uint32_t *words, uint32_t wordCount);
+
+    // Results of the last call to Parse, valid until the next call.
+    // The data packet views point into the blob passed to Parse.
+    const std::vector<VRTPacketIndexEntry> &Index() const { return index; }
+    const std::vector<VRTUserContextPkt> &ContextPackets() const { return contextPkts; }
+    const std::vector<VRTBlobDataPkt> &DataPackets() const { return dataPkts; }
+    // IQ samples of all data packets in stream order, interleaved floats
+    const float *Samples() const { return samples.data(); }
+    uint64_t SampleCount() const { return samples.size() / 2; }
+
+    int ThreadCount() const { return (int)workers.size() + 1; }
+
+    // Reference level used for data packets which precede the first context
+    //   packet of the blob. Updated by each context packet parsed.
+    double reflevel;
+
+private:
+    void Worker();
+    void ConvertPackets();
+
+    VRTParser parser;
+
+    std::vector<VRTPacketIndexEntry> index;
+    std::vector<VRTUserContextPkt> contextPkts;
+    std::vector<VRTBlobDataPkt> dataPkts;
+    std::vector<float> samples;
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    uint64_t generation;
+    int busy;
+    bool quit;
+    // Next data packet to convert
+    std::atomic<size_t> next;
+};
+
+#endif // VRT_BLOB_PARSER_H
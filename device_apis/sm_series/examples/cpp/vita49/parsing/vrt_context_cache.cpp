@@ -0,0 +1,136 @@
+#include "vrt_context_cache.h"
+
+#include <cmath>
+
+static const uint32_t VRT_CNTX_METADATA_WORDS = sizeof(VRTContextPktMetadata) / sizeof(uint32_t);
+
+static inline uint64_t vrtHashStep(uint64_t h, uint64_t v)
+{
+    h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t vrtHashWords(const uint32_t *words, uint32_t wordCount)
+{
+    uint64_t h = vrtHashStep(0, wordCount);
+    uint32_t i = 0;
+    for(; i + 1 < wordCount; i += 2) {
+        h = vrtHashStep(h, ((uint64_t)words[i + 1] << 32) | words[i]);
+    }
+    if(i < wordCount) {
+        h = vrtHashStep(h, words[i]);
+    }
+    return h;
+}
+
+VRTContextCache::VRTContextCache(double reflevel) :
+    current(nullptr),
+    version(0),
+    nextVersion(0)
+{
+    for(Slot &slot : slots) {
+        slot.sequence.store(0, std::memory_order_relaxed);
+    }
+    Reset(reflevel);
+}
+
+void VRTContextCache::Reset(double reflevel)
+{
+    // Published like any other snapshot, so readers of the old one are unaffected
+    memset(&scratch, 0, sizeof(scratch));
+    Publish(scratch, 0, reflevel, (float)sqrt(pow(10.0, reflevel / 10.0)));
+
+    haveLast = false;
+    lastHash = 0;
+    lastPayloadWords = 0;
+    packetCount = 0;
+    decodeCount = 0;
+}
+
+const VRTContextSnapshot *VRTContextCache::Publish(const VRTUserContextPkt &context, uint64_t hash,
+                                                   double reflevel, float scale)
+{
+    Slot &slot = slots[nextVersion % VRT_CONTEXT_CACHE_SNAPSHOTS];
+
+    // Seqlock write, readers of a recycled slot see an odd or changed sequence
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.snapshot.version = nextVersion;
+    slot.snapshot.hash = hash;
+    slot.snapshot.context = context;
+    slot.snapshot.reflevel = reflevel;
+    slot.snapshot.scale = scale;
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    current.store(&slot, std::memory_order_release);
+    version.store(nextVersion, std::memory_order_release);
+    nextVersion++;
+
+    return &slot.snapshot;
+}
+
+void VRTContextCache::Read(VRTContextSnapshot &snapshot) const
+{
+    while(true) {
+        const Slot *slot = current.load(std::memory_order_acquire);
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if(sequence & 1) {
+            continue;
+        }
+
+        memcpy(&snapshot, &slot->snapshot, sizeof(snapshot));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot->sequence.load(std::memory_order_relaxed) == sequence) {
+            return;
+        }
+    }
+}
+
+const VRTContextSnapshot *VRTContextCache::OnContextPacket(const uint32_t *words, uint32_t wordCount)
+{
+    if(!words || wordCount < VRT_CNTX_METADATA_WORDS) {
+        return nullptr;
+    }
+
+    uint32_t header = swapWord(words[0]);
+    uint32_t packetSize = vrtGetPacketSize(header);
+    if(vrtGetPacketType(header) != VRT_CNTX_PKT_TYPE || packetSize < VRT_CNTX_METADATA_WORDS ||
+       packetSize > wordCount) {
+        return nullptr;
+    }
+    packetCount++;
+
+    // The payload is everything after the prologue. The timestamps and packet
+    //   count change with every packet and are left out, as is the change bit.
+    uint32_t indicators = swapWord(words[VRT_CNTX_METADATA_WORDS - 1]);
+    uint32_t payloadWords = packetSize - (VRT_CNTX_METADATA_WORDS - 1);
+    uint64_t hash = vrtHashStep(vrtHashWords(words + VRT_CNTX_METADATA_WORDS, payloadWords - 1),
+                                indicators & ~VRT_CNTX_FIELD_CHANGE_BIT);
+
+    const VRTContextSnapshot *prev = Current();
+    bool isChange = (indicators & VRT_CNTX_FIELD_CHANGE_BIT) != 0;
+    if(!isChange && haveLast && hash == lastHash && payloadWords == lastPayloadWords) {
+        return prev;
+    }
+
+    if(vrtParseContextPacket(words, packetSize, scratch) < 0) {
+        return nullptr;
+    }
+    decodeCount++;
+
+    double reflevel = prev->reflevel;
+    float scale = prev->scale;
+    if(scratch.indicators.isReflevel && scratch.reflevel != reflevel) {
+        reflevel = scratch.reflevel;
+        scale = (float)sqrt(pow(10.0, reflevel / 10.0));
+    }
+
+    haveLast = true;
+    lastHash = hash;
+    lastPayloadWords = payloadWords;
+
+    return Publish(scratch, hash, reflevel, scale);
+}
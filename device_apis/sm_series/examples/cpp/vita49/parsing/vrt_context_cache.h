@@ -0,0 +1,114 @@
+#ifndef VRT_CONTEXT_CACHE_H
+#define VRT_CONTEXT_CACHE_H
+
+#include "sh_vrt.h"
+
+#include <atomic>
+
+// Snapshots kept by VRTContextCache before one is reused
+#define VRT_CONTEXT_CACHE_SNAPSHOTS (64)
+
+// Decoded context of a stream. Not modified after it is published until its slot
+//   is recycled, see VRTContextCache.
+typedef struct VRTContextSnapshot {
+    // 0 for the initial snapshot, then one more for each snapshot published
+    uint64_t version;
+    // Hash of the context packet payload, the indicator word without the field
+    //   change indicator and the fields
+    uint64_t hash;
+    // The first context packet with this content
+    VRTUserContextPkt context;
+    // Reference level in effect, from the context or carried over from the
+    //   previous snapshot if the packet has no reference level field
+    double reflevel;
+    // sqrt(mW) amplitude of reflevel, the scale for vrtUnpackDataPayload
+    float scale;
+} VRTContextSnapshot;
+
+// Caches the decoded context of one stream.
+// Devices repeat the same context packet many times between configuration
+//   changes. A packet with the field change indicator clear and the same payload
+//   as the last one is not decoded again. A packet with new content is decoded
+//   into scratch memory, copied into a free snapshot slot and published with a
+//   single atomic store. A packet which fails to decode leaves every snapshot
+//   untouched.
+//
+// One thread feeds context packets and may use Current() directly. Other threads
+//   read a copy of the latest snapshot with Read(), without locking. Slots are
+//   recycled after VRT_CONTEXT_CACHE_SNAPSHOTS - 1 newer snapshots have been
+//   published. Each slot carries a sequence number which is odd while it is
+//   rewritten, Read() checks it before and after copying and retries if the slot
+//   was recycled underneath it, so a copy is never torn.
+//
+// Example, on the thread feeding the cache:
+//   if(type == smVRTContextPacket) {
+//       cache.OnContextPacket(words, size);
+//   } else if(type == smVRTDataPacket) {
+//       const VRTContextSnapshot *ctx = cache.Current();
+//       vrtParseDataPacketView(words, size, view);
+//       vrtUnpackDataPayload(view, iq, ctx->scale);
+//   }
+class VRTContextCache
+{
+public:
+    // reflevel = reference level of the initial snapshot, used for data packets
+    //   which arrive before the first context packet
+    VRTContextCache(double reflevel = 0.0);
+
+    // Discards every snapshot and publishes a new initial snapshot
+    void Reset(double reflevel = 0.0);
+
+    // Updates the cache from a big endian context packet, words is not modified.
+    // Returns the snapshot in effect after the packet, or nullptr if words does not
+    //   start with a complete context packet.
+    const VRTContextSnapshot *OnContextPacket(const uint32_t *words, uint32_t wordCount);
+
+    // Latest snapshot. Only for the thread calling OnContextPacket, the pointer is
+    //   valid until that thread publishes VRT_CONTEXT_CACHE_SNAPSHOTS - 1 more.
+    const VRTContextSnapshot *Current() const
+    {
+        return &current.load(std::memory_order_acquire)->snapshot;
+    }
+    // Copies the latest snapshot, safe to call from any thread
+    void Read(VRTContextSnapshot &snapshot) const;
+    // Version of the latest snapshot, safe to call from any thread
+    uint64_t Version() const { return version.load(std::memory_order_acquire); }
+
+    // Context packets seen, decoded and skipped as repeats
+    uint64_t PacketCount() const { return packetCount; }
+    uint64_t DecodeCount() const { return decodeCount; }
+    uint64_t SkipCount() const { return packetCount - decodeCount; }
+
+private:
+    struct Slot {
+        // Odd while the snapshot is being written
+        std::atomic<uint64_t> sequence;
+        VRTContextSnapshot snapshot;
+    };
+
+    // Writes the next free slot and makes it current
+    const VRTContextSnapshot *Publish(const VRTUserContextPkt &context, uint64_t hash,
+                                      double reflevel, float scale);
+
+    Slot slots[VRT_CONTEXT_CACHE_SNAPSHOTS];
+    std::atomic<const Slot*> current;
+    std::atomic<uint64_t> version;
+    uint64_t nextVersion;
+
+    // Decode target, only copied into a slot once the packet decodes
+    VRTUserContextPkt scratch;
+
+    // Last packet seen, which may differ from the current snapshot only in its
+    //   field change indicator
+    uint64_t lastHash;
+    uint32_t lastPayloadWords;
+    bool haveLast;
+
+    uint64_t packetCount;
+    uint64_t decodeCount;
+};
+
+// 64-bit hash of words, as used for VRTContextSnapshot::hash
+uint64_t vrtHashWords(const uint32_t *words, uint32_t wordCount);
+
+#endif // VRT_CONTEXT_CACHE_H
@@ -0,0 +1,385 @@
+#include "vrt_demux.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Prologue plus trailer
+static const uint32_t VRT_DEMUX_DATA_OVERHEAD = sizeof(VRTDataPktMetadata) / sizeof(uint32_t) + 1;
+// Packets a worker converts from one stream before moving to the next
+static const int VRT_DEMUX_BATCH = 32;
+// Empty passes over its streams before a worker starts sleeping between passes
+static const int VRT_DEMUX_SPIN_PASSES = 64;
+
+// Counters only have one writer, so no locked add is needed
+static inline void vrtCounterAdd(std::atomic<uint64_t> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static inline uint32_t vrtStreamHash(uint32_t streamIdent)
+{
+    uint32_t h = streamIdent * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+// Cache line aligned allocation, alignof(VRTDemuxStream) is VRT_CACHE_LINE
+static void *vrtAlignedAlloc(size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, VRT_CACHE_LINE);
+#else
+    void *p;
+    if(posix_memalign(&p, VRT_CACHE_LINE, size) != 0) {
+        return nullptr;
+    }
+    return p;
+#endif
+}
+
+static void vrtAlignedFree(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void VRTDemuxStreamDelete::operator()(VRTDemuxStream *stream) const
+{
+    stream->~VRTDemuxStream();
+    vrtAlignedFree(stream);
+}
+
+VRTDemuxStream::VRTDemuxStream(uint32_t streamIdent, uint32_t maxPacketWords, int inputPackets,
+                               int outputPackets, double reflevel) :
+    streamIdent(streamIdent),
+    maxPacketWords(maxPacketWords),
+    cache(reflevel),
+    inputSlots((uint32_t)std::max(inputPackets, 1)),
+    outputSlots((uint32_t)std::max(outputPackets, 1)),
+    packets(0),
+    inputDrops(0),
+    outputDrops(0),
+    invalidPackets(0)
+{
+    uint32_t maxSamples = maxPacketWords > VRT_DEMUX_DATA_OVERHEAD ?
+        maxPacketWords - VRT_DEMUX_DATA_OVERHEAD : 0;
+
+    inputWords.resize((size_t)inputSlots * maxPacketWords);
+    inputSizes.resize(inputSlots);
+
+    outputSlotFloats = maxSamples * 2;
+    outputIQ.resize((size_t)outputSlots * outputSlotFloats);
+    outputBlocks.resize(outputSlots);
+    for(uint32_t i = 0; i < outputSlots; i++) {
+        outputBlocks[i].iq = outputIQ.data() + (size_t)i * outputSlotFloats;
+    }
+}
+
+bool VRTDemuxStream::Push(const uint32_t *words, uint32_t wordCount)
+{
+    vrtCounterAdd(packets);
+
+    uint64_t head = input.head.load(std::memory_order_relaxed);
+    if(head - input.producerTail >= inputSlots) {
+        input.producerTail = input.tail.load(std::memory_order_acquire);
+        if(head - input.producerTail >= inputSlots) {
+            vrtCounterAdd(inputDrops);
+            return false;
+        }
+    }
+
+    uint32_t slot = (uint32_t)(head % inputSlots);
+    memcpy(&inputWords[(size_t)slot * maxPacketWords], words, wordCount * sizeof(uint32_t));
+    inputSizes[slot] = wordCount;
+    input.head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+int VRTDemuxStream::Process(int maxCount)
+{
+    uint64_t tail = input.tail.load(std::memory_order_relaxed);
+    if(input.consumerHead - tail < (uint64_t)maxCount) {
+        input.consumerHead = input.head.load(std::memory_order_acquire);
+    }
+    int count = (int)std::min(input.consumerHead - tail, (uint64_t)maxCount);
+    if(count == 0) {
+        return 0;
+    }
+
+    uint64_t outHead = output.head.load(std::memory_order_relaxed);
+    uint64_t outStart = outHead;
+    VRTDataPktView view;
+
+    for(int i = 0; i < count; i++) {
+        uint32_t slot = (uint32_t)((tail + i) % inputSlots);
+        const uint32_t *words = &inputWords[(size_t)slot * maxPacketWords];
+        uint32_t wordCount = inputSizes[slot];
+
+        if(vrtGetPacketType(swapWord(words[0])) == VRT_CNTX_PKT_TYPE) {
+            const VRTContextSnapshot *snap = cache.OnContextPacket(words, wordCount);
+            if(!snap) {
+                vrtCounterAdd(invalidPackets);
+                continue;
+            }
+            // Repeats are not decoded, the prologue is all the monitor needs of them
+            VRTUserPktPrologue prologue;
+            prologue.header.packetType = VRT_CNTX_PKT_TYPE;
+            prologue.header.packetCount = vrtGetPacketCount(swapWord(words[0]));
+            prologue.header.packetSize = wordCount;
+            prologue.streamIdent = swapWord(words[1]);
+            prologue.seconds = swapWord(words[2]);
+            prologue.picoUpper = swapWord(words[3]);
+            prologue.picoLower = swapWord(words[4]);
+            monitor.OnContextPacket(prologue, snap->context);
+            continue;
+        }
+
+        if(vrtParseDataPacketView(words, wordCount, view) < 0) {
+            vrtCounterAdd(invalidPackets);
+            continue;
+        }
+        monitor.OnDataPacket(view);
+
+        if(outHead - output.producerTail >= outputSlots) {
+            output.producerTail = output.tail.load(std::memory_order_acquire);
+            if(outHead - output.producerTail >= outputSlots) {
+                vrtCounterAdd(outputDrops);
+                continue;
+            }
+        }
+
+        const VRTContextSnapshot *ctx = cache.Current();
+        uint32_t outSlot = (uint32_t)(outHead % outputSlots);
+        VRTDemuxBlock &block = outputBlocks[outSlot];
+        block.prologue = view.prologue;
+        block.trailer = view.trailer;
+        block.sampleCount = view.sampleCount;
+        block.contextVersion = ctx->version;
+        block.reflevel = ctx->reflevel;
+        vrtUnpackDataPayload(view, outputIQ.data() + (size_t)outSlot * outputSlotFloats, ctx->scale);
+        outHead++;
+    }
+
+    // Published once per batch, the reader sees the blocks in order
+    if(outHead != outStart) {
+        output.head.store(outHead, std::memory_order_release);
+    }
+    input.tail.store(tail + count, std::memory_order_release);
+
+    return count;
+}
+
+int VRTDemuxStream::Read(const VRTDemuxBlock **blocks, int maxCount)
+{
+    uint64_t tail = output.tail.load(std::memory_order_relaxed);
+    if(output.consumerHead - tail < (uint64_t)maxCount) {
+        output.consumerHead = output.head.load(std::memory_order_acquire);
+    }
+    int count = (int)std::min(output.consumerHead - tail, (uint64_t)std::max(maxCount, 0));
+
+    for(int i = 0; i < count; i++) {
+        blocks[i] = &outputBlocks[(tail + i) % outputSlots];
+    }
+
+    return count;
+}
+
+void VRTDemuxStream::Release(int count)
+{
+    uint64_t tail = output.tail.load(std::memory_order_relaxed);
+    output.tail.store(tail + count, std::memory_order_release);
+}
+
+VRTDemux::VRTDemux() :
+    tableMask(0),
+    lastStream(nullptr),
+    unknownPackets(0),
+    invalidPackets(0),
+    quit(false),
+    running(false)
+{
+}
+
+VRTDemux::~VRTDemux()
+{
+    Stop();
+}
+
+VRTDemuxStream *VRTDemux::AddStream(uint32_t streamIdent, uint32_t maxPacketWords,
+                                    int inputPackets, int outputPackets, double reflevel)
+{
+    if(running || Stream(streamIdent)) {
+        return nullptr;
+    }
+
+    // Constructed in aligned storage, see VRTDemuxStreamDelete
+    void *storage = vrtAlignedAlloc(sizeof(VRTDemuxStream));
+    if(!storage) {
+        throw std::bad_alloc();
+    }
+    VRTDemuxStream *stream;
+    try {
+        stream = new(storage) VRTDemuxStream(streamIdent, maxPacketWords, inputPackets,
+            outputPackets, reflevel);
+    } catch(...) {
+        vrtAlignedFree(storage);
+        throw;
+    }
+    streams.push_back(std::unique_ptr<VRTDemuxStream, VRTDemuxStreamDelete>(stream));
+
+    // Rebuild the table at no more than half full
+    uint32_t tableSize = 8;
+    while(tableSize < streams.size() * 2) {
+        tableSize *= 2;
+    }
+    tableMask = tableSize - 1;
+    table.assign(tableSize, -1);
+    for(int i = 0; i < (int)streams.size(); i++) {
+        uint32_t h = vrtStreamHash(streams[i]->streamIdent) & tableMask;
+        while(table[h] >= 0) {
+            h = (h + 1) & tableMask;
+        }
+        table[h] = i;
+    }
+
+    return streams.back().get();
+}
+
+VRTDemuxStream *VRTDemux::Stream(uint32_t streamIdent) const
+{
+    if(table.empty()) {
+        return nullptr;
+    }
+
+    uint32_t h = vrtStreamHash(streamIdent) & tableMask;
+    while(table[h] >= 0) {
+        VRTDemuxStream *stream = streams[table[h]].get();
+        if(stream->streamIdent == streamIdent) {
+            return stream;
+        }
+        h = (h + 1) & tableMask;
+    }
+
+    return nullptr;
+}
+
+bool VRTDemux::Start(int workerCount)
+{
+    if(running) {
+        return false;
+    }
+
+    quit.store(false);
+    running = true;
+    for(int i = 0; i < workerCount; i++) {
+        workers.push_back(std::thread(&VRTDemux::Worker, this, i, workerCount));
+    }
+
+    return true;
+}
+
+void VRTDemux::Stop()
+{
+    if(!running) {
+        return;
+    }
+
+    quit.store(true, std::memory_order_release);
+    for(std::thread &t : workers) {
+        t.join();
+    }
+    workers.clear();
+    running = false;
+}
+
+int VRTDemux::Route(const uint32_t *words, uint32_t wordCount)
+{
+    if(!words) {
+        return 0;
+    }
+
+    int routed = 0;
+    uint32_t offset = 0;
+    while(offset < wordCount) {
+        uint32_t header = swapWord(words[offset]);
+        uint32_t size = vrtGetPacketSize(header);
+        if(size < 2 || size > wordCount - offset) {
+            invalidPackets++;
+            break;
+        }
+
+        uint32_t type = vrtGetPacketType(header);
+        if(type != VRT_DATA_PKT_TYPE && type != VRT_CNTX_PKT_TYPE) {
+            invalidPackets++;
+            offset += size;
+            continue;
+        }
+
+        // Datagrams usually arrive in runs from one device
+        uint32_t streamIdent = swapWord(words[offset + 1]);
+        VRTDemuxStream *stream = lastStream;
+        if(!stream || stream->streamIdent != streamIdent) {
+            stream = Stream(streamIdent);
+        }
+
+        if(!stream) {
+            unknownPackets++;
+        } else if(size > stream->maxPacketWords) {
+            invalidPackets++;
+        } else {
+            if(stream->Push(words + offset, size)) {
+                routed++;
+            }
+            lastStream = stream;
+        }
+        offset += size;
+    }
+
+    return routed;
+}
+
+int VRTDemux::Process()
+{
+    int total = 0;
+    for(const std::unique_ptr<VRTDemuxStream, VRTDemuxStreamDelete> &stream : streams) {
+        int count;
+        while((count = stream->Process(VRT_DEMUX_BATCH)) > 0) {
+            total += count;
+        }
+    }
+
+    return total;
+}
+
+void VRTDemux::Worker(int index, int workerCount)
+{
+    int idlePasses = 0;
+    while(true) {
+        // Read before the pass, so packets routed before Stop are converted
+        bool stopping = quit.load(std::memory_order_acquire);
+
+        int count = 0;
+        for(size_t i = index; i < streams.size(); i += workerCount) {
+            count += streams[i]->Process(VRT_DEMUX_BATCH);
+        }
+
+        if(count > 0) {
+            idlePasses = 0;
+        } else if(stopping) {
+            break;
+        } else if(++idlePasses < VRT_DEMUX_SPIN_PASSES) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
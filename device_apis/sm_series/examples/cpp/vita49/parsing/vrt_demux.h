@@ -0,0 +1,212 @@
+#ifndef VRT_DEMUX_H
+#define VRT_DEMUX_H
+
+#include "vrt_context_cache.h"
+#include "vrt_integrity.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Size of the cache line, indices written by different threads are kept this far
+//   apart
+#define VRT_CACHE_LINE (64)
+
+// Data packet of one stream converted by VRTDemux
+typedef struct VRTDemuxBlock {
+    VRTUserPktPrologue prologue;
+    VRTUserDataTrailer trailer;
+    uint32_t sampleCount;
+    // Version and reference level of the context snapshot the samples were
+    //   scaled with, see VRTContextSnapshot
+    uint64_t contextVersion;
+    double reflevel;
+    // Interleaved IQ, 2 * sampleCount floats
+    const float *iq;
+} VRTDemuxBlock;
+
+// Positions of a single producer, single consumer ring. Each side only writes its
+//   own position, on its own cache line, and keeps a copy of the other side's
+//   position so the shared line is only read when the ring looks full or empty.
+typedef struct VRTRingIndex {
+    VRTRingIndex() : head(0), tail(0), producerTail(0), consumerHead(0) {}
+
+    // Next slot to write, written by the producer
+    alignas(VRT_CACHE_LINE) std::atomic<uint64_t> head;
+    // Next slot to read, written by the consumer
+    alignas(VRT_CACHE_LINE) std::atomic<uint64_t> tail;
+    // Last tail seen by the producer
+    alignas(VRT_CACHE_LINE) uint64_t producerTail;
+    // Last head seen by the consumer
+    alignas(VRT_CACHE_LINE) uint64_t consumerHead;
+} VRTRingIndex;
+
+// One stream of a VRTDemux, the packets of one streamIdent.
+// Packets are routed into an input ring, converted by the worker which owns the
+//   stream, and the converted data packets are read by the application from the
+//   output ring. The context cache, integrity monitor and both rings belong to
+//   this stream alone, so streams never wait on each other.
+class VRTDemuxStream
+{
+public:
+    uint32_t StreamIdent() const { return streamIdent; }
+
+    // Context of the stream, Read() and Version() may be called from any thread
+    const VRTContextCache &Context() const { return cache; }
+    // Only consistent while the demux is stopped
+    const VRTIntegrityMonitor &Integrity() const { return monitor; }
+
+    // Converted data packets, oldest first. Called from one reader thread.
+    // blocks = set to up to maxCount blocks, which stay valid until released
+    // Returns the number of blocks available.
+    int Read(const VRTDemuxBlock **blocks, int maxCount);
+    // Returns the count oldest blocks to the ring
+    void Release(int count);
+
+    // Packets routed to the stream
+    uint64_t Packets() const { return packets.load(std::memory_order_relaxed); }
+    // Packets dropped because the input ring was full, the worker fell behind
+    uint64_t InputDrops() const { return inputDrops.load(std::memory_order_relaxed); }
+    // Data packets dropped because the output ring was full, the reader fell behind
+    uint64_t OutputDrops() const { return outputDrops.load(std::memory_order_relaxed); }
+    // Packets which failed to decode
+    uint64_t InvalidPackets() const { return invalidPackets.load(std::memory_order_relaxed); }
+
+private:
+    friend class VRTDemux;
+
+    VRTDemuxStream(uint32_t streamIdent, uint32_t maxPacketWords, int inputPackets,
+                   int outputPackets, double reflevel);
+
+    // Router side, copies one packet into the input ring
+    // Returns false if the ring is full.
+    bool Push(const uint32_t *words, uint32_t wordCount);
+    // Worker side, converts up to maxCount queued packets
+    // Returns the number of packets taken from the input ring.
+    int Process(int maxCount);
+
+    uint32_t streamIdent;
+    uint32_t maxPacketWords;
+
+    VRTContextCache cache;
+    VRTIntegrityMonitor monitor;
+
+    // Raw big endian packets, maxPacketWords per slot
+    VRTRingIndex input;
+    uint32_t inputSlots;
+    std::vector<uint32_t> inputWords;
+    std::vector<uint32_t> inputSizes;
+
+    // Converted data packets, 2 * (maxPacketWords - 6) floats per slot
+    VRTRingIndex output;
+    uint32_t outputSlots;
+    uint32_t outputSlotFloats;
+    std::vector<float> outputIQ;
+    std::vector<VRTDemuxBlock> outputBlocks;
+
+    // Each counter has a single writer, the router or the worker
+    alignas(VRT_CACHE_LINE) std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> inputDrops;
+    alignas(VRT_CACHE_LINE) std::atomic<uint64_t> outputDrops;
+    std::atomic<uint64_t> invalidPackets;
+};
+
+// Destroys a stream and frees the cache line aligned storage VRTDemux::AddStream
+//   allocated it in. The global operator new only aligns to
+//   alignof(std::max_align_t) before C++17, which would put the aligned members
+//   of VRTDemuxStream on shared lines.
+struct VRTDemuxStreamDelete {
+    void operator()(VRTDemuxStream *stream) const;
+};
+
+// Routes VRT packets from several devices, each tagged with its own stream ID
+//   (smSetVrtStreamID), to per stream state.
+// One thread calls Route with whatever it receives, e.g. the datagrams of a
+//   VRTUdpReceiver. Route only reads the header and stream ID of each packet and
+//   copies it into the input ring of its stream. Worker threads each own a fixed
+//   set of streams, decode the context packets through the stream's
+//   VRTContextCache, check the stream with a VRTIntegrityMonitor, and convert the
+//   data packets into the stream's output ring with the stream's own reference
+//   level. Nothing is shared between streams after Start, so throughput grows
+//   with the number of workers up to the number of streams. Packets of one
+//   stream are always converted in order by one worker.
+//
+// Example:
+//   VRTDemux demux;
+//   VRTDemuxStream *a = demux.AddStream(1, 16384 + 6);
+//   VRTDemuxStream *b = demux.AddStream(2, 16384 + 6);
+//   demux.Start(2);
+//   // Receive thread
+//   demux.Route(words, wordCount);
+//   // Reader thread of stream a
+//   const VRTDemuxBlock *blocks[16];
+//   int count = a->Read(blocks, 16);
+//   ...
+//   a->Release(count);
+class VRTDemux
+{
+public:
+    VRTDemux();
+    ~VRTDemux();
+
+    // Adds a stream, only while stopped. Allocates all of the stream's memory.
+    // maxPacketWords = largest packet of the stream in words, larger packets are
+    //   dropped, see smGetVrtPacketSize and smGetVrtContextPktSize
+    // inputPackets = packets queued for the worker
+    // outputPackets = converted data packets queued for the reader
+    // reflevel = reference level until the first context packet, see VRTContextCache
+    // Returns nullptr if the stream already exists or the demux is running.
+    VRTDemuxStream *AddStream(uint32_t streamIdent, uint32_t maxPacketWords,
+                              int inputPackets = 256, int outputPackets = 256,
+                              double reflevel = 0.0);
+    // Returns nullptr for an unknown stream
+    VRTDemuxStream *Stream(uint32_t streamIdent) const;
+    int StreamCount() const { return (int)streams.size(); }
+    VRTDemuxStream *StreamAt(int i) const { return streams[i].get(); }
+
+    // Starts workerCount threads, stream i is converted by thread i % workerCount.
+    // workerCount = 0 to start no threads and call Process instead.
+    // Returns false if already running.
+    bool Start(int workerCount);
+    // Waits for the workers to finish the packets already routed
+    void Stop();
+    bool IsRunning() const { return running; }
+
+    // Routes every packet in words, one or more whole big endian data or context
+    //   packets, to the input ring of its stream. Called from one thread.
+    // Returns the number of packets queued, packets dropped because an input ring
+    //   was full are counted by VRTDemuxStream::InputDrops.
+    int Route(const uint32_t *words, uint32_t wordCount);
+
+    // Converts the packets queued on every stream on the calling thread, for use
+    //   without worker threads.
+    // Returns the number of packets converted.
+    int Process();
+
+    // Packets of a stream which was not added
+    uint64_t UnknownPackets() const { return unknownPackets; }
+    // Packets which are truncated, larger than the maxPacketWords of their stream,
+    //   or not data or context packets
+    uint64_t InvalidPackets() const { return invalidPackets; }
+
+private:
+    void Worker(int index, int workerCount);
+
+    std::vector<std::unique_ptr<VRTDemuxStream, VRTDemuxStreamDelete>> streams;
+
+    // Open addressing table of streams by streamIdent, built by AddStream and only
+    //   read after Start. Entries are indices into streams, -1 when empty.
+    std::vector<int> table;
+    uint32_t tableMask;
+
+    // Router state
+    VRTDemuxStream *lastStream;
+    uint64_t unknownPackets;
+    uint64_t invalidPackets;
+
+    std::vector<std::thread> workers;
+    std::atomic<bool> quit;
+    bool running;
+};
+
+#endif // VRT_DEMUX_H
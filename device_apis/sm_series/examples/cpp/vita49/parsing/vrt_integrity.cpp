@@ -0,0 +1,168 @@
+#include "vrt_integrity.h"
+
+#include <cmath>
+
+VRTIntegrityMonitor::VRTIntegrityMonitor(int eventCapacity) :
+    sampleRate(0.0),
+    tolerancePs(0)
+{
+    events.resize(eventCapacity > 0 ? eventCapacity : 0);
+    Reset();
+}
+
+void VRTIntegrityMonitor::Reset()
+{
+    haveData = false;
+    lastCount = 0;
+    lastSeconds = 0;
+    lastPico = 0;
+    lastSamples = 0;
+    overRange = false;
+    invalidData = false;
+    unlocked = false;
+
+    haveContext = false;
+    lastContextCount = 0;
+
+    memset(&counters, 0, sizeof(counters));
+    ClearEvents();
+}
+
+void VRTIntegrityMonitor::ClearEvents()
+{
+    eventStart = 0;
+    eventCount = 0;
+    lostEvents = 0;
+}
+
+const VRTIntegrityEvent &VRTIntegrityMonitor::Event(int i) const
+{
+    return events[(eventStart + i) % events.size()];
+}
+
+void VRTIntegrityMonitor::Log(VRTIntegrityEventType type, uint64_t packetIndex,
+                              const VRTUserPktPrologue &prologue, int64_t value)
+{
+    if(events.empty()) {
+        lostEvents++;
+        return;
+    }
+
+    VRTIntegrityEvent *e;
+    if(eventCount == (int)events.size()) {
+        // Full, overwrite the oldest
+        e = &events[eventStart];
+        eventStart = (eventStart + 1) % events.size();
+        lostEvents++;
+    } else {
+        e = &events[(eventStart + eventCount) % events.size()];
+        eventCount++;
+    }
+
+    e->type = type;
+    e->packetIndex = packetIndex;
+    e->seconds = prologue.seconds;
+    e->picoseconds = ((uint64_t)prologue.picoUpper << 32) | prologue.picoLower;
+    e->value = value;
+}
+
+void VRTIntegrityMonitor::OnContextPacket(const VRTUserPktPrologue &prologue,
+                                          const VRTUserContextPkt &context)
+{
+    uint64_t packetIndex = counters.contextPackets++;
+
+    if(haveContext) {
+        uint32_t missing = (prologue.header.packetCount - lastContextCount - 1) & 0xF;
+        if(missing) {
+            counters.droppedContextPackets += missing;
+            Log(vrtIntegrityContextGap, packetIndex, prologue, missing);
+        }
+    }
+    haveContext = true;
+    lastContextCount = prologue.header.packetCount;
+
+    if(context.indicators.isSampleRate && context.sampleRate > 0.0) {
+        sampleRate = context.sampleRate;
+    }
+}
+
+void VRTIntegrityMonitor::OnDataPacket(const VRTUserPktPrologue &prologue,
+                                       const VRTUserDataTrailer &trailer,
+                                       uint32_t sampleCount)
+{
+    uint64_t packetIndex = counters.dataPackets++;
+    counters.samples += sampleCount;
+
+    uint64_t pico = ((uint64_t)prologue.picoUpper << 32) | prologue.picoLower;
+
+    if(haveData) {
+        // The 4-bit packet count only detects up to 15 missing packets. When the
+        //   sample rate is known the timestamp gives the exact number, assuming the
+        //   missing packets were the size of the last one.
+        int64_t missing = (prologue.header.packetCount - lastCount - 1) & 0xF;
+
+        if(sampleRate > 0.0 && lastSamples > 0) {
+            int64_t dt = (int64_t)(int32_t)(prologue.seconds - lastSeconds) * 1000000000000ll +
+                (int64_t)(pico - lastPico);
+            double packetPs = lastSamples * 1.0e12 / sampleRate;
+            double tolerance = tolerancePs ? (double)tolerancePs : 0.5e12 / sampleRate;
+
+            if(dt < 0) {
+                counters.timestampJumps++;
+                Log(vrtIntegrityTimestampReversal, packetIndex, prologue, dt);
+            } else {
+                int64_t packets = llround(dt / packetPs);
+                if(packets >= 1 && fabs(dt - packets * packetPs) <= tolerance) {
+                    missing = packets - 1;
+                } else {
+                    counters.timestampJumps++;
+                    Log(vrtIntegrityTimestampJump, packetIndex, prologue, dt - llround(packetPs));
+                }
+            }
+        }
+
+        if(missing > 0) {
+            counters.droppedPackets += missing;
+            Log(vrtIntegrityPacketGap, packetIndex, prologue, missing);
+        }
+    }
+
+    haveData = true;
+    lastCount = prologue.header.packetCount;
+    lastSeconds = prologue.seconds;
+    lastPico = pico;
+    lastSamples = sampleCount;
+
+    // Trailer, sample loss is logged on every packet, the others when they change
+    if(trailer.isSampleLoss.enabled && trailer.isSampleLoss.indicator) {
+        counters.sampleLossPackets++;
+        Log(vrtIntegritySampleLoss, packetIndex, prologue, 0);
+    }
+
+    bool packetOverRange = trailer.isOverRange.enabled && trailer.isOverRange.indicator;
+    if(packetOverRange) {
+        counters.overRangePackets++;
+        if(!overRange) {
+            Log(vrtIntegrityOverRange, packetIndex, prologue, 0);
+        }
+    }
+    overRange = packetOverRange;
+
+    bool packetInvalid = trailer.isValidData.enabled && !trailer.isValidData.indicator;
+    if(packetInvalid) {
+        counters.invalidDataPackets++;
+        if(!invalidData) {
+            Log(vrtIntegrityInvalidData, packetIndex, prologue, 0);
+        }
+    }
+    invalidData = packetInvalid;
+
+    bool packetUnlocked = trailer.isReferenceLock.enabled && !trailer.isReferenceLock.indicator;
+    if(packetUnlocked) {
+        counters.referenceUnlockPackets++;
+        if(!unlocked) {
+            Log(vrtIntegrityReferenceUnlock, packetIndex, prologue, 0);
+        }
+    }
+    unlocked = packetUnlocked;
+}
@@ -0,0 +1,123 @@
+#ifndef VRT_INTEGRITY_H
+#define VRT_INTEGRITY_H
+
+#include "sh_vrt.h"
+
+typedef enum VRTIntegrityEventType {
+    // Packet count or timestamp show packets missing before this one,
+    //   value = number of packets missing
+    vrtIntegrityPacketGap = 0,
+    // Timestamp does not follow the previous packet and sample rate, and the
+    //   jump is not explained by whole missing packets. value = error in ps
+    vrtIntegrityTimestampJump = 1,
+    // Timestamp went backwards, value = error in ps
+    vrtIntegrityTimestampReversal = 2,
+    // Trailer sample loss indicator set
+    vrtIntegritySampleLoss = 3,
+    // Trailer over-range indicator became set, logged once per run of packets
+    vrtIntegrityOverRange = 4,
+    // Trailer valid data indicator became clear, logged once per run of packets
+    vrtIntegrityInvalidData = 5,
+    // Trailer reference lock indicator became clear, logged once per run of packets
+    vrtIntegrityReferenceUnlock = 6,
+    // Context packet count skipped, value = number of packets missing
+    vrtIntegrityContextGap = 7
+} VRTIntegrityEventType;
+
+typedef struct VRTIntegrityEvent {
+    VRTIntegrityEventType type;
+    // Index of the data or context packet the event was detected on, counted from
+    //   the first packet seen
+    uint64_t packetIndex;
+    uint32_t seconds;
+    uint64_t picoseconds;
+    int64_t value;
+} VRTIntegrityEvent;
+
+typedef struct VRTIntegrityCounters {
+    uint64_t dataPackets;
+    uint64_t contextPackets;
+    uint64_t samples;
+    uint64_t droppedPackets; // Data packets
+    uint64_t droppedContextPackets;
+    uint64_t timestampJumps; // Including reversals
+    uint64_t sampleLossPackets;
+    uint64_t overRangePackets;
+    uint64_t invalidDataPackets;
+    uint64_t referenceUnlockPackets;
+} VRTIntegrityCounters;
+
+// Checks the integrity of one VRT stream across packets.
+// Data packets are checked for packet count gaps, timestamp continuity against
+//   the sample rate of the context packets, and the sample loss, over-range,
+//   valid data and reference lock trailer indicators.
+// Problems are counted and logged as events in a fixed size ring, no memory is
+//   allocated after construction and each packet costs a few comparisons, so it
+//   can run on every packet of a full rate stream.
+class VRTIntegrityMonitor
+{
+public:
+    // eventCapacity = events kept, once full the oldest events are dropped
+    VRTIntegrityMonitor(int eventCapacity = 1024);
+
+    // Timestamp errors up to this many picoseconds are ignored.
+    // Default is half a sample period at the current sample rate.
+    void SetTimestampTolerance(uint64_t picoseconds) { tolerancePs = picoseconds; }
+    // Only needed if no context packets with a sample rate are monitored
+    void SetSampleRate(double sampleRate) { this->sampleRate = sampleRate; }
+
+    void OnContextPacket(const VRTUserContextPkt &pkt) { OnContextPacket(pkt.prologue, pkt); }
+    // For context packets which were not decoded again, e.g. repeats skipped by
+    //   VRTContextCache. context = the last decoded context of the stream
+    void OnContextPacket(const VRTUserPktPrologue &prologue, const VRTUserContextPkt &context);
+    void OnDataPacket(const VRTUserPktPrologue &prologue, const VRTUserDataTrailer &trailer,
+                      uint32_t sampleCount);
+    void OnDataPacket(const VRTDataPktView &view)
+    {
+        OnDataPacket(view.prologue, view.trailer, view.sampleCount);
+    }
+    void OnDataPacket(const VRTUserDataPkt &pkt)
+    {
+        OnDataPacket(pkt.prologue, pkt.trailer, (uint32_t)(pkt.data.size() / 2));
+    }
+
+    const VRTIntegrityCounters &Counters() const { return counters; }
+
+    // Logged events, oldest first
+    int EventCount() const { return eventCount; }
+    const VRTIntegrityEvent &Event(int i) const;
+    // Number of events dropped because the ring was full
+    uint64_t LostEvents() const { return lostEvents; }
+    void ClearEvents();
+
+    // Forget all state, counters and events
+    void Reset();
+
+private:
+    void Log(VRTIntegrityEventType type, uint64_t packetIndex,
+             const VRTUserPktPrologue &prologue, int64_t value);
+
+    double sampleRate;
+    uint64_t tolerancePs;
+
+    bool haveData;
+    uint32_t lastCount;
+    uint32_t lastSeconds;
+    uint64_t lastPico;
+    uint32_t lastSamples;
+    bool overRange;
+    bool invalidData;
+    bool unlocked;
+
+    bool haveContext;
+    uint32_t lastContextCount;
+
+    VRTIntegrityCounters counters;
+
+    std::vector<VRTIntegrityEvent> events;
+    int eventStart;
+    int eventCount;
+    uint64_t lostEvents;
+};
+
+#endif // VRT_INTEGRITY_H
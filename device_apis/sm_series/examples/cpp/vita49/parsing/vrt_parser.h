@@ -10,14 +10,29 @@
 class VRTParser
 {
 public:
+    VRTParser() : reflevel(0.0), scaleReflevel(0.0), scale(1.0f) {}
+
     int ParseDataPacket(uint32_t *words, uint32_t wordCount, VRTUserDataPkt &parsed);
-    int ParseContextPacket(uint32_t *words, uint32_t wordCount, VRTUserContextPkt &parsed);
+    // Zero-copy alternative, words is left unchanged and nothing is allocated.
+    // Convert the samples into a caller buffer with UnpackSamples.
+    int ParseDataPacket(const uint32_t *words, uint32_t wordCount, VRTDataPktView &view);
+    // Decodes every context field, see vrtParseContextPacket. words is left unchanged.
+    int ParseContextPacket(const uint32_t *words, uint32_t wordCount, VRTUserContextPkt &parsed);
     void Peek(const uint32_t *pkts, SmVRTPacketType *packetType, uint32_t *packetSize);
 
     VRTUserPktPrologue ParsePrologue(const VRTPktPrologue &prologue);
     void UnpackSamples(const int16_t* src, float* dst, int len);
+    // dst = 2 * view.sampleCount floats
+    void UnpackSamples(const VRTDataPktView &view, float *dst);
 
     double reflevel;
+
+private:
+    // Returns the sqrt(mW) amplitude of reflevel, only recomputed when reflevel changes
+    float Scale();
+
+    double scaleReflevel;
+    float scale;
 };
 
 #endif // PARSER_H
@@ -1,6 +1,9 @@
 #include "vrt_parser.h"
+#include "vrt_blob_parser.h"
+#include "vrt_integrity.h"
 
 #include <cassert>
+#include <cstdio>
 
 int main()
 {
@@ -98,8 +101,12 @@ int main()
     smGetRefLevel(device, &reflevel);
     parser.reflevel = reflevel;
 
-    VRTUserDataPkt dataPkt;
+    // Data packets are parsed in place and converted straight into this buffer
+    VRTDataPktView dataPkt;
+    std::vector<float> iq(samplesPerPacketReturn * 2);
     VRTUserContextPkt contextPkt;
+    // Checks for dropped packets, timestamp discontinuities and sample loss
+    VRTIntegrityMonitor monitor;
 
     curr = words;
     while(curr - words < wordCount) {
@@ -108,20 +115,54 @@ int main()
         uint32_t packetSize;
         parser.Peek(curr, &packetType, &packetSize);
 
+        int parsedSize = -1;
         switch(packetType) {
         case smVRTDataPacket:
-            curr += parser.ParseDataPacket(curr, packetSize, dataPkt);
+            parsedSize = parser.ParseDataPacket(curr, packetSize, dataPkt);
+            if(parsedSize > 0) {
+                iq.resize(dataPkt.sampleCount * 2);
+                parser.UnpackSamples(dataPkt, iq.data());
+                monitor.OnDataPacket(dataPkt);
+            }
             break;
         case smVRTContextPacket:
-            curr += parser.ParseContextPacket(curr, packetSize, contextPkt);
+            parsedSize = parser.ParseContextPacket(curr, packetSize, contextPkt);
+            if(parsedSize > 0) {
+                monitor.OnContextPacket(contextPkt);
+            }
             break;
         default:
             // Memory pointed to is not a valid SM Series VRT packet
             break;
         }
+
+        if(parsedSize <= 0) {
+            break;
+        }
+        curr += parsedSize;
     }
 
     int wordsParsed = curr - words;
+    const VRTIntegrityCounters &integrity = monitor.Counters();
+    printf("Parsed %d of %u words, %llu data packets, %llu context packets\n", wordsParsed, wordCount,
+           (unsigned long long)integrity.dataPackets, (unsigned long long)integrity.contextPackets);
+    printf("Dropped packets %llu, timestamp jumps %llu, sample loss %llu, over range %llu\n",
+           (unsigned long long)integrity.droppedPackets, (unsigned long long)integrity.timestampJumps,
+           (unsigned long long)integrity.sampleLossPackets, (unsigned long long)integrity.overRangePackets);
+
+    // Alternatively, parse the whole blob at once, with the data packets converted
+    //   across all cores. See vrt_blob_parser.h.
+    VRTBlobParser blobParser;
+    blobParser.reflevel = reflevel;
+    uint32_t blobWordsParsed = blobParser.Parse(words, wordCount);
+    const std::vector<VRTBlobDataPkt> &blobDataPkts = blobParser.DataPackets();
+    // Both passes see the same packets
+    bool blobMatches = blobWordsParsed == (uint32_t)wordsParsed &&
+        blobDataPkts.size() == integrity.dataPackets &&
+        blobParser.ContextPackets().size() == integrity.contextPackets;
+    printf("Blob parser: %u words, %zu data packets, %zu context packets, %s\n", blobWordsParsed,
+           blobDataPkts.size(), blobParser.ContextPackets().size(),
+           blobMatches ? "matches" : "does not match");
 
 	smCloseDevice(device);
 
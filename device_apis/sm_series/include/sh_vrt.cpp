@@ -6,11 +6,345 @@
 
 #include <chrono>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VRT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang require each function using SIMD intrinsics to be marked with the
+//   instruction set, MSVC compiles intrinsics for any instruction set.
+#if defined(VRT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VRT_SSSE3 __attribute__((target("ssse3")))
+#define VRT_AVX2 __attribute__((target("avx2")))
+#define VRT_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define VRT_SSSE3
+#define VRT_AVX2
+#define VRT_AVX512
+#endif
+
 #pragma warning(disable:4800)
 
 // Use some static variable at some point
 static uint32_t dataPacketCount = 0;
 
+//
+// Byte swapping
+//
+
+struct VrtKernels {
+    VrtSwapIsa isa;
+    void (*swap)(const uint32_t *src, uint32_t *dst, uint32_t wordCount);
+    void (*unpack16sc)(const int16_t *src, float *dst, uint32_t count, float k);
+    void (*unpack16scBE)(const uint32_t *src, float *dst, uint32_t wordCount, float k);
+};
+
+static void vrtSwapScalar(const uint32_t *src, uint32_t *dst, uint32_t wordCount)
+{
+    for(uint32_t i = 0; i < wordCount; i++) {
+        dst[i] = swapWord(src[i]);
+    }
+}
+
+// k = scale / 32768 for all the unpack kernels
+static void vrtUnpack16scScalar(const int16_t *src, float *dst, uint32_t count, float k)
+{
+    for(uint32_t i = 0; i < count; i++) {
+        dst[i] = (float)src[i] * k;
+    }
+}
+
+// Each swapped word holds a pair of int16 values, low half first in memory
+static void vrtUnpack16scBEScalar(const uint32_t *src, float *dst, uint32_t wordCount, float k)
+{
+    for(uint32_t i = 0; i < wordCount; i++) {
+        uint32_t w = swapWord(src[i]);
+        dst[2 * i] = (float)(int16_t)(w & 0xFFFF) * k;
+        dst[2 * i + 1] = (float)(int16_t)(w >> 16) * k;
+    }
+}
+
+#ifdef VRT_X86
+
+VRT_SSSE3 static void vrtSwapSSSE3(const uint32_t *src, uint32_t *dst, uint32_t wordCount)
+{
+    // Reverses the 4 bytes of each word
+    const __m128i shuffle = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    uint32_t i = 0;
+    for(; i + 8 <= wordCount; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(a, shuffle));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_shuffle_epi8(b, shuffle));
+    }
+
+    vrtSwapScalar(src + i, dst + i, wordCount - i);
+}
+
+// Sign extends the int16 values of x to two vectors of 4 floats and scales them
+VRT_SSSE3 static inline void vrtStore16scSSSE3(float *dst, __m128i x, __m128 k)
+{
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+    _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+}
+
+VRT_SSSE3 static void vrtUnpack16scSSSE3(const int16_t *src, float *dst, uint32_t count, float k)
+{
+    const __m128 vk = _mm_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        vrtStore16scSSSE3(dst + i, _mm_loadu_si128((const __m128i*)(src + i)), vk);
+    }
+
+    vrtUnpack16scScalar(src + i, dst + i, count - i, k);
+}
+
+VRT_SSSE3 static void vrtUnpack16scBESSSE3(const uint32_t *src, float *dst, uint32_t wordCount, float k)
+{
+    const __m128i shuffle = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const __m128 vk = _mm_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 4 <= wordCount; i += 4) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), shuffle);
+        vrtStore16scSSSE3(dst + 2 * i, x, vk);
+    }
+
+    vrtUnpack16scBEScalar(src + i, dst + 2 * i, wordCount - i, k);
+}
+
+VRT_AVX2 static void vrtSwapAVX2(const uint32_t *src, uint32_t *dst, uint32_t wordCount)
+{
+    // Shuffles only move bytes within each 128-bit lane, the same pattern in every lane
+    const __m256i shuffle = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    uint32_t i = 0;
+    for(; i + 32 <= wordCount; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 24));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(a, shuffle));
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_shuffle_epi8(b, shuffle));
+        _mm256_storeu_si256((__m256i*)(dst + i + 16), _mm256_shuffle_epi8(c, shuffle));
+        _mm256_storeu_si256((__m256i*)(dst + i + 24), _mm256_shuffle_epi8(d, shuffle));
+    }
+    for(; i + 8 <= wordCount; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(a, shuffle));
+    }
+
+    vrtSwapScalar(src + i, dst + i, wordCount - i);
+}
+
+// Sign extends the 16 int16 values of x to two vectors of 8 floats and scales them
+VRT_AVX2 static inline void vrtStore16scAVX2(float *dst, __m256i x, __m256 k)
+{
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1));
+    _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), k));
+    _mm256_storeu_ps(dst + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), k));
+}
+
+VRT_AVX2 static void vrtUnpack16scAVX2(const int16_t *src, float *dst, uint32_t count, float k)
+{
+    const __m256 vk = _mm256_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        vrtStore16scAVX2(dst + i, _mm256_loadu_si256((const __m256i*)(src + i)), vk);
+    }
+
+    vrtUnpack16scScalar(src + i, dst + i, count - i, k);
+}
+
+VRT_AVX2 static void vrtUnpack16scBEAVX2(const uint32_t *src, float *dst, uint32_t wordCount, float k)
+{
+    const __m256i shuffle = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const __m256 vk = _mm256_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 8 <= wordCount; i += 8) {
+        __m256i x = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), shuffle);
+        vrtStore16scAVX2(dst + 2 * i, x, vk);
+    }
+
+    vrtUnpack16scBEScalar(src + i, dst + 2 * i, wordCount - i, k);
+}
+
+VRT_AVX512 static void vrtSwapAVX512(const uint32_t *src, uint32_t *dst, uint32_t wordCount)
+{
+    const __m512i shuffle = _mm512_broadcast_i32x4(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+
+    uint32_t i = 0;
+    for(; i + 64 <= wordCount; i += 64) {
+        __m512i a = _mm512_loadu_si512(src + i);
+        __m512i b = _mm512_loadu_si512(src + i + 16);
+        __m512i c = _mm512_loadu_si512(src + i + 32);
+        __m512i d = _mm512_loadu_si512(src + i + 48);
+        _mm512_storeu_si512(dst + i, _mm512_shuffle_epi8(a, shuffle));
+        _mm512_storeu_si512(dst + i + 16, _mm512_shuffle_epi8(b, shuffle));
+        _mm512_storeu_si512(dst + i + 32, _mm512_shuffle_epi8(c, shuffle));
+        _mm512_storeu_si512(dst + i + 48, _mm512_shuffle_epi8(d, shuffle));
+    }
+    for(; i + 16 <= wordCount; i += 16) {
+        __m512i a = _mm512_loadu_si512(src + i);
+        _mm512_storeu_si512(dst + i, _mm512_shuffle_epi8(a, shuffle));
+    }
+    // Masked loads and stores do not touch the words past the end
+    if(i < wordCount) {
+        __mmask16 mask = (__mmask16)((1u << (wordCount - i)) - 1);
+        __m512i a = _mm512_maskz_loadu_epi32(mask, src + i);
+        _mm512_mask_storeu_epi32(dst + i, mask, _mm512_shuffle_epi8(a, shuffle));
+    }
+}
+
+// Sign extends the 32 int16 values of x to two vectors of 16 floats and scales them.
+// mask = floats to store, so the tail can be handled with the same code
+VRT_AVX512 static inline void vrtStore16scAVX512(float *dst, __m512i x, __m512 k, uint32_t mask)
+{
+    __m512i lo = _mm512_cvtepi16_epi32(_mm512_castsi512_si256(x));
+    __m512i hi = _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(x, 1));
+    _mm512_mask_storeu_ps(dst, (__mmask16)mask, _mm512_mul_ps(_mm512_cvtepi32_ps(lo), k));
+    _mm512_mask_storeu_ps(dst + 16, (__mmask16)(mask >> 16), _mm512_mul_ps(_mm512_cvtepi32_ps(hi), k));
+}
+
+VRT_AVX512 static void vrtUnpack16scAVX512(const int16_t *src, float *dst, uint32_t count, float k)
+{
+    const __m512 vk = _mm512_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 32 <= count; i += 32) {
+        vrtStore16scAVX512(dst + i, _mm512_loadu_si512(src + i), vk, 0xFFFFFFFF);
+    }
+    if(i < count) {
+        __mmask32 mask = (__mmask32)((1ull << (count - i)) - 1);
+        vrtStore16scAVX512(dst + i, _mm512_maskz_loadu_epi16(mask, src + i), vk, mask);
+    }
+}
+
+VRT_AVX512 static void vrtUnpack16scBEAVX512(const uint32_t *src, float *dst, uint32_t wordCount, float k)
+{
+    const __m512i shuffle = _mm512_broadcast_i32x4(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+    const __m512 vk = _mm512_set1_ps(k);
+
+    uint32_t i = 0;
+    for(; i + 16 <= wordCount; i += 16) {
+        __m512i x = _mm512_shuffle_epi8(_mm512_loadu_si512(src + i), shuffle);
+        vrtStore16scAVX512(dst + 2 * i, x, vk, 0xFFFFFFFF);
+    }
+    if(i < wordCount) {
+        __mmask16 mask = (__mmask16)((1u << (wordCount - i)) - 1);
+        __m512i x = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi32(mask, src + i), shuffle);
+        vrtStore16scAVX512(dst + 2 * i, x, vk, (uint32_t)((1ull << (2 * (wordCount - i))) - 1));
+    }
+}
+
+static bool vrtCpuSupports(VrtSwapIsa isa)
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    int maxLeaf = regs[0];
+
+    __cpuid(regs, 1);
+    bool ssse3 = (regs[2] & (1 << 9)) != 0;
+    if(isa == vrtSwapIsaSSSE3) {
+        return ssse3;
+    }
+
+    // OSXSAVE and AVX so XCR0 can be checked for OS support of the YMM and ZMM registers
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    if(maxLeaf < 7 || !osxsave || !avx) {
+        return isa == vrtSwapIsaScalar;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+
+    __cpuidex(regs, 7, 0);
+    bool avx2 = (regs[1] & (1 << 5)) != 0;
+    bool avx512f = (regs[1] & (1 << 16)) != 0;
+    bool avx512bw = (regs[1] & (1 << 30)) != 0;
+
+    if(isa == vrtSwapIsaAVX2) {
+        return avx2 && ((xcr0 & 0x6) == 0x6);
+    }
+    if(isa == vrtSwapIsaAVX512) {
+        return avx512f && avx512bw && ((xcr0 & 0xE6) == 0xE6);
+    }
+    return true;
+#else
+    __builtin_cpu_init();
+    if(isa == vrtSwapIsaSSSE3) {
+        return __builtin_cpu_supports("ssse3");
+    }
+    if(isa == vrtSwapIsaAVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if(isa == vrtSwapIsaAVX512) {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    return true;
+#endif
+}
+
+#endif // VRT_X86
+
+static VrtKernels vrtMakeKernels(VrtSwapIsa isa)
+{
+    VrtKernels k;
+
+#ifdef VRT_X86
+    if(isa >= vrtSwapIsaAVX512 && vrtCpuSupports(vrtSwapIsaAVX512)) {
+        k.isa = vrtSwapIsaAVX512;
+        k.swap = vrtSwapAVX512;
+        k.unpack16sc = vrtUnpack16scAVX512;
+        k.unpack16scBE = vrtUnpack16scBEAVX512;
+        return k;
+    }
+    if(isa >= vrtSwapIsaAVX2 && vrtCpuSupports(vrtSwapIsaAVX2)) {
+        k.isa = vrtSwapIsaAVX2;
+        k.swap = vrtSwapAVX2;
+        k.unpack16sc = vrtUnpack16scAVX2;
+        k.unpack16scBE = vrtUnpack16scBEAVX2;
+        return k;
+    }
+    if(isa >= vrtSwapIsaSSSE3 && vrtCpuSupports(vrtSwapIsaSSSE3)) {
+        k.isa = vrtSwapIsaSSSE3;
+        k.swap = vrtSwapSSSE3;
+        k.unpack16sc = vrtUnpack16scSSSE3;
+        k.unpack16scBE = vrtUnpack16scBESSSE3;
+        return k;
+    }
+#endif
+
+    k.isa = vrtSwapIsaScalar;
+    k.swap = vrtSwapScalar;
+    k.unpack16sc = vrtUnpack16scScalar;
+    k.unpack16scBE = vrtUnpack16scBEScalar;
+    return k;
+}
+
+static VrtKernels &vrtKernels()
+{
+    // Selected once, the first time it is needed
+    static VrtKernels kernels = vrtMakeKernels(vrtSwapIsaAVX512);
+    return kernels;
+}
+
 int vrtSwapBytes(uint32_t *srcDst, uint32_t wordCount)
 {
     return vrtSwapBytes(srcDst, srcDst, wordCount);
@@ -20,11 +354,109 @@ int vrtSwapBytes(const uint32_t *src, uint32_t *dst, uint32_t wordCount)
 {
     if(!src || !dst) return -1;
 
+    vrtKernels().swap(src, dst, wordCount);
+
+    return 0;
+}
+
+void vrtUnpack16sc(const int16_t *src, float *dst, uint32_t count, float scale)
+{
+    vrtKernels().unpack16sc(src, dst, count, scale / 32768.0f);
+}
+
+void vrtUnpack16scBE(const uint32_t *src, float *dst, uint32_t wordCount, float scale)
+{
+    vrtKernels().unpack16scBE(src, dst, wordCount, scale / 32768.0f);
+}
+
+VrtSwapIsa vrtGetSwapIsa()
+{
+    return vrtKernels().isa;
+}
+
+VrtSwapIsa vrtSetSwapIsa(VrtSwapIsa isa)
+{
+    vrtKernels() = vrtMakeKernels(isa);
+    return vrtKernels().isa;
+}
+
+enum VrtBenchmarkOp {
+    vrtBenchmarkSwapInPlace,
+    vrtBenchmarkSwapCopy,
+    vrtBenchmarkUnpackBE
+};
+
+static void vrtRunBenchmarkOp(VrtBenchmarkOp op, uint32_t *src, uint32_t *dst, float *iq, uint32_t wordCount)
+{
+    switch(op) {
+    case vrtBenchmarkSwapInPlace:
+        vrtSwapBytes(dst, wordCount);
+        break;
+    case vrtBenchmarkSwapCopy:
+        vrtSwapBytes(src, dst, wordCount);
+        break;
+    case vrtBenchmarkUnpackBE:
+        vrtUnpack16scBE(src, iq, wordCount, 1.0f);
+        break;
+    }
+}
+
+// Returns GB/s of packet data
+static double vrtTimeOp(VrtBenchmarkOp op, uint32_t *src, uint32_t *dst, float *iq,
+                        uint32_t wordCount, double seconds)
+{
+    typedef std::chrono::steady_clock clock;
+
+    // Warm the caches
+    vrtRunBenchmarkOp(op, src, dst, iq, wordCount);
+
+    uint64_t bytes = 0;
+    uint32_t reps = 1;
+    double elapsed = 0.0;
+    clock::time_point start = clock::now();
+    while(elapsed < seconds) {
+        for(uint32_t r = 0; r < reps; r++) {
+            vrtRunBenchmarkOp(op, src, dst, iq, wordCount);
+        }
+        bytes += (uint64_t)reps * wordCount * sizeof(uint32_t);
+        reps *= 2;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    return (double)bytes / elapsed * 1.0e-9;
+}
+
+int vrtBenchmarkSwapBytes(uint32_t wordCount, double seconds, VrtSwapBenchmarkResult *results)
+{
+    static const char *names[] = { "Scalar", "SSSE3", "AVX2", "AVX-512" };
+
+    if(!results || wordCount == 0) {
+        return 0;
+    }
+
+    std::vector<uint32_t> src(wordCount), dst(wordCount);
+    std::vector<float> iq(wordCount * 2);
     for(uint32_t i = 0; i < wordCount; i++) {
-        dst[i] = swapWord(src[i]);
+        src[i] = i * 0x9E3779B9u;
     }
 
-    return 0;
+    VrtSwapIsa selected = vrtGetSwapIsa();
+    int count = 0;
+    for(int isa = vrtSwapIsaScalar; isa <= vrtSwapIsaAVX512; isa++) {
+        if(vrtSetSwapIsa((VrtSwapIsa)isa) != isa) {
+            continue;
+        }
+
+        VrtSwapBenchmarkResult &r = results[count++];
+        r.isa = (VrtSwapIsa)isa;
+        r.name = names[isa];
+        r.inPlaceGBps = vrtTimeOp(vrtBenchmarkSwapInPlace, &src[0], &dst[0], &iq[0], wordCount, seconds);
+        r.copyGBps = vrtTimeOp(vrtBenchmarkSwapCopy, &src[0], &dst[0], &iq[0], wordCount, seconds);
+        r.unpackGBps = vrtTimeOp(vrtBenchmarkUnpackBE, &src[0], &dst[0], &iq[0], wordCount, seconds);
+    }
+    vrtSetSwapIsa(selected);
+
+    return count;
 }
 
 VrtTemp vrtConvertFloatToTemp(float temp)
@@ -108,6 +540,415 @@ uint32_t vrtGetAssociatedContextPktCount(uint32_t pktTrlr)
     return (pktTrlr & 0x0000003F);
 }
 
+// Prologue plus trailer
+static const uint32_t VRT_DATA_PKT_OVERHEAD = sizeof(VRTDataPktMetadata) / sizeof(uint32_t) + 1;
+
+int vrtParseDataPacketView(const uint32_t *words, uint32_t wordCount, VRTDataPktView &view)
+{
+    if(!words || wordCount < VRT_DATA_PKT_OVERHEAD) {
+        return -1;
+    }
+
+    uint32_t header = swapWord(words[0]);
+    uint32_t packetSize = vrtGetPacketSize(header);
+    if(vrtGetPacketType(header) != VRT_DATA_PKT_TYPE ||
+       packetSize < VRT_DATA_PKT_OVERHEAD || packetSize > wordCount) {
+        return -1;
+    }
+
+    view.prologue.header.packetType = VRT_DATA_PKT_TYPE;
+    view.prologue.header.packetCount = vrtGetPacketCount(header);
+    view.prologue.header.packetSize = packetSize;
+    view.prologue.streamIdent = swapWord(words[1]);
+    view.prologue.seconds = swapWord(words[2]);
+    view.prologue.picoUpper = swapWord(words[3]);
+    view.prologue.picoLower = swapWord(words[4]);
+
+    view.payload = words + sizeof(VRTDataPktMetadata) / sizeof(uint32_t);
+    view.sampleCount = packetSize - VRT_DATA_PKT_OVERHEAD;
+
+    view.trailerWord = swapWord(words[packetSize - 1]);
+    vrtParseDataTrailer(view.trailerWord, view.trailer);
+
+    return (int)packetSize;
+}
+
+// Size in words of the field of each context indicator bit, by bit number.
+// Bits 0-8 are reserved or variable length and are not decoded.
+static constexpr uint8_t vrtCntxFieldSizes[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0,
+    VRT_CNTX_GPS_ASCII_SIZE,
+    VRT_CNTX_EPHEMERIS_REF_SIZE,
+    VRT_CNTX_RELATIVE_EPHEMERIS_SIZE,
+    VRT_CNTX_ECEF_SIZE,
+    VRT_CNTX_FORMATTED_INS_SIZE,
+    VRT_CNTX_FORMATTED_GPS_SIZE,
+    VRT_CNTX_IF_PAYLOAD_SIZE,
+    VRT_CNTX_STATE_EVENT_SIZE,
+    VRT_CNTX_DEVICE_ID_SIZE,
+    VRT_CNTX_TEMPERATURE_SIZE,
+    VRT_CNTX_TIMESTAMP_CAL_SIZE,
+    VRT_CNTX_TIMESTAMP_ADJUST_SIZE,
+    VRT_CNTX_SAMPLE_RATE_SIZE,
+    VRT_CNTX_OVER_RANGE_SIZE,
+    VRT_CNTX_GAIN_SIZE,
+    VRT_CNTX_REFERENCE_LEVEL_SIZE,
+    VRT_CNTX_IF_BAND_OFFSET_SIZE,
+    VRT_CNTX_FREQ_OFFSET_SIZE,
+    VRT_CNTX_RF_FREQ_SIZE,
+    VRT_CNTX_IF_FREQ_SIZE,
+    VRT_CNTX_BANDWIDTH_SIZE,
+    VRT_CNTX_REFERENCE_POINT_SIZE,
+    VRT_CNTX_FIELD_CHANGE_SIZE
+};
+
+// Indicator bits whose fields are size words long
+static constexpr uint32_t vrtCntxSizeMask(uint32_t size, int bit = 31)
+{
+    return (bit < 0) ? 0 :
+        (((vrtCntxFieldSizes[bit] == size) ? (1u << bit) : 0) | vrtCntxSizeMask(size, bit - 1));
+}
+
+// Words of every field, and of the largest one
+static constexpr uint32_t vrtCntxTotalSize(int bit = 31)
+{
+    return (bit < 0) ? 0 : vrtCntxFieldSizes[bit] + vrtCntxTotalSize(bit - 1);
+}
+
+static constexpr uint32_t vrtCntxMaxSize(int bit = 31, uint32_t largest = 0)
+{
+    return (bit < 0) ? largest :
+        vrtCntxMaxSize(bit - 1, (vrtCntxFieldSizes[bit] > largest) ? vrtCntxFieldSizes[bit] : largest);
+}
+
+static constexpr uint32_t VRT_CNTX_ALL_FIELDS_SIZE = vrtCntxTotalSize();
+static constexpr uint32_t VRT_CNTX_LARGEST_FIELD_SIZE = vrtCntxMaxSize();
+
+static constexpr uint32_t VRT_CNTX_SIZE1_BITS = vrtCntxSizeMask(VRT_CNTX_REFERENCE_POINT_SIZE);
+static constexpr uint32_t VRT_CNTX_SIZE2_BITS = vrtCntxSizeMask(VRT_CNTX_BANDWIDTH_SIZE);
+static constexpr uint32_t VRT_CNTX_SIZE11_BITS = vrtCntxSizeMask(VRT_CNTX_FORMATTED_GPS_SIZE);
+static constexpr uint32_t VRT_CNTX_SIZE13_BITS = vrtCntxSizeMask(VRT_CNTX_ECEF_SIZE);
+static_assert((VRT_CNTX_SIZE1_BITS | VRT_CNTX_SIZE2_BITS | VRT_CNTX_SIZE11_BITS | VRT_CNTX_SIZE13_BITS) ==
+              ~vrtCntxSizeMask(0), "Every context field size needs a mask in vrtCntxWords");
+
+// The decoder is built twice, with the POPCNT instruction and with a portable
+//   bit count for older CPUs, and the variant is chosen the first time it is used.
+//   The instruction is only emitted into functions marked VRT_POPCNT, so the
+//   generic code shared by both variants must be inlined into them.
+#if defined(VRT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VRT_POPCNT __attribute__((target("popcnt")))
+#define VRT_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define VRT_POPCNT
+#define VRT_FORCE_INLINE __forceinline
+#else
+#define VRT_POPCNT
+#define VRT_FORCE_INLINE inline
+#endif
+
+template<bool HwPopcount>
+static VRT_FORCE_INLINE uint32_t vrtPopcount(uint32_t x)
+{
+#ifdef VRT_X86
+    if(HwPopcount) {
+#ifdef _MSC_VER
+        return (uint32_t)_mm_popcnt_u32(x);
+#else
+        return (uint32_t)__builtin_popcount(x);
+#endif
+    }
+#endif
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+// Words of the fields of the given indicator bits
+template<bool HwPopcount>
+static VRT_FORCE_INLINE uint32_t vrtCntxWords(uint32_t bits)
+{
+    return vrtPopcount<HwPopcount>(bits & VRT_CNTX_SIZE1_BITS) * VRT_CNTX_REFERENCE_POINT_SIZE +
+        vrtPopcount<HwPopcount>(bits & VRT_CNTX_SIZE2_BITS) * VRT_CNTX_BANDWIDTH_SIZE +
+        vrtPopcount<HwPopcount>(bits & VRT_CNTX_SIZE11_BITS) * VRT_CNTX_FORMATTED_GPS_SIZE +
+        vrtPopcount<HwPopcount>(bits & VRT_CNTX_SIZE13_BITS) * VRT_CNTX_ECEF_SIZE;
+}
+
+// Field of bit in the host order field copy, or the zeros after the fields when
+//   the field is not present
+template<bool HwPopcount>
+static VRT_FORCE_INLINE const uint32_t *vrtCntxField(const uint32_t *fields, uint32_t indicators,
+                                                     uint32_t fieldWords, uint32_t bit)
+{
+    // Only the fields of higher bits come first
+    uint32_t offset = vrtCntxWords<HwPopcount>(indicators & ~(bit | (bit - 1)));
+    return fields + ((indicators & bit) ? offset : fieldWords);
+}
+
+uint32_t vrtGetContextFieldOffset(uint32_t indicators, uint32_t bit)
+{
+    return vrtCntxWords<false>(indicators & ~(bit | (bit - 1)));
+}
+
+uint32_t vrtGetContextFieldsSize(uint32_t indicators)
+{
+    return vrtCntxWords<false>(indicators);
+}
+
+static inline double vrtFixedToDouble(int32_t val, int fracBits)
+{
+    return double(val) / (0x1 << fracBits);
+}
+
+static void vrtDecodeFormattedGPS(const uint32_t *words, VRTUserGPS &gps)
+{
+    VRTFormattedGPS f;
+    memcpy(&f, words, sizeof(f));
+
+    gps.latitude = vrtFixedToDouble(f.latitude, 22);
+    gps.longitude = vrtFixedToDouble(f.longitude, 22);
+    gps.altitude = vrtFixedToDouble((int32_t)f.altitude, 5);
+    gps.speedOverGround = vrtFixedToDouble(f.speedOverGround, 16);
+    gps.headingAngle = vrtFixedToDouble((int32_t)f.headingAngle, 22);
+    gps.trackAngle = vrtFixedToDouble(f.trackAngle, 22);
+    gps.magneticVariation = vrtFixedToDouble((int32_t)f.magneticVariation, 22);
+    gps.seconds = f.timestampInt;
+    gps.picoUpper = f.timestampFracUpper;
+    gps.picoLower = f.timestampFracLower;
+}
+
+static void vrtDecodeEphemeris(const uint32_t *words, VRTUserEphemeris &eph)
+{
+    VRTFormattedEphemeris f;
+    memcpy(&f, words, sizeof(f));
+
+    eph.positionX = vrtFixedToDouble(f.positionX, 5);
+    eph.positionY = vrtFixedToDouble(f.positionY, 5);
+    eph.positionZ = vrtFixedToDouble(f.positionZ, 5);
+    eph.attitudeAlpha = vrtFixedToDouble(f.attitudeAlpha, 22);
+    eph.attitudeBeta = vrtFixedToDouble(f.attitudeBeta, 22);
+    eph.attitudePhi = vrtFixedToDouble(f.attitudePhi, 22);
+    eph.velocityX = vrtFixedToDouble(f.velocityX, 16);
+    eph.velocityY = vrtFixedToDouble(f.velocityY, 16);
+    eph.velocityZ = vrtFixedToDouble(f.velocityZ, 16);
+    eph.seconds = f.timestampInt;
+    eph.picoUpper = f.timestampFracUpper;
+    eph.picoLower = f.timestampFracLower;
+}
+
+template<bool HwPopcount>
+static VRT_FORCE_INLINE int vrtParseContextPacketT(const uint32_t *words, uint32_t wordCount,
+                                                  VRTUserContextPkt &parsed)
+{
+    const uint32_t metadataWords = sizeof(VRTContextPktMetadata) / sizeof(uint32_t);
+    if(!words || wordCount < metadataWords) {
+        return -1;
+    }
+
+    uint32_t header = swapWord(words[0]);
+    uint32_t packetSize = vrtGetPacketSize(header);
+    uint32_t indicators = swapWord(words[5]);
+    uint32_t fieldWords = vrtCntxWords<HwPopcount>(indicators);
+    if(vrtGetPacketType(header) != VRT_CNTX_PKT_TYPE || packetSize > wordCount ||
+       packetSize < metadataWords + fieldWords) {
+        return -1;
+    }
+
+    parsed.prologue.header.packetType = VRT_CNTX_PKT_TYPE;
+    parsed.prologue.header.packetCount = vrtGetPacketCount(header);
+    parsed.prologue.header.packetSize = packetSize;
+    parsed.prologue.streamIdent = swapWord(words[1]);
+    parsed.prologue.seconds = swapWord(words[2]);
+    parsed.prologue.picoUpper = swapWord(words[3]);
+    parsed.prologue.picoLower = swapWord(words[4]);
+
+    // Host order copy of the fields followed by zeros. A field that is not present
+    //   is read from the zeros, so every field is decoded the same way without
+    //   walking the indicator bits.
+    uint32_t fields[VRT_CNTX_ALL_FIELDS_SIZE + VRT_CNTX_LARGEST_FIELD_SIZE];
+    vrtSwapBytes(words + metadataWords, fields, fieldWords);
+    memset(fields + fieldWords, 0, VRT_CNTX_LARGEST_FIELD_SIZE * sizeof(uint32_t));
+
+#define field(bit) vrtCntxField<HwPopcount>(fields, indicators, fieldWords, bit)
+
+    VRTUserContextIndicators &ind = parsed.indicators;
+    ind.isContextFieldChanged = (indicators & VRT_CNTX_FIELD_CHANGE_BIT) != 0;
+    ind.isReferencePoint = (indicators & VRT_CNTX_REFERENCE_POINT_BIT) != 0;
+    ind.isBandwidth = (indicators & VRT_CNTX_BANDWIDTH_BIT) != 0;
+    ind.isIfFreq = (indicators & VRT_CNTX_IF_FREQ_BIT) != 0;
+    ind.isRfFreq = (indicators & VRT_CNTX_RF_FREQ_BIT) != 0;
+    ind.isRfFreqOffset = (indicators & VRT_CNTX_FREQ_OFFSET_BIT) != 0;
+    ind.isIfBandOffset = (indicators & VRT_CNTX_IF_BAND_OFFSET_BIT) != 0;
+    ind.isReflevel = (indicators & VRT_CNTX_REFERENCE_LEVEL_BIT) != 0;
+    ind.isaAtten = (indicators & VRT_CNTX_GAIN_BIT) != 0;
+    ind.isOverRange = (indicators & VRT_CNTX_OVER_RANGE_BIT) != 0;
+    ind.isSampleRate = (indicators & VRT_CNTX_SAMPLE_RATE_BIT) != 0;
+    ind.isTimestampAdjust = (indicators & VRT_CNTX_TIMESTAMP_ADJUST_BIT) != 0;
+    ind.isTimestampCal = (indicators & VRT_CNTX_TIMESTAMP_CAL_BIT) != 0;
+    ind.isTemperature = (indicators & VRT_CNTX_TEMPERATURE_BIT) != 0;
+    ind.isDevUid = (indicators & VRT_CNTX_DEVICE_ID_BIT) != 0;
+    ind.isDevModel = ind.isDevUid;
+    ind.isStateEvent = (indicators & VRT_CNTX_STATE_EVENT_BIT) != 0;
+    ind.isPayloadFormat = (indicators & VRT_CNTX_IF_PAYLOAD_BIT) != 0;
+    ind.isGPS = (indicators & VRT_CNTX_FORMATTED_GPS_BIT) != 0;
+    ind.isINS = (indicators & VRT_CNTX_FORMATTED_INS_BIT) != 0;
+    ind.isECEF = (indicators & VRT_CNTX_ECEF_BIT) != 0;
+    ind.isRelativeEphemeris = (indicators & VRT_CNTX_RELATIVE_EPHEMERIS_BIT) != 0;
+    ind.isEphemerisRef = (indicators & VRT_CNTX_EPHEMERIS_REF_BIT) != 0;
+    ind.isGPSASCII = (indicators & VRT_CNTX_GPS_ASCII_BIT) != 0;
+    parsed.fieldChanged = ind.isContextFieldChanged;
+
+    // 16-bit fields are in the low half of their word
+    parsed.referencePoint = *field(VRT_CNTX_REFERENCE_POINT_BIT);
+    parsed.bandwidth = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_BANDWIDTH_BIT)));
+    parsed.ifFreq = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_IF_FREQ_BIT)));
+    parsed.rfFreq = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_RF_FREQ_BIT)));
+    parsed.rfFreqOffset = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_FREQ_OFFSET_BIT)));
+    parsed.ifBandOffset = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_IF_BAND_OFFSET_BIT)));
+    parsed.reflevel = vrtConvertRefToFloat((VrtRef)(*field(VRT_CNTX_REFERENCE_LEVEL_BIT) & 0xFFFF));
+    parsed.atten = vrtConvertGainToFloat((VrtGain)(*field(VRT_CNTX_GAIN_BIT) & 0xFFFF));
+    parsed.overRangeCount = *field(VRT_CNTX_OVER_RANGE_BIT);
+    parsed.sampleRate = vrtConvertFreqToFloat((VrtFreq)vrtUnpackInt64(field(VRT_CNTX_SAMPLE_RATE_BIT)));
+    parsed.timestampAdjust = vrtUnpackInt64(field(VRT_CNTX_TIMESTAMP_ADJUST_BIT));
+    parsed.timestampCal = *field(VRT_CNTX_TIMESTAMP_CAL_BIT);
+    parsed.temperature = vrtConvertTempToFloat((VrtTemp)(*field(VRT_CNTX_TEMPERATURE_BIT) & 0xFFFF));
+    const uint32_t *devId = field(VRT_CNTX_DEVICE_ID_BIT);
+    parsed.devUid = devId[0] & 0x00FFFFFF;
+    parsed.devModel = devId[1] & 0x0000FFFF;
+    parsed.stateEvent = *field(VRT_CNTX_STATE_EVENT_BIT);
+    const uint32_t *payloadFormat = field(VRT_CNTX_IF_PAYLOAD_BIT);
+    parsed.payloadFormat[0] = payloadFormat[0];
+    parsed.payloadFormat[1] = payloadFormat[1];
+    parsed.ephemerisRef = *field(VRT_CNTX_EPHEMERIS_REF_BIT);
+
+    // The geolocation fields are rarely present and cost more to convert than to
+    //   clear, these are the only ones skipped when absent
+    if(ind.isGPS) {
+        vrtDecodeFormattedGPS(field(VRT_CNTX_FORMATTED_GPS_BIT), parsed.gps);
+    } else {
+        memset(&parsed.gps, 0, sizeof(parsed.gps));
+    }
+    if(ind.isINS) {
+        vrtDecodeFormattedGPS(field(VRT_CNTX_FORMATTED_INS_BIT), parsed.ins);
+    } else {
+        memset(&parsed.ins, 0, sizeof(parsed.ins));
+    }
+    if(ind.isECEF) {
+        vrtDecodeEphemeris(field(VRT_CNTX_ECEF_BIT), parsed.ecef);
+    } else {
+        memset(&parsed.ecef, 0, sizeof(parsed.ecef));
+    }
+    if(ind.isRelativeEphemeris) {
+        vrtDecodeEphemeris(field(VRT_CNTX_RELATIVE_EPHEMERIS_BIT), parsed.relativeEphemeris);
+    } else {
+        memset(&parsed.relativeEphemeris, 0, sizeof(parsed.relativeEphemeris));
+    }
+
+#undef field
+
+    return (int)packetSize;
+}
+
+static int vrtParseContextPacketGeneric(const uint32_t *words, uint32_t wordCount,
+                                        VRTUserContextPkt &parsed)
+{
+    return vrtParseContextPacketT<false>(words, wordCount, parsed);
+}
+
+#ifdef VRT_X86
+VRT_POPCNT static int vrtParseContextPacketPopcnt(const uint32_t *words, uint32_t wordCount,
+                                                  VRTUserContextPkt &parsed)
+{
+    return vrtParseContextPacketT<true>(words, wordCount, parsed);
+}
+
+static bool vrtCpuSupportsPopcnt()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 23)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt");
+#endif
+}
+#endif
+
+int vrtParseContextPacket(const uint32_t *words, uint32_t wordCount, VRTUserContextPkt &parsed)
+{
+#ifdef VRT_X86
+    static int (*const parse)(const uint32_t*, uint32_t, VRTUserContextPkt&) =
+        vrtCpuSupportsPopcnt() ? vrtParseContextPacketPopcnt : vrtParseContextPacketGeneric;
+    return parse(words, wordCount, parsed);
+#else
+    return vrtParseContextPacketGeneric(words, wordCount, parsed);
+#endif
+}
+
+uint32_t vrtIndexPackets(const uint32_t *words, uint32_t wordCount,
+                         std::vector<VRTPacketIndexEntry> &index)
+{
+    index.clear();
+    if(!words) {
+        return 0;
+    }
+
+    uint32_t offset = 0;
+    while(offset < wordCount) {
+        uint32_t header = swapWord(words[offset]);
+        uint32_t size = vrtGetPacketSize(header);
+        if(size == 0 || size > wordCount - offset) {
+            break;
+        }
+
+        VRTPacketIndexEntry entry;
+        entry.offset = offset;
+        entry.size = size;
+        switch(vrtGetPacketType(header)) {
+        case VRT_DATA_PKT_TYPE:
+            entry.type = smVRTDataPacket;
+            break;
+        case VRT_CNTX_PKT_TYPE:
+            entry.type = smVRTContextPacket;
+            break;
+        default:
+            entry.type = smVRTInvalidPacket;
+            break;
+        }
+        index.push_back(entry);
+
+        offset += size;
+    }
+
+    return offset;
+}
+
+void vrtParseDataTrailer(uint32_t trailerWord, VRTUserDataTrailer &trailer)
+{
+    trailer.isCalibratedTime.enabled = vrtGetBit(trailerWord, VRT_TIME_ENABLE);
+    trailer.isCalibratedTime.indicator = trailer.isCalibratedTime.enabled &&
+        vrtGetBit(trailerWord, VRT_TIME_INDICATOR);
+    trailer.isValidData.enabled = vrtGetBit(trailerWord, VRT_VALID_DATA_ENABLE);
+    trailer.isValidData.indicator = trailer.isValidData.enabled &&
+        vrtGetBit(trailerWord, VRT_VALID_DATA_INDICATOR);
+    trailer.isReferenceLock.enabled = vrtGetBit(trailerWord, VRT_REF_LOCK_ENABLE);
+    trailer.isReferenceLock.indicator = trailer.isReferenceLock.enabled &&
+        vrtGetBit(trailerWord, VRT_REF_LOCK_INDICATOR);
+    trailer.isOverRange.enabled = vrtGetBit(trailerWord, VRT_OVER_RANGE_ENABLE);
+    trailer.isOverRange.indicator = trailer.isOverRange.enabled &&
+        vrtGetBit(trailerWord, VRT_OVER_RANGE_INDICATOR);
+    trailer.isSampleLoss.enabled = vrtGetBit(trailerWord, VRT_SAMPLE_LOSS_ENABLE);
+    trailer.isSampleLoss.indicator = trailer.isSampleLoss.enabled &&
+        vrtGetBit(trailerWord, VRT_SAMPLE_LOSS_INDICATOR);
+    trailer.associatedContextPktCount = vrtGetBit(trailerWord, VRT_DATA_TRAILER_E_BIT) ?
+        vrtGetAssociatedContextPktCount(trailerWord) : 0;
+}
+
+void vrtUnpackDataPayload(const VRTDataPktView &view, float *dst, float scale)
+{
+    vrtUnpack16scBE(view.payload, dst, view.sampleCount, scale);
+}
+
 uint32_t vrtPackDataHeader(uint8_t packetCount, uint16_t packetSize)
 {
     uint32_t hdr = 0;
@@ -193,113 +1034,558 @@ uint32_t vrtPackContextIndicatorWord(bool isChange, bool isGPS)
     return w;
 }
 
-#include <string>
-#include <sstream>
+uint32_t vrtPackContextPacket(uint8_t packetCount, uint32_t streamIdent, uint32_t seconds,
+                              uint64_t picoseconds, bool isChange, bool isGPS,
+                              const VRTContextFields &fields, uint32_t *words)
+{
+    uint32_t *curr = words + sizeof(VRTContextPktMetadata) / sizeof(uint32_t);
+
+    // Fields in the order of their indicator bits, highest first
+    vrtPackInt64(fields.bandwidth, curr);
+    curr += VRT_CNTX_BANDWIDTH_SIZE;
+    vrtPackInt64(fields.frequency, curr);
+    curr += VRT_CNTX_RF_FREQ_SIZE;
+    *curr = fields.reference & 0xFFFF;
+    curr += VRT_CNTX_REFERENCE_LEVEL_SIZE;
+    *curr = fields.gain & 0xFFFF;
+    curr += VRT_CNTX_GAIN_SIZE;
+    vrtPackInt64(fields.sampleRate, curr);
+    curr += VRT_CNTX_SAMPLE_RATE_SIZE;
+    *curr = fields.temperature & 0xFFFF;
+    curr += VRT_CNTX_TEMPERATURE_SIZE;
+    curr[0] = fields.devUid & 0x00FFFFFF;
+    curr[1] = fields.devModel & 0x0000FFFF;
+    curr += VRT_CNTX_DEVICE_ID_SIZE;
+    if(isGPS) {
+        memcpy(curr, &fields.formattedGps, sizeof(VRTFormattedGPS));
+        curr += VRT_CNTX_FORMATTED_GPS_SIZE;
+    }
+
+    uint32_t size = (uint32_t)(curr - words);
+    words[0] = vrtPackContextHeader(packetCount, (uint16_t)size);
+    words[1] = streamIdent;
+    words[2] = seconds;
+    words[3] = (uint32_t)(picoseconds >> 32);
+    words[4] = (uint32_t)(picoseconds & 0xFFFFFFFF);
+    words[5] = vrtPackContextIndicatorWord(isChange, isGPS);
+
+    return size;
+}
+
+//
+// NMEA 0183
+//
+
+// Most fields in a sentence, GGA has 15
+static const int VRT_NMEA_MAX_FIELDS = 24;
+// Fraction digits kept, picosecond resolution for times
+static const int VRT_NMEA_MAX_FRAC_DIGITS = 12;
+// VITA 49 value of a formatted GPS field which is not specified
+static const uint32_t VRT_GPS_UNSPECIFIED = 0x7FFFFFFF;
+static const double VRT_KNOTS_TO_MPS = 1852.0 / 3600.0;
+
+static const uint64_t vrtPow10[VRT_NMEA_MAX_FRAC_DIGITS + 1] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull
+};
+
+// One comma separated field of a sentence, not NUL terminated
+struct VrtNmeaField {
+    const char *begin;
+    const char *end;
+
+    bool empty() const { return begin == end; }
+};
+
+// Unsigned decimal "ddd.ddd", split into the whole part and the fraction digits
+struct VrtNmeaDecimal {
+    uint64_t whole;
+    uint64_t frac;
+    int fracDigits;
+
+    double value() const { return (double)whole + (double)frac / (double)vrtPow10[fracDigits]; }
+};
+
+static bool vrtNmeaParseDecimal(const VrtNmeaField &f, VrtNmeaDecimal &dec)
+{
+    dec.whole = 0;
+    dec.frac = 0;
+    dec.fracDigits = 0;
+
+    const char *p = f.begin;
+    if(p == f.end || *p == '.') {
+        return false;
+    }
+    for(; p < f.end && *p != '.'; p++) {
+        uint32_t digit = (uint32_t)(*p - '0');
+        // At most 18 digits keep the whole part from overflowing
+        if(digit > 9 || p - f.begin >= 18) {
+            return false;
+        }
+        dec.whole = dec.whole * 10 + digit;
+    }
+    if(p < f.end) {
+        for(p++; p < f.end; p++) {
+            uint32_t digit = (uint32_t)(*p - '0');
+            if(digit > 9) {
+                return false;
+            }
+            // Digits past picoseconds are dropped
+            if(dec.fracDigits < VRT_NMEA_MAX_FRAC_DIGITS) {
+                dec.frac = dec.frac * 10 + digit;
+                dec.fracDigits++;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool vrtNmeaParseDouble(VrtNmeaField f, double &value)
+{
+    bool negative = !f.empty() && *f.begin == '-';
+    if(negative || (!f.empty() && *f.begin == '+')) {
+        f.begin++;
+    }
+
+    VrtNmeaDecimal dec;
+    if(!vrtNmeaParseDecimal(f, dec)) {
+        return false;
+    }
+    value = negative ? -dec.value() : dec.value();
+
+    return true;
+}
+
+static bool vrtNmeaParseInt(const VrtNmeaField &f, int32_t &value)
+{
+    VrtNmeaDecimal dec;
+    if(!vrtNmeaParseDecimal(f, dec) || dec.fracDigits > 0 || dec.whole > 0x7FFFFFFF) {
+        return false;
+    }
+    value = (int32_t)dec.whole;
+
+    return true;
+}
+
+// Latitude "ddmm.mmmm" or longitude "dddmm.mmmm" with its hemisphere field
+// positive = 'N' or 'E', negative = 'S' or 'W'
+static bool vrtNmeaParseAngle(const VrtNmeaField &f, const VrtNmeaField &hemisphere,
+                              char positive, char negative, double maxDegrees, double &value)
+{
+    VrtNmeaDecimal dec;
+    if(!vrtNmeaParseDecimal(f, dec) || hemisphere.end - hemisphere.begin != 1) {
+        return false;
+    }
+
+    uint64_t minutes = dec.whole % 100;
+    double degrees = (double)(dec.whole / 100) +
+        ((double)minutes + (double)dec.frac / (double)vrtPow10[dec.fracDigits]) / 60.0;
+    if(minutes >= 60 || degrees > maxDegrees) {
+        return false;
+    }
+
+    if(*hemisphere.begin == negative) {
+        degrees = -degrees;
+    } else if(*hemisphere.begin != positive) {
+        return false;
+    }
+    value = degrees;
+
+    return true;
+}
+
+// UTC time of day "hhmmss.sss"
+static bool vrtNmeaParseTime(const VrtNmeaField &f, VRTNmeaFix &fix)
+{
+    VrtNmeaDecimal dec;
+    if(!vrtNmeaParseDecimal(f, dec)) {
+        return false;
+    }
+
+    uint32_t hours = (uint32_t)(dec.whole / 10000);
+    uint32_t minutes = (uint32_t)(dec.whole / 100 % 100);
+    uint32_t seconds = (uint32_t)(dec.whole % 100);
+    // 60 seconds for a leap second
+    if(hours > 23 || minutes > 59 || seconds > 60) {
+        return false;
+    }
+
+    fix.secondsOfDay = hours * 3600 + minutes * 60 + seconds;
+    fix.picoseconds = dec.frac * vrtPow10[VRT_NMEA_MAX_FRAC_DIGITS - dec.fracDigits];
+    fix.hasTime = true;
 
-typedef std::vector<std::string> string_list;
+    return true;
+}
+
+static bool vrtNmeaSetDate(int32_t year, int32_t month, int32_t day, VRTNmeaFix &fix)
+{
+    if(year < 1970 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+
+    fix.year = year;
+    fix.month = month;
+    fix.day = day;
+    fix.hasDate = true;
+
+    return true;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t vrtDaysFromCivil(int32_t year, int32_t month, int32_t day)
+{
+    year -= (month <= 2) ? 1 : 0;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yearOfEra = (uint32_t)(year - era * 400);
+    uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + (int64_t)dayOfEra - 719468;
+}
+
+static inline int vrtHexDigit(char c)
+{
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
 
-void commaSeparate(char *text, string_list &stringList)
+// Fields 1 to 12 of $--RMC
+//   time, status, lat, N/S, lon, E/W, speed (knots), track, date, mag var, E/W, mode
+static bool vrtNmeaParseRMC(const VrtNmeaField *fields, int fieldCount, VRTNmeaFix &fix)
 {
-    stringList.clear();
+    if(fieldCount < 12) {
+        return false;
+    }
+
+    if(!fields[1].empty() && !vrtNmeaParseTime(fields[1], fix)) {
+        return false;
+    }
 
-    std::stringstream ss(text);
-    std::string str;
+    if(fields[2].end - fields[2].begin != 1) {
+        return false;
+    }
+    fix.isValid = (*fields[2].begin == 'A');
+
+    if(!fields[3].empty()) {
+        if(!vrtNmeaParseAngle(fields[3], fields[4], 'N', 'S', 90.0, fix.latitude) ||
+           !vrtNmeaParseAngle(fields[5], fields[6], 'E', 'W', 180.0, fix.longitude)) {
+            return false;
+        }
+        fix.hasPosition = true;
+    }
 
-    while(ss >> str) {
-        stringList.push_back(str);
-        if(ss.peek() == ',') {
-            ss.ignore();
+    if(!fields[7].empty()) {
+        double knots = 0.0, track = 0.0;
+        if(!vrtNmeaParseDouble(fields[7], knots) ||
+           (!fields[8].empty() && !vrtNmeaParseDouble(fields[8], track))) {
+            return false;
         }
+        fix.speedOverGround = knots * VRT_KNOTS_TO_MPS;
+        fix.trackAngle = track;
+        fix.hasVelocity = true;
     }
+
+    // ddmmyy, GPS dates start in 1980
+    if(!fields[9].empty()) {
+        int32_t date;
+        if(fields[9].end - fields[9].begin != 6 || !vrtNmeaParseInt(fields[9], date)) {
+            return false;
+        }
+        int32_t year = date % 100;
+        year += (year >= 80) ? 1900 : 2000;
+        if(!vrtNmeaSetDate(year, date / 100 % 100, date / 10000, fix)) {
+            return false;
+        }
+    }
+
+    if(!fields[10].empty()) {
+        double variation;
+        if(!vrtNmeaParseDouble(fields[10], variation) || fields[11].end - fields[11].begin != 1) {
+            return false;
+        }
+        fix.magneticVariation = (*fields[11].begin == 'W') ? -variation : variation;
+        fix.hasMagneticVariation = true;
+    }
+
+    return true;
 }
 
-double latitudeStringToDecimal(std::string &pos, std::string &dir)
+// Fields 1 to 14 of $--GGA
+//   time, lat, N/S, lon, E/W, quality, satellites, hdop, altitude, M,
+//   geoid separation, M, age, station
+static bool vrtNmeaParseGGA(const VrtNmeaField *fields, int fieldCount, VRTNmeaFix &fix)
 {
-    char deg[2] = { pos[0], pos[1] };
+    if(fieldCount < 15) {
+        return false;
+    }
+
+    if(!fields[1].empty() && !vrtNmeaParseTime(fields[1], fix)) {
+        return false;
+    }
 
-    double decimal = atof(deg) + (atof(pos.c_str() + 2) / 60.0);
+    if(!fields[2].empty()) {
+        if(!vrtNmeaParseAngle(fields[2], fields[3], 'N', 'S', 90.0, fix.latitude) ||
+           !vrtNmeaParseAngle(fields[4], fields[5], 'E', 'W', 180.0, fix.longitude)) {
+            return false;
+        }
+        fix.hasPosition = true;
+    }
 
-    if(dir == "S") {
-        decimal *= -1.0;
+    fix.quality = 0;
+    if(!fields[6].empty() && !vrtNmeaParseInt(fields[6], fix.quality)) {
+        return false;
     }
+    fix.isValid = fix.quality > 0;
 
-    return decimal;
+    if(!fields[7].empty() && !vrtNmeaParseInt(fields[7], fix.satellites)) {
+        return false;
+    }
+    if(!fields[8].empty() && !vrtNmeaParseDouble(fields[8], fix.hdop)) {
+        return false;
+    }
+
+    if(!fields[9].empty()) {
+        double altitude, separation = 0.0;
+        if(!vrtNmeaParseDouble(fields[9], altitude) ||
+           (!fields[11].empty() && !vrtNmeaParseDouble(fields[11], separation))) {
+            return false;
+        }
+        fix.altitude = altitude + separation;
+        fix.hasAltitude = true;
+    }
+
+    return true;
 }
 
-double longitudeStringToDecimal(std::string &pos, std::string &dir)
+// Fields 1 to 6 of $--ZDA
+//   time, day, month, year, local zone hours, local zone minutes
+static bool vrtNmeaParseZDA(const VrtNmeaField *fields, int fieldCount, VRTNmeaFix &fix)
 {
-    char deg[3] = { pos[0], pos[1], pos[2] };
+    if(fieldCount < 5) {
+        return false;
+    }
 
-    double decimal = atof(deg) + (atof(pos.c_str() + 3) / 60.0);
+    if(!fields[1].empty() && !vrtNmeaParseTime(fields[1], fix)) {
+        return false;
+    }
 
-    if(dir == "W") {
-        decimal *= -1.0;
+    if(!fields[2].empty()) {
+        int32_t day, month, year;
+        if(!vrtNmeaParseInt(fields[2], day) || !vrtNmeaParseInt(fields[3], month) ||
+           !vrtNmeaParseInt(fields[4], year) || !vrtNmeaSetDate(year, month, day, fix)) {
+            return false;
+        }
     }
 
-    return decimal;
+    return true;
 }
 
-int32_t dateTimeToEpochSeconds(std::string &dateStr, std::string &timeStr)
+enum VrtNmeaCharClass {
+    vrtNmeaCharText = 0,
+    vrtNmeaCharComma = 1,
+    vrtNmeaCharStar = 2,
+    // Line end or the start of the next sentence
+    vrtNmeaCharEnd = 3
+};
+
+// One lookup per character instead of a compare for each delimiter
+static const struct VrtNmeaCharTable {
+    VrtNmeaCharTable()
+    {
+        memset(cls, vrtNmeaCharText, sizeof(cls));
+        cls[(uint8_t)','] = vrtNmeaCharComma;
+        cls[(uint8_t)'*'] = vrtNmeaCharStar;
+        cls[(uint8_t)'\r'] = vrtNmeaCharEnd;
+        cls[(uint8_t)'\n'] = vrtNmeaCharEnd;
+        cls[(uint8_t)'\0'] = vrtNmeaCharEnd;
+        cls[(uint8_t)'$'] = vrtNmeaCharEnd;
+    }
+    uint8_t operator[](uint8_t c) const { return cls[c]; }
+
+    uint8_t cls[256];
+} vrtNmeaCharClass;
+
+// Parses the sentence starting at the '$' in text, up to end.
+// next = set to where scanning stopped, after the checksum or at the character
+//   which made the sentence invalid
+static VrtNmeaSentence vrtNmeaParseNext(const char *text, const char *end, VRTNmeaFix &fix,
+                                        const char *&next)
 {
-    tm ti;
+    // Split the fields and compute the checksum in one pass
+    VrtNmeaField fields[VRT_NMEA_MAX_FIELDS];
+    int fieldCount = 0;
+    uint8_t checksum = 0;
+    const char *p = text + 1;
+    const char *fieldBegin = p;
+    for(; p < end; p++) {
+        uint8_t c = (uint8_t)*p;
+        uint8_t cls = vrtNmeaCharClass[c];
+        if(cls == vrtNmeaCharText) {
+            checksum ^= c;
+            continue;
+        }
+        if(cls == vrtNmeaCharStar) {
+            break;
+        }
+        if(cls == vrtNmeaCharEnd || fieldCount == VRT_NMEA_MAX_FIELDS - 1) {
+            next = p;
+            return vrtNmeaInvalid;
+        }
+        // Comma
+        checksum ^= c;
+        fields[fieldCount].begin = fieldBegin;
+        fields[fieldCount].end = p;
+        fieldCount++;
+        fieldBegin = p + 1;
+    }
+    fields[fieldCount].begin = fieldBegin;
+    fields[fieldCount].end = p;
+    fieldCount++;
 
-    char day[2] = { dateStr[0], dateStr[1] };
-    char month[2] = { dateStr[2], dateStr[3] };
-    char year[2] = { dateStr[4], dateStr[5] };
-    char hour[2] = { timeStr[0], timeStr[1] };
-    char min[2] = { timeStr[2], timeStr[3] };
-    char sec[2] = { timeStr[4], timeStr[5] };
+    if(end - p < 3) {
+        next = end;
+        return vrtNmeaInvalid;
+    }
+    next = p + 3;
+    int hi = vrtHexDigit(p[1]);
+    int lo = vrtHexDigit(p[2]);
+    if(hi < 0 || lo < 0 || ((hi << 4) | lo) != checksum) {
+        return vrtNmeaInvalid;
+    }
 
-    ti.tm_year = atoi(year) + 100;
-    ti.tm_mon = atoi(month);
-    ti.tm_mday = atoi(day);
-    ti.tm_hour = atoi(hour);
-    ti.tm_min = atoi(min);
-    ti.tm_sec = atoi(sec);
+    // Address, two character talker followed by the sentence type
+    const VrtNmeaField &address = fields[0];
+    if(address.end - address.begin != 5) {
+        return vrtNmeaOther;
+    }
+    const char *type = address.begin + 2;
+
+    // Parsed into a copy, fix is only updated by a valid sentence
+    VRTNmeaFix updated = fix;
+    VrtNmeaSentence sentence;
+    bool ok;
+    if(type[0] == 'R' && type[1] == 'M' && type[2] == 'C') {
+        sentence = vrtNmeaRMC;
+        ok = vrtNmeaParseRMC(fields, fieldCount, updated);
+    } else if(type[0] == 'G' && type[1] == 'G' && type[2] == 'A') {
+        sentence = vrtNmeaGGA;
+        ok = vrtNmeaParseGGA(fields, fieldCount, updated);
+    } else if(type[0] == 'Z' && type[1] == 'D' && type[2] == 'A') {
+        sentence = vrtNmeaZDA;
+        ok = vrtNmeaParseZDA(fields, fieldCount, updated);
+    } else {
+        return vrtNmeaOther;
+    }
 
-    return (int32_t)mktime(&ti);
+    if(!ok) {
+        return vrtNmeaInvalid;
+    }
+    fix = updated;
+
+    return sentence;
 }
 
-// String into this function is the full RMC string
-//   starting at the $GPRMC text (including it)
-void vrtRmcStringToStruct(char *text, VRTFormattedGPS *cntx)
+VrtNmeaSentence vrtParseNmeaSentence(const char *text, uint32_t len, VRTNmeaFix &fix)
 {
-    int fix = atoi(text + 7);
+    if(!text || len < 1 || text[0] != '$') {
+        return vrtNmeaInvalid;
+    }
 
-    string_list sl;
-    commaSeparate(text, sl);
+    const char *next;
+    return vrtNmeaParseNext(text, text + len, fix, next);
+}
+
+int vrtParseNmea(const char *text, uint32_t len, VRTNmeaFix &fix)
+{
+    if(!text) {
+        return 0;
+    }
+
+    // Each sentence is scanned once, the line ends between them are skipped
+    int count = 0;
+    const char *end = text + len;
+    const char *p = text;
+    while(p < end && *p != '\0') {
+        if(*p != '$') {
+            p++;
+            continue;
+        }
+        if(vrtNmeaParseNext(p, end, fix, p) > vrtNmeaOther) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+uint32_t vrtNmeaFixSeconds(const VRTNmeaFix &fix)
+{
+    if(!fix.hasTime || !fix.hasDate) {
+        return 0;
+    }
 
-    // Index 0: $GPRMC
+    return (uint32_t)(vrtDaysFromCivil(fix.year, fix.month, fix.day) * 86400 + fix.secondsOfDay);
+}
 
-    // 1: Time
-    // 9: Date
-    cntx->timestampInt = dateTimeToEpochSeconds(sl[9], sl[1]);
-    cntx->timestampFracUpper = 0;
-    cntx->timestampFracLower = 0;
+void vrtNmeaFixToFormattedGPS(const VRTNmeaFix &fix, VRTFormattedGPS &gps)
+{
+    // TSI UTC and TSF real time picoseconds, no manufacturer OUI
+    if(fix.hasTime && fix.hasDate) {
+        gps.header = (0x1 << 26) | (0x2 << 24);
+        gps.timestampInt = vrtNmeaFixSeconds(fix);
+        gps.timestampFracUpper = (uint32_t)(fix.picoseconds >> 32);
+        gps.timestampFracLower = (uint32_t)(fix.picoseconds & 0xFFFFFFFF);
+    } else {
+        gps.header = 0;
+        gps.timestampInt = 0xFFFFFFFF;
+        gps.timestampFracUpper = 0xFFFFFFFF;
+        gps.timestampFracLower = 0xFFFFFFFF;
+    }
 
-    // 2: Status
+    if(fix.hasPosition) {
+        gps.latitude = vrtConvertFloatToFixed(fix.latitude, 22);
+        gps.longitude = vrtConvertFloatToFixed(fix.longitude, 22);
+    } else {
+        gps.latitude = VRT_GPS_UNSPECIFIED;
+        gps.longitude = VRT_GPS_UNSPECIFIED;
+    }
 
-    // 3: Lat
-    // 4: Lat dir 'N'
-    cntx->latitude = vrtConvertFloatToFixed(
-        latitudeStringToDecimal(sl[3], sl[4]), 22);
+    gps.altitude = fix.hasAltitude ? (uint32_t)vrtConvertFloatToFixed(fix.altitude, 5) :
+        VRT_GPS_UNSPECIFIED;
 
-    // 5: Long
-    // 6: Long dir 'E'
-    cntx->longitude = vrtConvertFloatToFixed(
-        longitudeStringToDecimal(sl[5], sl[6]), 22);
+    if(fix.hasVelocity) {
+        gps.speedOverGround = vrtConvertFloatToFixed(fix.speedOverGround, 16);
+        gps.trackAngle = vrtConvertFloatToFixed(fix.trackAngle, 22);
+    } else {
+        gps.speedOverGround = VRT_GPS_UNSPECIFIED;
+        gps.trackAngle = VRT_GPS_UNSPECIFIED;
+    }
+
+    // Not in NMEA position sentences
+    gps.headingAngle = VRT_GPS_UNSPECIFIED;
 
-    // 7: Speed over ground
-    cntx->speedOverGround = vrtConvertFloatToFixed(atof(sl[7].c_str()), 16);
+    gps.magneticVariation = fix.hasMagneticVariation ?
+        (uint32_t)vrtConvertFloatToFixed(fix.magneticVariation, 22) : VRT_GPS_UNSPECIFIED;
+}
 
-    // 8: Track angle
-    cntx->trackAngle = vrtConvertFloatToFixed(atof(sl[8].c_str()), 22);
+void vrtRmcStringToStruct(const char *text, VRTFormattedGPS *cntx)
+{
+    if(!text || !cntx) {
+        return;
+    }
 
-    // 10: Magnetic variation
-    // 11: Magnetic variation, direction 'W'
-    double magVar = atof(sl[10].c_str());
-    if(sl[11] == "W") {
-        magVar *= -1.0;
+    VRTNmeaFix fix;
+    memset(&fix, 0, sizeof(fix));
+    if(vrtParseNmeaSentence(text, (uint32_t)strcspn(text, "\r\n"), fix) == vrtNmeaRMC) {
+        vrtNmeaFixToFormattedGPS(fix, *cntx);
     }
-    cntx->magneticVariation = vrtConvertFloatToFixed(magVar, 22);
 }
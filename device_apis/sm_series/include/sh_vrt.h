@@ -135,6 +135,23 @@ typedef struct VRTFormattedGPS {
     uint32_t magneticVariation;
 } VRTFormattedGPS;
 
+// VITA 49 ECEF and relative ephemeris subfield format
+typedef struct VRTFormattedEphemeris {
+    uint32_t header;
+    uint32_t timestampInt;
+    uint32_t timestampFracUpper;
+    uint32_t timestampFracLower;
+    int32_t positionX;
+    int32_t positionY;
+    int32_t positionZ;
+    int32_t attitudeAlpha;
+    int32_t attitudeBeta;
+    int32_t attitudePhi;
+    int32_t velocityX;
+    int32_t velocityY;
+    int32_t velocityZ;
+} VRTFormattedEphemeris;
+
 // Context Packet payload fields
 typedef struct VRTContextFields {
     int64_t bandwidth;
@@ -197,41 +214,103 @@ typedef struct VRTUserDataPkt {
     VRTUserDataTrailer trailer;
 } VRTUserDataPkt;
 
+// Data packet parsed in place, see vrtParseDataPacketView.
+// Nothing is copied, payload points into the caller's big endian packet buffer and
+//   is only valid while that buffer is.
+typedef struct VRTDataPktView {
+    VRTUserPktPrologue prologue;
+    // Big endian payload, one 32-bit word per IQ sample
+    const uint32_t *payload;
+    uint32_t sampleCount;
+    // Trailer word in host byte order
+    uint32_t trailerWord;
+    VRTUserDataTrailer trailer;
+} VRTDataPktView;
+
 typedef struct VRTUserContextIndicators {
+
     bool isContextFieldChanged;
+    bool isReferencePoint;
     bool isBandwidth;
+    bool isIfFreq;
     bool isRfFreq;
+    bool isRfFreqOffset;
+    bool isIfBandOffset;
     bool isReflevel;
     bool isaAtten;
+    bool isOverRange;
     bool isSampleRate;
+    bool isTimestampAdjust;
+    bool isTimestampCal;
     bool isTemperature;
     bool isDevUid;
     bool isDevModel;
+    bool isStateEvent;
+    bool isPayloadFormat;
     bool isGPS;
+    bool isINS;
+    bool isECEF;
+    bool isRelativeEphemeris;
+    bool isEphemerisRef;
+    bool isGPSASCII; // Present but not decoded
 } VRTUserContextIndicators;
 
+// Formatted GPS and INS geolocation
 typedef struct VRTUserGPS {
-    double latitude;
-    double longitude;
-    double altitude;
+    double latitude; // Degrees
+    double longitude; // Degrees
+    double altitude; // Meters
+    double speedOverGround; // m/s
+    double headingAngle; // Degrees
+    double trackAngle; // Degrees
+    double magneticVariation; // Degrees
     uint32_t seconds;
     uint32_t picoUpper;
     uint32_t picoLower;
 } VRTUserGPS;
 
+// ECEF or relative ephemeris
+typedef struct VRTUserEphemeris {
+    double positionX; // Meters
+    double positionY;
+    double positionZ;
+    double attitudeAlpha; // Degrees
+    double attitudeBeta;
+    double attitudePhi;
+    double velocityX; // m/s
+    double velocityY;
+    double velocityZ;
+    uint32_t seconds;
+    uint32_t picoUpper;
+    uint32_t picoLower;
+} VRTUserEphemeris;
+
 typedef struct VRTUserContextPkt {
     VRTUserPktPrologue prologue;
     VRTUserContextIndicators indicators;
     bool fieldChanged;
+    uint32_t referencePoint;
     double bandwidth;
+    double ifFreq;
     double rfFreq;
+    double rfFreqOffset;
+    double ifBandOffset;
     double reflevel;
     double atten;
+    uint32_t overRangeCount;
     double sampleRate;
+    int64_t timestampAdjust; // Picoseconds
+    uint32_t timestampCal; // Seconds
     double temperature;
     int devUid;
     double devModel;
+    uint32_t stateEvent; // State and event indicator bits
+    uint32_t payloadFormat[2]; // Data packet payload format words, in packet order
     VRTUserGPS gps;
+    VRTUserGPS ins;
+    VRTUserEphemeris ecef;
+    VRTUserEphemeris relativeEphemeris;
+    uint32_t ephemerisRef;
 } VRTUserContextPkt;
 
 inline void vrtSetBit(uint32_t &input, uint32_t bit)
@@ -253,10 +332,72 @@ inline uint32_t swapWord(uint32_t input)
         ((input << 24) & 0xFF000000);
 }
 
+// 64-bit fixed point fields (frequencies, sample rate) span two words, the low
+//   word first, which is the order VRTParser reads them in.
+inline void vrtPackInt64(int64_t value, uint32_t *words)
+{
+    words[0] = (uint32_t)((uint64_t)value & 0xFFFFFFFF);
+    words[1] = (uint32_t)((uint64_t)value >> 32);
+}
+
+inline int64_t vrtUnpackInt64(const uint32_t *words)
+{
+    return (int64_t)(((uint64_t)words[1] << 32) | words[0]);
+}
+
 // Swap between big-little endian
+// The fastest implementation supported by the CPU (AVX-512, AVX2, SSSE3 or scalar)
+//   is selected the first time either function is called.
 int vrtSwapBytes(uint32_t *srcDst, uint32_t wordCount);
+// Swaps while copying, src and dst may be the same buffer but must not otherwise overlap.
+// Cheaper than a memcpy followed by an in-place swap, each word is only touched once.
 int vrtSwapBytes(const uint32_t *src, uint32_t *dst, uint32_t wordCount);
 
+// Conversion of 16-bit complex samples to floats, dst[i] = src[i] / 32768 * scale
+// scale = full scale amplitude, e.g. the IQ correction of smGetIQCorrection/
+//   bbGetIQCorrection or sqrt(mW) of the VRT reference level
+// Little endian samples, e.g. smDataType16sc/bbDataType16sc
+//   count = number of int16 values, 2 per complex sample
+void vrtUnpack16sc(const int16_t *src, float *dst, uint32_t count, float scale);
+// Big endian VRT payload words, byte swapped, widened and scaled in one pass.
+//   Each swapped word is split into two int16 values, low half first.
+//   dst = 2 * wordCount floats
+void vrtUnpack16scBE(const uint32_t *src, float *dst, uint32_t wordCount, float scale);
+
+// Instruction set used by vrtSwapBytes and the vrtUnpack16sc functions
+typedef enum VrtSwapIsa {
+    vrtSwapIsaScalar = 0,
+    vrtSwapIsaSSSE3 = 1,
+    vrtSwapIsaAVX2 = 2,
+    vrtSwapIsaAVX512 = 3
+} VrtSwapIsa;
+
+// Returns the instruction set vrtSwapBytes is currently using.
+VrtSwapIsa vrtGetSwapIsa();
+// Force vrtSwapBytes and the unpack functions to use a specific instruction set. If the CPU does not support
+//   it, the best supported instruction set below it is used.
+// Returns the instruction set actually selected.
+// Not thread safe, do not call while vrtSwapBytes is in use on other threads.
+VrtSwapIsa vrtSetSwapIsa(VrtSwapIsa isa);
+
+// Throughput of vrtSwapBytes for one instruction set, in GB/s of packet data
+typedef struct VrtSwapBenchmarkResult {
+    VrtSwapIsa isa;
+    const char *name;
+    double inPlaceGBps;
+    double copyGBps;
+    double unpackGBps; // vrtUnpack16scBE
+} VrtSwapBenchmarkResult;
+
+// Times vrtSwapBytes, in place and while copying, and vrtUnpack16scBE for the
+//   scalar loop and each instruction set the CPU supports. The selected
+//   instruction set is restored.
+// wordCount = packet size in words, e.g. 32768 for the largest data packets
+// seconds = approximate duration of each test
+// results = at least 4 entries
+// Returns the number of results written.
+int vrtBenchmarkSwapBytes(uint32_t wordCount, double seconds, VrtSwapBenchmarkResult *results);
+
 // Fixed-float conversions for VRT fixed point types
 VrtTemp vrtConvertFloatToTemp(float temp);
 float vrtConvertTempToFloat(VrtTemp temp);
@@ -277,12 +418,129 @@ uint32_t vrtGetPacketCount(uint32_t pktHdr);
 uint32_t vrtGetPacketSize(uint32_t pktHdr);
 uint32_t vrtGetAssociatedContextPktCount(uint32_t pktTrlr);
 
+// Parses the header and trailer of a big endian data packet without modifying or
+//   copying it. Samples are converted from the view with vrtUnpackDataPayload.
+// Returns the packet size in words, or -1 if words does not start with a complete
+//   data packet.
+int vrtParseDataPacketView(const uint32_t *words, uint32_t wordCount, VRTDataPktView &view);
+// Location of one packet in a blob of packets, see vrtIndexPackets
+typedef struct VRTPacketIndexEntry {
+    uint32_t offset; // Words from the start of the blob
+    uint32_t size; // Words
+    SmVRTPacketType type;
+} VRTPacketIndexEntry;
+
+// Word offset of the field of an indicator bit from the first field after the
+//   indicator word, given the fields present in indicators.
+// Computed with a popcount per field size, fields are in descending bit order.
+uint32_t vrtGetContextFieldOffset(uint32_t indicators, uint32_t bit);
+// Words of all fields present in indicators. GPS ASCII counts as its first word,
+//   the variable length fields below it are not included.
+uint32_t vrtGetContextFieldsSize(uint32_t indicators);
+// Decodes every field of a big endian context packet, words is not modified.
+// Fields that are not present are set to zero with their indicator false.
+// Returns the packet size in words, or -1 if words does not start with a complete
+//   context packet.
+int vrtParseContextPacket(const uint32_t *words, uint32_t wordCount, VRTUserContextPkt &parsed);
+
+// Builds the packet table of a blob of big endian packets, e.g. the output of
+//   smGetVrtPackets, by reading only the header word of each packet.
+// index = cleared, then one entry per packet. Packets of a type other than data
+//   or context are included as smVRTInvalidPacket.
+// Returns the number of words covered by the index. This is less than wordCount
+//   if the blob ends in a truncated packet or a header with a zero size.
+uint32_t vrtIndexPackets(const uint32_t *words, uint32_t wordCount,
+                         std::vector<VRTPacketIndexEntry> &index);
+
+// Decodes the enable and indicator bits of a host order data packet trailer word
+void vrtParseDataTrailer(uint32_t trailerWord, VRTUserDataTrailer &trailer);
+// Converts the payload of a data packet view to interleaved float IQ in dst,
+//   2 * view.sampleCount floats, in the same order ParseDataPacket produces.
+// scale = full scale amplitude, sqrt(mW) of the reference level
+void vrtUnpackDataPayload(const VRTDataPktView &view, float *dst, float scale);
+
 uint32_t vrtPackDataHeader(uint8_t packetCount, uint16_t packetSize);
 uint32_t vrtPackContextHeader(uint8_t packetCount, uint16_t packetSize);
 uint32_t vrtPackDataTrailer(bool isTimeCalibrated, bool isDataValid, bool isExtRefLocked,
                             bool isOverrange, bool isSampleLoss, uint8_t associatedContextPktCount);
 uint32_t vrtPackContextIndicatorWord(bool isChange, bool isGPS);
 
-void vrtRmcStringToStruct(char *text, VRTFormattedGPS *cntx);
+// Largest context packet built by vrtPackContextPacket, in words
+#define VRT_MAX_CNTX_PKT_WORDS (28)
+
+// Builds a complete context packet with the fields of
+//   vrtPackContextIndicatorWord(isChange, isGPS), in host byte order.
+// words = at least VRT_MAX_CNTX_PKT_WORDS
+// Returns the packet size in words.
+uint32_t vrtPackContextPacket(uint8_t packetCount, uint32_t streamIdent, uint32_t seconds,
+                              uint64_t picoseconds, bool isChange, bool isGPS,
+                              const VRTContextFields &fields, uint32_t *words);
+
+//
+// NMEA 0183
+//
+
+typedef enum VrtNmeaSentence {
+    // Malformed, or the checksum does not match
+    vrtNmeaInvalid = -1,
+    // Well formed sentence of a type not used for the fix
+    vrtNmeaOther = 0,
+    vrtNmeaRMC = 1,
+    vrtNmeaGGA = 2,
+    vrtNmeaZDA = 3
+} VrtNmeaSentence;
+
+// Position, velocity and time gathered from NMEA sentences.
+// Each sentence only updates the fields it carries, so one fix combines the RMC,
+//   GGA and ZDA sentences of a GPS update. Zero initialize before the first use.
+typedef struct VRTNmeaFix {
+    // RMC status A, or GGA fix quality above 0, in the last sentence with either
+    bool isValid;
+    bool hasTime;
+    bool hasDate;
+    bool hasPosition;
+    bool hasAltitude;
+    bool hasVelocity;
+    bool hasMagneticVariation;
+
+    // UTC
+    uint32_t secondsOfDay;
+    uint64_t picoseconds;
+    int32_t year;
+    int32_t month;
+    int32_t day;
+
+    double latitude; // Degrees, north positive
+    double longitude; // Degrees, east positive
+    double altitude; // Meters above the WGS-84 ellipsoid, GGA altitude plus geoid separation
+    double speedOverGround; // m/s
+    double trackAngle; // Degrees from true north
+    double magneticVariation; // Degrees, east positive
+
+    // GGA
+    int32_t quality;
+    int32_t satellites;
+    double hdop;
+} VRTNmeaFix;
+
+// Parses one NMEA sentence, "$GPRMC,...*hh" with or without the line end, and
+//   updates fix with its fields. The checksum is required. Any talker is accepted.
+// text does not need to be NUL terminated, nothing is allocated.
+// fix is not modified if the sentence is invalid.
+VrtNmeaSentence vrtParseNmeaSentence(const char *text, uint32_t len, VRTNmeaFix &fix);
+// Parses every sentence in a block of NMEA text, e.g. the nmea output of
+//   smGetGPSInfo, up to len characters or a NUL.
+// Returns the number of RMC, GGA and ZDA sentences parsed.
+int vrtParseNmea(const char *text, uint32_t len, VRTNmeaFix &fix);
+// UTC seconds since 1970 of the fix date and time, 0 if either is missing
+uint32_t vrtNmeaFixSeconds(const VRTNmeaFix &fix);
+// Converts a fix to the VITA 49 formatted GPS field in host byte order.
+// Fields the fix does not have are set to the VITA 49 unspecified value 0x7FFFFFFF,
+//   a fix without date and time has no timestamp.
+void vrtNmeaFixToFormattedGPS(const VRTNmeaFix &fix, VRTFormattedGPS &gps);
+
+// String into this function is the RMC sentence starting at the $GPRMC text,
+//   NUL terminated. cntx is not modified if the sentence is invalid.
+void vrtRmcStringToStruct(const char *text, VRTFormattedGPS *cntx);
 
 #endif // SH_VRT_H
@@ -1,12 +1,17 @@
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "shr_parse.h"
+#include "shr_analysis.h"
+#include "trace_benchmark.h"
 
 int main(int argc, char **argv)
 {
     std::string fileName = "example.shr";
+    // Pass --benchmark to also time the trace kernels at the sweep length of the file
+    bool benchmark = (argc > 1 && strcmp(argv[1], "--benchmark") == 0);
 
     SHRParseState state;
     if(!SHROpenFile(fileName, state)) {
@@ -44,33 +49,36 @@ int main(int argc, char **argv)
     }
     printf("%s\n", state.header.channelizeEnabled ? "Was channelized" : "Was not channelized");
 
-    // Get sweeps
-    // Setup up sweep buffer
-    std::vector<float> sweep(state.header.sweepLength);
+    SHRCloseFile(state);
 
-    // Loop through all sweeps
-    for(int i = 0; i < state.header.sweepCount; i++) {
-        SHRSweepHeader sweepInfo;
-        SHRGetSweep(state, i, &sweep[0], sweepInfo);
+    // Get the peak, mean power and occupancy of every sweep
+    // Sweeps are processed in parallel on all available cores, the results are
+    //   returned in sweep order
+    const float occupancyThresholdDBm = -80.0f;
+    std::vector<SHRSweepStats> stats;
+    bool analyzed = SHRAnalyzeFile<SHRSweepStats>(fileName,
+        [&](const SHRFileHeader &header, int, const SHRSweepHeader &, const float *sweep) {
+            return SHRComputeSweepStats(header, sweep, occupancyThresholdDBm);
+        }, stats);
 
-        // Get peak for each sweep, both the frequency and amplitude
-        double peakIndex = 0;
-        for(int j = 1; j < sweep.size(); j++) {
-            if(sweep[j] > sweep[peakIndex]) {
-                peakIndex = j;
-            }
-        }
+    if(!analyzed) {
+        printf("Unable to read sweeps\n");
+        return -1;
+    }
 
-        double peakFreq = state.header.firstBinFreqHz + peakIndex * state.header.binSizeHz;
-        peakFreq /= 1.0e6;
-        printf("Sweep %d: Peak Freq %.6f MHz, Peak Ampl %.2f %s\n",
+    for(size_t i = 0; i < stats.size(); i++) {
+        printf("Sweep %zu: Peak Freq %.6f MHz, Peak Ampl %.2f %s, Mean Power %.2f dBm, Occupancy %.1f%%\n",
             i, 
-            peakFreq, 
-            sweep[peakIndex],
-            (state.header.refScale == SHRScaleDBM) ? "dBm" : "mV");
+            stats[i].peakFreqHz / 1.0e6, 
+            stats[i].peakAmpl,
+            (state.header.refScale == SHRScaleDBM) ? "dBm" : "mV",
+            stats[i].meanPowerDBm,
+            stats[i].occupancy * 100.0);
     }
 
-    SHRCloseFile(state);
+    if(benchmark && state.header.sweepLength > 0) {
+        traceBenchmarkPrint(state.header.sweepLength, 0.25);
+    }
 
     return 0;
 }
\ No newline at end of file
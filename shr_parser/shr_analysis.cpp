@@ -0,0 +1,152 @@
+#include "shr_analysis.h"
+#include "trace_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+// Number of sweeps handed to a worker at a time. Large enough to amortize the
+//   cost of grabbing a block, small enough to balance the load across workers.
+static const int SHR_SWEEPS_PER_BLOCK = 256;
+// Target size of each read when the file is not mapped
+static const uint64_t SHR_READ_BYTES = 1 << 20;
+
+bool SHRForEachSweep(const std::string &fileName, const SHRSweepCallback &callback,
+                     int threadCount,
+                     const std::function<void(const SHRFileHeader &header)> &onOpen)
+{
+    // Read the header, with the sweep count clamped to the complete sweeps. If the
+    //   file can be mapped the mapping is shared by all workers.
+    SHRReader reader;
+    if(!SHROpenReader(fileName, reader)) {
+        return false;
+    }
+
+    const SHRFileHeader header = reader.state.header;
+    const SHRMappedFile &mapped = reader.mapped;
+    // When not mapped, each worker opens its own handle
+    SHRCloseFile(reader.state);
+
+    if(onOpen) {
+        onOpen(header);
+    }
+
+    if(threadCount <= 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if(threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+
+    const int sweepCount = header.sweepCount;
+    const int blockCount = (sweepCount + SHR_SWEEPS_PER_BLOCK - 1) / SHR_SWEEPS_PER_BLOCK;
+    if(threadCount > blockCount) {
+        threadCount = blockCount;
+    }
+
+    std::atomic<int> nextBlock(0);
+    std::atomic<bool> failed(false);
+
+    // When not mapped, each worker reads runs of up to this many sweeps at once
+    const int sweepsPerRead = (int)std::max<uint64_t>(1, std::min<uint64_t>(SHR_SWEEPS_PER_BLOCK,
+        SHR_READ_BYTES / (sizeof(SHRSweepHeader) + sizeof(float) * (uint64_t)header.sweepLength)));
+
+    auto worker = [&]() {
+        // Each worker has its own file handle and sweep buffers when not mapped
+        SHRParseState workerState;
+        std::vector<float> sweepBuf;
+        std::vector<SHRSweepHeader> sweepInfoBuf;
+        if(!mapped.base) {
+            if(!SHROpenFile(fileName, workerState)) {
+                failed = true;
+                return;
+            }
+            sweepBuf.resize((size_t)sweepsPerRead * header.sweepLength);
+            sweepInfoBuf.resize(sweepsPerRead);
+        }
+
+        while(!failed) {
+            int block = nextBlock++;
+            if(block >= blockCount) {
+                break;
+            }
+
+            int first = block * SHR_SWEEPS_PER_BLOCK;
+            int last = first + SHR_SWEEPS_PER_BLOCK;
+            if(last > sweepCount) {
+                last = sweepCount;
+            }
+
+            if(mapped.base) {
+                for(int n = first; n < last; n++) {
+                    const SHRSweepHeader *sweepInfo;
+                    const float *sweep;
+                    SHRGetMappedSweep(mapped, n, sweepInfo, sweep);
+                    callback(header, n, *sweepInfo, sweep);
+                }
+                continue;
+            }
+
+            for(int n = first; n < last && !failed; n += sweepsPerRead) {
+                int count = std::min(sweepsPerRead, last - n);
+                if(!SHRGetSweeps(workerState, n, count, sweepBuf.data(), sweepInfoBuf.data())) {
+                    failed = true;
+                    break;
+                }
+                for(int i = 0; i < count; i++) {
+                    callback(header, n + i, sweepInfoBuf[i], &sweepBuf[(size_t)i * header.sweepLength]);
+                }
+            }
+        }
+
+        SHRCloseFile(workerState);
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < threadCount; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    // The calling thread does its share of the work
+    worker();
+    for(std::thread &t : threads) {
+        t.join();
+    }
+
+    SHRCloseReader(reader);
+
+    return !failed;
+}
+
+SHRSweepStats SHRComputeSweepStats(const SHRFileHeader &header, const float *sweep,
+                                   float occupancyThresholdDBm)
+{
+    SHRSweepStats stats;
+    const int len = header.sweepLength;
+
+    int peakIndex = (len > 0) ? traceArgMax(sweep, len) : 0;
+    stats.peakIndex = peakIndex;
+    stats.peakFreqHz = header.firstBinFreqHz + peakIndex * header.binSizeHz;
+    stats.peakAmpl = (len > 0) ? sweep[peakIndex] : 0.0f;
+
+    if(header.refScale == SHRScaleDBM) {
+        stats.meanPowerDBm = traceMeanPowerDBm(sweep, len);
+        stats.occupancy = (len > 0) ? 
+            (float)traceCountAtOrAbove(sweep, len, occupancyThresholdDBm) / len : 0.0f;
+    } else {
+        // mV into 50 ohms
+        double powerSum = 0.0;
+        for(int i = 0; i < len; i++) {
+            double volts = sweep[i] * 1.0e-3;
+            powerSum += (volts * volts / 50.0) * 1.0e3;
+        }
+        stats.meanPowerDBm = (len > 0) ? (float)(10.0 * log10(powerSum / len)) : -INFINITY;
+
+        // Compare in the units of the file
+        double thresholdMw = pow(10.0, occupancyThresholdDBm / 10.0);
+        float threshold = (float)(sqrt(thresholdMw * 1.0e-3 * 50.0) * 1.0e3);
+        stats.occupancy = (len > 0) ? (float)traceCountAtOrAbove(sweep, len, threshold) / len : 0.0f;
+    }
+
+    return stats;
+}
@@ -0,0 +1,70 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates how to process every sweep of an SHR file in parallel
+//   across several threads.
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "shr_parse.h"
+
+// Called once for every sweep in the file.
+// n = sweep index in [0, header.sweepCount-1]
+// sweep = header.sweepLength floats, only valid for the duration of the call
+// Calls for different sweeps are made concurrently from different threads, the
+//   callback must not modify shared state without synchronization.
+typedef std::function<void(const SHRFileHeader &header, int n,
+                           const SHRSweepHeader &sweepInfo, const float *sweep)> SHRSweepCallback;
+
+// Calls callback for every sweep in the file, using threadCount worker threads.
+// Sweeps are handed out to the workers in contiguous blocks. If the file can be
+//   memory mapped, all workers share the mapping, otherwise each worker opens
+//   its own SHRParseState.
+// threadCount = number of worker threads, 0 to use one per hardware thread
+// onOpen = optional, called once with the file header before any sweeps are
+//   processed, can be used to size the output
+// Returns true if every sweep was processed.
+bool SHRForEachSweep(const std::string &fileName, const SHRSweepCallback &callback,
+                     int threadCount = 0,
+                     const std::function<void(const SHRFileHeader &header)> &onOpen = nullptr);
+
+// Runs reducer over every sweep in parallel and stores the per-sweep results
+//   in sweep order, results[n] holds the result for sweep n.
+// T must be default constructible.
+template<typename T>
+bool SHRAnalyzeFile(const std::string &fileName,
+                    const std::function<T(const SHRFileHeader &header, int n,
+                        const SHRSweepHeader &sweepInfo, const float *sweep)> &reducer,
+                    std::vector<T> &results,
+                    int threadCount = 0)
+{
+    results.clear();
+
+    // Each worker writes only to the slots of the sweeps it was handed, so no
+    //   locking is required and the results end up in order.
+    return SHRForEachSweep(fileName,
+        [&](const SHRFileHeader &header, int n, const SHRSweepHeader &sweepInfo, const float *sweep) {
+            results[n] = reducer(header, n, sweepInfo, sweep);
+        },
+        threadCount,
+        [&](const SHRFileHeader &header) {
+            results.resize(header.sweepCount);
+        });
+}
+
+// Basic statistics for a single sweep.
+struct SHRSweepStats {
+    int peakIndex; // Bin index of the peak
+    double peakFreqHz;
+    float peakAmpl; // In the units of the file
+    float meanPowerDBm; // Average power over all bins
+    float occupancy; // Fraction of bins at or above the occupancy threshold [0,1]
+};
+
+// Computes the peak, mean power and occupancy of a single sweep.
+// occupancyThresholdDBm = bins at or above this level are considered occupied
+SHRSweepStats SHRComputeSweepStats(const SHRFileHeader &header, const float *sweep,
+                                   float occupancyThresholdDBm);
@@ -0,0 +1,207 @@
+#include "shr_decimate.h"
+#include "shr_writer.h"
+#include "trace_kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+void SHRSetDecimation(SHRFileHeader &header,
+                      SHRDecimationType type,
+                      SHRDecimationDetector detector,
+                      int count,
+                      int timeMs)
+{
+    header.decimationType = type;
+    header.decimationDetector = detector;
+    header.decimationCount = count;
+    header.decimationTimeMs = timeMs;
+}
+
+SHRDecimator::SHRDecimator() :
+    sweepLength(0),
+    dbm(true),
+    type(SHRDecimationTypeCount),
+    detector(SHRDecimationDetectorAvg),
+    count(1),
+    timeMs(0),
+    groupCount(0)
+{
+    memset(&groupInfo, 0, sizeof(groupInfo));
+}
+
+bool SHRDecimator::Configure(const SHRFileHeader &header, const SHRDecimatorOutput &output)
+{
+    sweepLength = 0;
+    groupCount = 0;
+
+    if(header.sweepLength == 0 || !output) { return false; }
+
+    if(header.decimationType == SHRDecimationTypeCount) {
+        if(header.decimationCount <= 0) { return false; }
+    } else if(header.decimationType == SHRDecimationTypeTime) {
+        if(header.decimationTimeMs <= 0) { return false; }
+    } else {
+        return false;
+    }
+
+    if(header.decimationDetector != SHRDecimationDetectorAvg
+        && header.decimationDetector != SHRDecimationDetectorMax)
+    {
+        return false;
+    }
+
+    this->output = output;
+    sweepLength = header.sweepLength;
+    dbm = header.refScale == SHRScaleDBM;
+    type = (SHRDecimationType)header.decimationType;
+    detector = (SHRDecimationDetector)header.decimationDetector;
+    count = header.decimationCount;
+    timeMs = header.decimationTimeMs;
+    acc.resize(sweepLength);
+
+    return true;
+}
+
+void SHRDecimator::StartGroup(const float *sweep, const SHRSweepHeader &sweepInfo)
+{
+    groupInfo = sweepInfo;
+
+    if(detector == SHRDecimationDetectorMax) {
+        memcpy(acc.data(), sweep, sizeof(float) * sweepLength);
+    } else if(dbm) {
+        memset(acc.data(), 0, sizeof(float) * sweepLength);
+        traceAccumulatePower(acc.data(), sweep, sweepLength);
+    } else {
+        for(int i = 0; i < sweepLength; i++) {
+            acc[i] = sweep[i] * sweep[i];
+        }
+    }
+
+    groupCount = 1;
+}
+
+bool SHRDecimator::EmitGroup()
+{
+    if(detector == SHRDecimationDetectorAvg) {
+        if(dbm) {
+            tracePowerAverageToDBm(acc.data(), acc.data(), groupCount, sweepLength);
+        } else {
+            float scale = 1.0f / groupCount;
+            for(int i = 0; i < sweepLength; i++) {
+                acc[i] = sqrtf(acc[i] * scale);
+            }
+        }
+    }
+
+    groupCount = 0;
+
+    return output(acc.data(), groupInfo);
+}
+
+bool SHRDecimator::Push(const float *sweep, const SHRSweepHeader &sweepInfo)
+{
+    if(sweepLength == 0) { return false; } // Not configured
+
+    // Close the current group if this sweep does not belong to it
+    if(groupCount > 0 && type == SHRDecimationTypeTime
+        && sweepInfo.timestamp >= groupInfo.timestamp + timeMs)
+    {
+        if(!EmitGroup()) {
+            return false;
+        }
+    }
+
+    if(groupCount == 0) {
+        StartGroup(sweep, sweepInfo);
+    } else {
+        if(detector == SHRDecimationDetectorMax) {
+            traceMaxHold(acc.data(), sweep, sweepLength);
+        } else if(dbm) {
+            traceAccumulatePower(acc.data(), sweep, sweepLength);
+        } else {
+            for(int i = 0; i < sweepLength; i++) {
+                acc[i] += sweep[i] * sweep[i];
+            }
+        }
+
+        groupInfo.latitude = sweepInfo.latitude;
+        groupInfo.longitude = sweepInfo.longitude;
+        groupInfo.altitude = sweepInfo.altitude;
+        groupInfo.adcOverflow |= sweepInfo.adcOverflow;
+        groupCount++;
+    }
+
+    if(type == SHRDecimationTypeCount && groupCount >= count) {
+        return EmitGroup();
+    }
+
+    return true;
+}
+
+bool SHRDecimator::Flush()
+{
+    if(sweepLength == 0) { return false; }
+    if(groupCount == 0) { return true; }
+
+    return EmitGroup();
+}
+
+bool SHRDecimateFile(const std::string &fileName,
+                     const std::string &outFileName,
+                     SHRDecimationType type,
+                     SHRDecimationDetector detector,
+                     int count,
+                     int timeMs)
+{
+    SHRReader reader;
+    if(!SHROpenReader(fileName, reader)) {
+        return false;
+    }
+
+    SHRFileHeader header = reader.state.header;
+    // Count decimating a file already count decimated with the same detector
+    //   is equivalent to decimating the original sweeps by the product
+    int totalCount = count;
+    if(type == SHRDecimationTypeCount
+        && header.decimationType == SHRDecimationTypeCount
+        && header.decimationDetector == detector
+        && header.decimationCount > 1)
+    {
+        totalCount = count * header.decimationCount;
+    }
+
+    SHRSetDecimation(header, type, detector, count, timeMs);
+
+    SHRWriter writer;
+    SHRDecimator decimator;
+    if(!decimator.Configure(header, [&](const float *trace, const SHRSweepHeader &sweepInfo) {
+            return writer.Write(trace, sweepInfo);
+        }))
+    {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    header.decimationCount = totalCount;
+    if(!writer.Open(outFileName, header)) {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    bool success = true;
+    for(uint32_t n = 0; n < header.sweepCount && success; n++) {
+        const SHRSweepHeader *sweepInfo;
+        const float *sweep;
+        success = SHRReadSweep(reader, n, sweepInfo, sweep) && decimator.Push(sweep, *sweepInfo);
+    }
+    success = success && decimator.Flush();
+
+    success = writer.Close() && success;
+    SHRCloseReader(reader);
+
+    if(!success) {
+        remove(outFileName.c_str());
+    }
+
+    return success;
+}
@@ -0,0 +1,103 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates applying the SHR decimation settings (decimationType,
+//   decimationDetector, decimationCount, decimationTimeMs) to a stream of sweeps,
+//   either read from an SHR file or acquired live.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "shr_parse.h"
+
+// Called with each decimated trace, trace = sweepLength floats, only valid for
+//   the duration of the call. Return false to stop, Push then returns false.
+typedef std::function<bool(const float *trace, const SHRSweepHeader &sweepInfo)> SHRDecimatorOutput;
+
+// Sets the decimation fields of an SHR file header
+void SHRSetDecimation(SHRFileHeader &header,
+                      SHRDecimationType type,
+                      SHRDecimationDetector detector,
+                      int count,
+                      int timeMs);
+
+// Streaming decimator, reduces sweeps as they are pushed and emits one trace per
+//   group of sweeps. Memory use is a single accumulator trace regardless of how
+//   many sweeps are pushed.
+//
+// SHRDecimationTypeCount groups every decimationCount sweeps.
+// SHRDecimationTypeTime groups the sweeps within decimationTimeMs of the first
+//   sweep of the group, a group is emitted when a sweep outside of it is pushed.
+// SHRDecimationDetectorAvg averages in linear power (mW for dBm sweeps, V^2 for
+//   mV sweeps) and returns to the units of the sweeps.
+// SHRDecimationDetectorMax keeps the largest value of each bin.
+//
+// The emitted sweep header has the timestamp of the first sweep in the group,
+//   the position of the last sweep, and adcOverflow set if any sweep overflowed.
+//
+// Example, decimating the SM THz sweep loop into an SHR file:
+//   SHRFileHeader header;
+//   SHRInitFileHeader(header, sweepSize, startFreq, binSize, rbw, vbw, -20.0f, SHRScaleDBM);
+//   SHRSetDecimation(header, SHRDecimationTypeTime, SHRDecimationDetectorMax, 1, 1000);
+//   SHRWriter writer;
+//   writer.Open("recording.shr", header);
+//   SHRDecimator decimator;
+//   decimator.Configure(header, [&](const float *trace, const SHRSweepHeader &info) {
+//       return writer.Write(trace, info);
+//   });
+//   while(...) {
+//       smFinishSweep(handle, queuePos, nullptr, sweep, nullptr);
+//       decimator.Push(sweep, sweepInfo);
+//   }
+//   decimator.Flush();
+//   writer.Close();
+class SHRDecimator {
+public:
+    SHRDecimator();
+
+    // Configure from the sweep and decimation fields of a header.
+    // header.sweepLength, refScale, decimationType, decimationDetector and
+    //   decimationCount or decimationTimeMs must be set.
+    // Discards any partial group. Returns false if the settings are invalid.
+    bool Configure(const SHRFileHeader &header, const SHRDecimatorOutput &output);
+
+    // Add one sweep of sweepLength floats, emits a trace when a group completes.
+    // Returns false if not configured or the output returned false.
+    bool Push(const float *sweep, const SHRSweepHeader &sweepInfo);
+
+    // Emits the partial group, if any. Call after the last sweep.
+    bool Flush();
+
+    // Number of sweeps in the current partial group
+    int PendingCount() const { return groupCount; }
+
+private:
+    void StartGroup(const float *sweep, const SHRSweepHeader &sweepInfo);
+    bool EmitGroup();
+
+    SHRDecimatorOutput output;
+    int sweepLength;
+    bool dbm;
+    SHRDecimationType type;
+    SHRDecimationDetector detector;
+    int count;
+    uint64_t timeMs;
+
+    std::vector<float> acc; // Linear power sum or max hold
+    int groupCount;
+    SHRSweepHeader groupInfo;
+};
+
+// Decimates an SHR file into a new SHR file.
+// The output header is the input header with the new decimation settings.
+// Returns false if either file cannot be opened, the settings are invalid or a
+//   read/write fails.
+bool SHRDecimateFile(const std::string &fileName,
+                     const std::string &outFileName,
+                     SHRDecimationType type,
+                     SHRDecimationDetector detector,
+                     int count,
+                     int timeMs);
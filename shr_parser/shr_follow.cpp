@@ -0,0 +1,278 @@
+#include "shr_follow.h"
+
+#include <chrono>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+#pragma warning(disable:4996)
+
+// Size of an open file, works after the file has been renamed
+static uint64_t SHRGetOpenFileSize(FILE *f)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+    if(_fstat64(_fileno(f), &st) != 0) {
+        return 0;
+    }
+#else
+    struct stat st;
+    if(fstat(fileno(f), &st) != 0) {
+        return 0;
+    }
+#endif
+    return (uint64_t)st.st_size;
+}
+
+// True if the open file has been deleted
+static bool SHRIsOpenFileDeleted(FILE *f)
+{
+#if defined(_WIN32)
+    // Open files cannot be deleted on Windows unless opened with FILE_SHARE_DELETE
+    return false;
+#else
+    struct stat st;
+    return fstat(fileno(f), &st) == 0 && st.st_nlink == 0;
+#endif
+}
+
+SHRFollower::SHRFollower() :
+    f(nullptr),
+    haveHeader(false),
+    firstSweep(0),
+    sweepSizeInBytes(0),
+    nextSweep(0),
+    running(false),
+    stop(false),
+    stopFd(-1)
+{
+}
+
+SHRFollower::~SHRFollower()
+{
+    Stop();
+    Close();
+}
+
+bool SHRFollower::Open(const std::string &fileName, int firstSweep)
+{
+    if(f) { return false; } // Already open
+
+    f = fopen(fileName.c_str(), "rb");
+    if(!f) { return false; }
+
+    this->fileName = fileName;
+    this->firstSweep = firstSweep;
+    haveHeader = false;
+    nextSweep = 0;
+
+    ReadHeader();
+
+    return true;
+}
+
+void SHRFollower::Close()
+{
+    if(thread.joinable()) { return; } // Stop first
+
+    if(f) {
+        fclose(f);
+        f = nullptr;
+    }
+    haveHeader = false;
+}
+
+bool SHRFollower::ReadHeader()
+{
+    if(haveHeader) { return true; }
+
+    uint64_t fileSize = SHRGetOpenFileSize(f);
+    if(fileSize < sizeof(SHRFileHeader)) {
+        return false; // Not written yet
+    }
+
+    if(!SHRFileSeek(f, 0) || fread(&header, sizeof(SHRFileHeader), 1, f) != 1) {
+        return false;
+    }
+    if(header.signature != SHRFileSignature || header.version > SHRFileVersion
+        || header.sweepLength == 0 || header.dataOffset < sizeof(SHRFileHeader))
+    {
+        return false;
+    }
+
+    sweepSizeInBytes = sizeof(SHRSweepHeader) + sizeof(float) * (uint64_t)header.sweepLength;
+    sweepBuf.resize(header.sweepLength);
+    haveHeader = true;
+
+    if(firstSweep >= 0) {
+        nextSweep = firstSweep;
+    } else if(fileSize >= header.dataOffset) {
+        // Skip everything already recorded
+        nextSweep = (uint32_t)((fileSize - header.dataOffset) / sweepSizeInBytes);
+    }
+
+    return true;
+}
+
+int SHRFollower::Poll(const SHRFollowCallback &callback)
+{
+    if(!f) { return -1; }
+    if(!ReadHeader()) { return 0; }
+
+    // Only complete sweeps, the last one may still be being written
+    uint64_t fileSize = SHRGetOpenFileSize(f);
+    if(fileSize < header.dataOffset) { return 0; }
+    uint64_t complete = (fileSize - header.dataOffset) / sweepSizeInBytes;
+    if(nextSweep >= complete) { return 0; }
+
+    // The seek also clears the end of file state left by the previous poll
+    if(!SHRFileSeek(f, header.dataOffset + sweepSizeInBytes * nextSweep)) {
+        return -1;
+    }
+
+    int delivered = 0;
+    while(nextSweep < complete) {
+        SHRSweepHeader sweepInfo;
+        if(fread(&sweepInfo, sizeof(SHRSweepHeader), 1, f) != 1
+            || fread(sweepBuf.data(), sizeof(float), sweepBuf.size(), f) != sweepBuf.size())
+        {
+            return -1; // File truncated
+        }
+
+        header.sweepCount = nextSweep + 1;
+        uint32_t n = nextSweep++;
+        if(!callback(header, n, sweepInfo, sweepBuf.data())) {
+            return -1;
+        }
+        delivered++;
+    }
+
+    return delivered;
+}
+
+bool SHRFollower::Start(const std::string &fileName,
+                        const SHRFollowCallback &callback,
+                        int firstSweep,
+                        int pollIntervalMs)
+{
+    if(thread.joinable() || !callback) { return false; }
+    if(!Open(fileName, firstSweep)) { return false; }
+
+    if(pollIntervalMs < 1) {
+        pollIntervalMs = 1;
+    }
+
+#if defined(__linux__)
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+
+    stop = false;
+    running = true;
+    thread = std::thread(&SHRFollower::FollowThread, this, callback, pollIntervalMs);
+
+    return true;
+}
+
+void SHRFollower::Stop()
+{
+    if(thread.joinable()) {
+        stop = true;
+#if defined(__linux__)
+        if(stopFd >= 0) {
+            uint64_t one = 1;
+            ssize_t written = write(stopFd, &one, sizeof(one));
+            (void)written;
+        }
+#endif
+        thread.join();
+    }
+
+#if defined(__linux__)
+    if(stopFd >= 0) {
+        close(stopFd);
+        stopFd = -1;
+    }
+#endif
+
+    Close();
+}
+
+void SHRFollower::FollowThread(SHRFollowCallback callback, int pollIntervalMs)
+{
+#if defined(__linux__)
+    // Wake on every write to the file and on unlink (IN_ATTRIB, the file is held
+    //   open so IN_DELETE_SELF is not sent until we close it).
+    // Fall back to polling if inotify is unavailable
+    int watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watchFd >= 0 && inotify_add_watch(watchFd, fileName.c_str(),
+        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+    {
+        close(watchFd);
+        watchFd = -1;
+    }
+#endif
+
+    bool gone = false;
+    while(!stop) {
+        if(Poll(callback) < 0) {
+            break;
+        }
+        // Deleted or renamed, the remaining sweeps have been delivered above
+        if(gone || SHRIsOpenFileDeleted(f)) {
+            break;
+        }
+
+#if defined(__linux__)
+        struct pollfd fds[2];
+        int fdCount = 0;
+        if(watchFd >= 0) {
+            fds[fdCount].fd = watchFd;
+            fds[fdCount].events = POLLIN;
+            fdCount++;
+        }
+        if(stopFd >= 0) {
+            fds[fdCount].fd = stopFd;
+            fds[fdCount].events = POLLIN;
+            fdCount++;
+        }
+
+        if(poll(fds, fdCount, pollIntervalMs) > 0 && watchFd >= 0 && (fds[0].revents & POLLIN)) {
+            // Drain the pending events, only the self events need handling
+            alignas(struct inotify_event) char events[4096];
+            ssize_t len;
+            while((len = read(watchFd, events, sizeof(events))) > 0) {
+                for(char *p = events; p < events + len; ) {
+                    const struct inotify_event *event = (const struct inotify_event*)p;
+                    if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        gone = true;
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            }
+        }
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(pollIntervalMs));
+#endif
+    }
+
+#if defined(__linux__)
+    if(watchFd >= 0) {
+        close(watchFd);
+    }
+#endif
+
+    running = false;
+}
@@ -0,0 +1,93 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates reading an SHR file while it is still being recorded,
+//   for example by Spike or SHRWriter.
+// The sweepCount in the file header is only updated when the recording is
+//   closed, so the number of complete sweeps is determined from the file size.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shr_parse.h"
+
+// Called once for each new sweep, in sweep order, from the follower thread.
+// n = sweep index in the file
+// sweep = header.sweepLength floats, only valid for the duration of the call
+// Return false to stop following.
+typedef std::function<bool(const SHRFileHeader &header, int n,
+                           const SHRSweepHeader &sweepInfo, const float *sweep)> SHRFollowCallback;
+
+// Follows an SHR file as it grows and delivers every new sweep to a callback.
+// Each sweep is read once, earlier sweeps are never read again.
+// On Linux the file is watched with inotify and sweeps are delivered as soon as
+//   they are completely written. On other platforms the file size is polled
+//   every pollIntervalMs.
+//
+// Example:
+//   SHRFollower follower;
+//   follower.Start("recording.shr", [](const SHRFileHeader &header, int n,
+//       const SHRSweepHeader &sweepInfo, const float *sweep) {
+//       ...
+//       return true;
+//   });
+//   ...
+//   follower.Stop();
+class SHRFollower {
+public:
+    SHRFollower();
+    ~SHRFollower(); // Stops following
+
+    // Starts following fileName on a background thread.
+    // The file must exist, the header may not be written yet.
+    // firstSweep = first sweep to deliver, 0 to deliver the whole file, -1 to
+    //   only deliver sweeps written after Start
+    // pollIntervalMs = how often the file size is checked when not notified of
+    //   changes. On Linux this is only a safety net.
+    bool Start(const std::string &fileName,
+               const SHRFollowCallback &callback,
+               int firstSweep = 0,
+               int pollIntervalMs = 50);
+
+    // Stops following and waits for the follower thread to exit
+    void Stop();
+
+    // Alternative to Start/Stop for single threaded use, for example from a GUI
+    //   timer. Open the file, then call Poll periodically to deliver any new
+    //   sweeps on the calling thread.
+    bool Open(const std::string &fileName, int firstSweep = 0);
+    // Returns the number of sweeps delivered, -1 if the callback returned false
+    //   or a read failed
+    int Poll(const SHRFollowCallback &callback);
+    void Close();
+
+    // False once the follower thread has exited, because of Stop, the callback
+    //   returning false, or the file being deleted or renamed
+    bool IsRunning() const { return running; }
+    // Index of the next sweep to be delivered
+    uint32_t NextSweep() const { return nextSweep; }
+
+private:
+    void FollowThread(SHRFollowCallback callback, int pollIntervalMs);
+    // Reads the file header once enough of the file has been written
+    bool ReadHeader();
+
+    FILE *f;
+    std::string fileName;
+    SHRFileHeader header;
+    bool haveHeader;
+    int firstSweep;
+    uint64_t sweepSizeInBytes;
+    std::atomic<uint32_t> nextSweep;
+    std::vector<float> sweepBuf;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> stop;
+    int stopFd; // Linux, eventfd used to wake the follower thread on Stop
+};
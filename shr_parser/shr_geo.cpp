@@ -0,0 +1,333 @@
+#include "shr_geo.h"
+#include "shr_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#pragma warning(disable:4996)
+
+const uint32_t SHRGeoIndexSignature = 0x47524853; // "SHRG"
+// Version 2 identifies the SHR file with SHRSideCarSource
+const uint32_t SHRGeoIndexVersion = 0x2;
+
+// Mean earth radius
+static const double SHR_EARTH_RADIUS_M = 6371008.8;
+static const double SHR_PI = 3.14159265358979323846;
+static const double SHR_METERS_PER_DEG_LAT = SHR_EARTH_RADIUS_M * SHR_PI / 180.0;
+
+// The side-car file is this header followed by SHRGeoIndexEntry[entryCount]
+#pragma pack(push,1)
+struct SHRGeoIndexFileHeader {
+    uint32_t signature;
+    uint32_t version;
+    SHRSideCarSource source;
+    uint32_t entryCount;
+    double cellSizeM;
+    double originLat;
+    double originLon;
+    double metersPerDegLon;
+};
+#pragma pack(pop)
+
+std::string SHRGeoIndexFileName(const std::string &fileName)
+{
+    return fileName + ".shrg";
+}
+
+static bool SHRHasPosition(const SHRSweepHeader &sweepInfo)
+{
+    if(std::isnan(sweepInfo.latitude) || std::isnan(sweepInfo.longitude)) {
+        return false;
+    }
+
+    return sweepInfo.latitude != 0.0 || sweepInfo.longitude != 0.0;
+}
+
+// Grid column/row containing a position, clamped to the grid
+static uint32_t SHRGeoColumn(const SHRGeoIndex &index, double longitude)
+{
+    double x = floor((longitude - index.originLon) * index.metersPerDegLon / index.cellSizeM);
+    return (uint32_t)std::min(std::max(x, 0.0), (double)UINT32_MAX);
+}
+
+static uint32_t SHRGeoRow(const SHRGeoIndex &index, double latitude)
+{
+    double y = floor((latitude - index.originLat) * SHR_METERS_PER_DEG_LAT / index.cellSizeM);
+    return (uint32_t)std::min(std::max(y, 0.0), (double)UINT32_MAX);
+}
+
+static uint64_t SHRGeoCell(uint32_t row, uint32_t col)
+{
+    return ((uint64_t)row << 32) | col;
+}
+
+static bool SHRCompareCells(const SHRGeoIndexEntry &a, const SHRGeoIndexEntry &b)
+{
+    if(a.cell != b.cell) {
+        return a.cell < b.cell;
+    }
+    return a.sweep < b.sweep;
+}
+
+bool SHRBuildGeoIndex(const std::string &fileName, SHRGeoIndex &index, double cellSizeM)
+{
+    index = SHRGeoIndex();
+    if(!(cellSizeM > 0.0)) { return false; }
+
+    // Read the position of every sweep, only the sweep headers are touched
+    SHRMappedFile mapped;
+    SHRParseState state;
+    uint32_t sweepsRead = 0;
+    if(SHROpenMappedFile(fileName, mapped)) {
+        sweepsRead = mapped.sweepCount;
+        for(uint32_t n = 0; n < mapped.sweepCount; n++) {
+            const SHRSweepHeader *sweepInfo;
+            const float *sweep;
+            SHRGetMappedSweep(mapped, n, sweepInfo, sweep);
+            if(SHRHasPosition(*sweepInfo)) {
+                SHRGeoIndexEntry entry;
+                entry.cell = 0;
+                entry.latitude = sweepInfo->latitude;
+                entry.longitude = sweepInfo->longitude;
+                entry.altitude = sweepInfo->altitude;
+                entry.sweep = n;
+                index.entries.push_back(entry);
+            }
+        }
+        SHRCloseMappedFile(mapped);
+    } else {
+        if(!SHROpenFile(fileName, state)) {
+            return false;
+        }
+
+        for(uint32_t n = 0; n < state.header.sweepCount; n++) {
+            // Only read the sweep header, skip the sweep data
+            SHRSweepHeader sweepInfo;
+            if(!SHRFileSeek(state.f, SHRSweepOffset(state.header, n))
+                || fread(&sweepInfo, 1, sizeof(SHRSweepHeader), state.f) != sizeof(SHRSweepHeader)) {
+                break; // Truncated file, index the complete sweeps
+            }
+            sweepsRead = n + 1;
+
+            if(SHRHasPosition(sweepInfo)) {
+                SHRGeoIndexEntry entry;
+                entry.cell = 0;
+                entry.latitude = sweepInfo.latitude;
+                entry.longitude = sweepInfo.longitude;
+                entry.altitude = sweepInfo.altitude;
+                entry.sweep = n;
+                index.entries.push_back(entry);
+            }
+        }
+        SHRCloseFile(state);
+    }
+
+    if(!SHRGetSideCarSource(fileName, sweepsRead, index.source)) {
+        index = SHRGeoIndex();
+        return false;
+    }
+
+    // Place the grid over the bounding box of the positions
+    index.cellSizeM = cellSizeM;
+    if(!index.entries.empty()) {
+        double latMin = index.entries[0].latitude, latMax = latMin;
+        double lonMin = index.entries[0].longitude;
+        for(const SHRGeoIndexEntry &entry : index.entries) {
+            latMin = std::min(latMin, entry.latitude);
+            latMax = std::max(latMax, entry.latitude);
+            lonMin = std::min(lonMin, entry.longitude);
+        }
+        index.originLat = latMin;
+        index.originLon = lonMin;
+        index.metersPerDegLon = SHR_METERS_PER_DEG_LAT * cos((latMin + latMax) * 0.5 * SHR_PI / 180.0);
+        if(index.metersPerDegLon < 1.0) {
+            index.metersPerDegLon = 1.0; // Polar recordings
+        }
+    }
+
+    for(SHRGeoIndexEntry &entry : index.entries) {
+        entry.cell = SHRGeoCell(SHRGeoRow(index, entry.latitude), SHRGeoColumn(index, entry.longitude));
+    }
+    std::sort(index.entries.begin(), index.entries.end(), SHRCompareCells);
+
+    return true;
+}
+
+bool SHRSaveGeoIndex(const std::string &indexFileName, const SHRGeoIndex &index)
+{
+    FILE *f = fopen(indexFileName.c_str(), "wb");
+    if(!f) { return false; }
+
+    SHRGeoIndexFileHeader header;
+    header.signature = SHRGeoIndexSignature;
+    header.version = SHRGeoIndexVersion;
+    header.source = index.source;
+    header.entryCount = (uint32_t)index.entries.size();
+    header.cellSizeM = index.cellSizeM;
+    header.originLat = index.originLat;
+    header.originLon = index.originLon;
+    header.metersPerDegLon = index.metersPerDegLon;
+
+    bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+    if(success && !index.entries.empty()) {
+        success = fwrite(index.entries.data(), sizeof(SHRGeoIndexEntry),
+            index.entries.size(), f) == index.entries.size();
+    }
+    success = (fclose(f) == 0) && success;
+
+    if(!success) {
+        remove(indexFileName.c_str()); // Don't leave a partial index behind
+    }
+
+    return success;
+}
+
+bool SHRLoadGeoIndex(const std::string &indexFileName, const std::string &fileName,
+                     SHRGeoIndex &index)
+{
+    index = SHRGeoIndex();
+
+    FILE *f = fopen(indexFileName.c_str(), "rb");
+    if(!f) { return false; }
+
+    SHRGeoIndexFileHeader header;
+    if(fread(&header, sizeof(header), 1, f) != 1
+        || header.signature != SHRGeoIndexSignature
+        || header.version != SHRGeoIndexVersion
+        || header.entryCount > header.source.coveredSweeps
+        || header.source.sweepCount < header.source.coveredSweeps
+        || !(header.cellSizeM > 0.0)
+        || !SHRCheckSideCarSource(fileName, header.source))
+    {
+        fclose(f);
+        return false; // Stale or invalid index, or an older version
+    }
+
+    index.source = header.source;
+    index.cellSizeM = header.cellSizeM;
+    index.originLat = header.originLat;
+    index.originLon = header.originLon;
+    index.metersPerDegLon = header.metersPerDegLon;
+    index.entries.resize(header.entryCount);
+    bool success = true;
+    if(header.entryCount > 0) {
+        success = fread(index.entries.data(), sizeof(SHRGeoIndexEntry),
+            header.entryCount, f) == header.entryCount;
+    }
+    fclose(f);
+
+    if(!success) {
+        index = SHRGeoIndex();
+    }
+
+    return success;
+}
+
+bool SHROpenGeoIndex(const std::string &fileName, SHRGeoIndex &index, bool saveSideCar)
+{
+    std::string indexFileName = SHRGeoIndexFileName(fileName);
+    if(SHRLoadGeoIndex(indexFileName, fileName, index)) {
+        return true;
+    }
+
+    if(!SHRBuildGeoIndex(fileName, index)) {
+        return false;
+    }
+
+    if(saveSideCar) {
+        SHRSaveGeoIndex(indexFileName, index);
+    }
+
+    return true;
+}
+
+double SHRGeoDistanceM(double lat0, double lon0, double lat1, double lon1)
+{
+    // Haversine
+    const double toRad = SHR_PI / 180.0;
+    double dLat = (lat1 - lat0) * toRad;
+    double dLon = (lon1 - lon0) * toRad;
+    double a = sin(dLat * 0.5) * sin(dLat * 0.5)
+        + cos(lat0 * toRad) * cos(lat1 * toRad) * sin(dLon * 0.5) * sin(dLon * 0.5);
+
+    return 2.0 * SHR_EARTH_RADIUS_M * asin(std::min(1.0, sqrt(a)));
+}
+
+// Calls fn with the index of every entry in the grid cells overlapping the box.
+// Each row of cells is a contiguous range of entries found with a binary search.
+template<typename Fn>
+static void SHRForEachEntryInCells(const SHRGeoIndex &index, double latMin, double latMax,
+                                   double lonMin, double lonMax, Fn fn)
+{
+    if(index.entries.empty() || latMax < latMin || lonMax < lonMin) {
+        return;
+    }
+    // Entirely south or west of the grid
+    if(latMax < index.originLat || lonMax < index.originLon) {
+        return;
+    }
+
+    uint32_t row0 = SHRGeoRow(index, latMin), row1 = SHRGeoRow(index, latMax);
+    uint32_t col0 = SHRGeoColumn(index, lonMin), col1 = SHRGeoColumn(index, lonMax);
+    uint32_t lastRow = (uint32_t)(index.entries.back().cell >> 32);
+    if(row1 > lastRow) {
+        row1 = lastRow;
+    }
+
+    auto it = index.entries.begin();
+    for(uint64_t row = row0; row <= row1; row++) {
+        SHRGeoIndexEntry lo, hi;
+        lo.cell = SHRGeoCell((uint32_t)row, col0);
+        lo.sweep = 0;
+        hi.cell = SHRGeoCell((uint32_t)row, col1);
+        hi.sweep = UINT32_MAX;
+
+        auto begin = std::lower_bound(it, index.entries.end(), lo, SHRCompareCells);
+        auto end = std::upper_bound(begin, index.entries.end(), hi, SHRCompareCells);
+        for(auto e = begin; e != end; ++e) {
+            fn((uint32_t)(e - index.entries.begin()));
+        }
+        it = end;
+    }
+}
+
+bool SHRFindSweepsNear(const SHRGeoIndex &index, double latitude, double longitude,
+                       double radiusM, std::vector<uint32_t> &sweeps)
+{
+    sweeps.clear();
+    if(!(radiusM >= 0.0)) { return false; }
+
+    // Bounding box of the circle, then the exact distance for each candidate
+    double dLat = radiusM / SHR_METERS_PER_DEG_LAT;
+    double cosLat = std::max(cos(latitude * SHR_PI / 180.0), 1.0e-6);
+    double dLon = std::min(radiusM / (SHR_METERS_PER_DEG_LAT * cosLat), 180.0);
+
+    SHRForEachEntryInCells(index, latitude - dLat, latitude + dLat,
+        longitude - dLon, longitude + dLon, [&](uint32_t i) {
+            const SHRGeoIndexEntry &entry = index.entries[i];
+            if(SHRGeoDistanceM(latitude, longitude, entry.latitude, entry.longitude) <= radiusM) {
+                sweeps.push_back(entry.sweep);
+            }
+        });
+
+    std::sort(sweeps.begin(), sweeps.end());
+
+    return !sweeps.empty();
+}
+
+bool SHRFindSweepsInBox(const SHRGeoIndex &index, double latMin, double latMax,
+                        double lonMin, double lonMax, std::vector<uint32_t> &entries)
+{
+    entries.clear();
+
+    SHRForEachEntryInCells(index, latMin, latMax, lonMin, lonMax, [&](uint32_t i) {
+        const SHRGeoIndexEntry &entry = index.entries[i];
+        if(entry.latitude >= latMin && entry.latitude <= latMax
+            && entry.longitude >= lonMin && entry.longitude <= lonMax)
+        {
+            entries.push_back(i);
+        }
+    });
+
+    return !entries.empty();
+}
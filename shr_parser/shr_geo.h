@@ -0,0 +1,85 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates how to build a position index for an SHR file so that
+//   the sweeps recorded near a location, for example during a drive test, can be
+//   found without reading the whole file.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shr_index.h"
+
+// The index is a sparse grid of square cells, cellSizeM meters on a side, laid
+//   over the latitude/longitude of every sweep. Entries are sorted by cell, so
+//   the sweeps within a cell, and within a row of cells, are contiguous and are
+//   found with a binary search.
+// Sweeps without a position fix (latitude and longitude both zero, or NaN) are
+//   not indexed. Recordings spanning the antimeridian are not supported.
+#pragma pack(push,1)
+struct SHRGeoIndexEntry {
+    uint64_t cell; // Row in the upper 32 bits, column in the lower 32 bits
+    double latitude;
+    double longitude;
+    double altitude; // meters
+    uint32_t sweep; // sweep index in the SHR file
+};
+#pragma pack(pop)
+
+struct SHRGeoIndex {
+    SHRGeoIndex() : cellSizeM(0.0), originLat(0.0), originLon(0.0), metersPerDegLon(0.0)
+    {
+        memset(&source, 0, sizeof(source));
+    }
+
+    // Used to verify a side-car index still matches the SHR file, see SHRSideCarSource
+    SHRSideCarSource source;
+
+    // Grid, cell (0, 0) has its south west corner at originLat/originLon
+    double cellSizeM;
+    double originLat;
+    double originLon;
+    double metersPerDegLon; // At the center of the indexed positions
+
+    std::vector<SHRGeoIndexEntry> entries;
+};
+
+// Returns the name of the side-car index file for an SHR file, which is the SHR
+//   file name with ".shrg" appended.
+std::string SHRGeoIndexFileName(const std::string &fileName);
+
+// Builds the index by reading the header of every sweep in the file.
+// cellSizeM = grid cell size in meters, queries are fastest when the cell size
+//   is close to the typical query radius
+bool SHRBuildGeoIndex(const std::string &fileName, SHRGeoIndex &index, double cellSizeM = 100.0);
+// Writes/reads the index to/from a side-car file.
+// SHRLoadGeoIndex fails if the side-car does not match the SHR file, for example
+//   if the SHR file was modified after the index was written.
+bool SHRSaveGeoIndex(const std::string &indexFileName, const SHRGeoIndex &index);
+bool SHRLoadGeoIndex(const std::string &indexFileName, const std::string &fileName,
+                     SHRGeoIndex &index);
+
+// Loads the side-car index for the SHR file if one exists and is valid, otherwise
+//   builds the index from the SHR file and, if saveSideCar is true, writes the
+//   side-car for next time. Failing to write the side-car is not an error.
+bool SHROpenGeoIndex(const std::string &fileName, SHRGeoIndex &index, bool saveSideCar = true);
+
+// Returns the great circle distance in meters between two positions
+double SHRGeoDistanceM(double lat0, double lon0, double lat1, double lon1);
+
+// Finds the sweeps recorded within radiusM meters of latitude/longitude.
+// Only the grid cells overlapping the circle are examined.
+// sweeps = set to the matching sweep indices in ascending order
+// Returns true if at least one sweep matches.
+bool SHRFindSweepsNear(const SHRGeoIndex &index, double latitude, double longitude,
+                       double radiusM, std::vector<uint32_t> &sweeps);
+
+// Finds the sweeps recorded within a latitude/longitude box, for example the
+//   visible area of a map view.
+// entries = set to the indices of the matching entries in index.entries, which
+//   hold the sweep index and position, in cell order
+// Returns true if at least one sweep matches.
+bool SHRFindSweepsInBox(const SHRGeoIndex &index, double latMin, double latMax,
+                        double lonMin, double lonMax, std::vector<uint32_t> &entries);
@@ -0,0 +1,241 @@
+#include "shr_index.h"
+
+#include <algorithm>
+
+#pragma warning(disable:4996)
+
+const uint32_t SHRTimeIndexSignature = 0x49524853; // "SHRI"
+// Version 3 identifies the SHR file with SHRSideCarSource
+const uint32_t SHRTimeIndexVersion = 0x3;
+
+// The side-car file is this header followed by SHRTimeIndexEntry[entryCount]
+#pragma pack(push,1)
+struct SHRTimeIndexFileHeader {
+    uint32_t signature;
+    uint32_t version;
+    SHRSideCarSource source;
+    uint32_t entryCount;
+};
+#pragma pack(pop)
+
+std::string SHRTimeIndexFileName(const std::string &fileName)
+{
+    return fileName + ".shri";
+}
+
+uint64_t SHRSweepOffset(const SHRFileHeader &header, int n)
+{
+    uint64_t sweepSizeInBytes = sizeof(float) * (uint64_t)header.sweepLength
+        + sizeof(SHRSweepHeader);
+
+    return header.dataOffset + sweepSizeInBytes * n;
+}
+
+// Reads only the timestamp from the header of sweep n
+static bool SHRReadSweepTimestamp(SHRParseState &state, int n, uint64_t &timestamp)
+{
+    SHRSweepHeader sweepInfo;
+    if(!SHRFileSeek(state.f, SHRSweepOffset(state.header, n))
+        || fread(&sweepInfo, 1, sizeof(SHRSweepHeader), state.f) != sizeof(SHRSweepHeader)) {
+        return false;
+    }
+
+    timestamp = sweepInfo.timestamp;
+    return true;
+}
+
+bool SHRGetSideCarSource(const std::string &fileName, uint32_t coveredSweeps,
+                         SHRSideCarSource &source)
+{
+    memset(&source, 0, sizeof(source));
+
+    SHRParseState state;
+    if(!SHROpenFile(fileName, state)) {
+        return false;
+    }
+
+    source.fileSize = SHRGetFileSize(fileName);
+    source.modTime = SHRGetFileModTime(fileName);
+    source.dataOffset = state.header.dataOffset;
+    source.sweepLength = state.header.sweepLength;
+    source.sweepCount = state.header.sweepCount;
+    source.coveredSweeps = coveredSweeps;
+
+    bool success = true;
+    if(coveredSweeps > 0) {
+        success = SHRReadSweepTimestamp(state, 0, source.firstTimestamp)
+            && SHRReadSweepTimestamp(state, coveredSweeps - 1, source.lastTimestamp);
+    }
+    SHRCloseFile(state);
+
+    return success;
+}
+
+bool SHRCheckSideCarSource(const std::string &fileName, const SHRSideCarSource &source)
+{
+    SHRSideCarSource current;
+    if(!SHRGetSideCarSource(fileName, source.coveredSweeps, current)) {
+        return false; // Unreadable, or no longer holds the covered sweeps
+    }
+
+    // Packed with no padding, every byte is a field
+    return memcmp(&current, &source, sizeof(source)) == 0;
+}
+
+static bool SHRCompareEntries(const SHRTimeIndexEntry &a, const SHRTimeIndexEntry &b)
+{
+    return a.timestamp < b.timestamp;
+}
+
+bool SHRBuildTimeIndex(const std::string &fileName, SHRTimeIndex &index)
+{
+    index = SHRTimeIndex();
+
+    SHRMappedFile mapped;
+    if(SHROpenMappedFile(fileName, mapped)) {
+        // Only the sweep headers are touched, one page per sweep at most
+        index.entries.resize(mapped.sweepCount);
+        for(uint32_t n = 0; n < mapped.sweepCount; n++) {
+            const SHRSweepHeader *sweepInfo;
+            const float *sweep;
+            SHRGetMappedSweep(mapped, n, sweepInfo, sweep);
+            index.entries[n].timestamp = sweepInfo->timestamp;
+            index.entries[n].sweep = n;
+        }
+        SHRCloseMappedFile(mapped);
+    } else {
+        SHRParseState state;
+        if(!SHROpenFile(fileName, state)) {
+            return false;
+        }
+
+        index.entries.reserve(state.header.sweepCount);
+        for(uint32_t n = 0; n < state.header.sweepCount; n++) {
+            // Only read the sweep header, skip the sweep data
+            SHRTimeIndexEntry entry;
+            if(!SHRReadSweepTimestamp(state, n, entry.timestamp)) {
+                break; // Truncated file, index the complete sweeps
+            }
+            entry.sweep = n;
+            index.entries.push_back(entry);
+        }
+        SHRCloseFile(state);
+    }
+
+    if(!SHRGetSideCarSource(fileName, (uint32_t)index.entries.size(), index.source)) {
+        index = SHRTimeIndex();
+        return false;
+    }
+
+    // Already sorted for files recorded in time order, stable keeps equal
+    //   timestamps in sweep order
+    if(!std::is_sorted(index.entries.begin(), index.entries.end(), SHRCompareEntries)) {
+        std::stable_sort(index.entries.begin(), index.entries.end(), SHRCompareEntries);
+    }
+
+    return true;
+}
+
+bool SHRSaveTimeIndex(const std::string &indexFileName, const SHRTimeIndex &index)
+{
+    FILE *f = fopen(indexFileName.c_str(), "wb");
+    if(!f) { return false; }
+
+    SHRTimeIndexFileHeader header;
+    header.signature = SHRTimeIndexSignature;
+    header.version = SHRTimeIndexVersion;
+    header.source = index.source;
+    header.entryCount = (uint32_t)index.entries.size();
+
+    bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+    if(success && !index.entries.empty()) {
+        success = fwrite(index.entries.data(), sizeof(SHRTimeIndexEntry),
+            index.entries.size(), f) == index.entries.size();
+    }
+    success = (fclose(f) == 0) && success;
+
+    if(!success) {
+        remove(indexFileName.c_str()); // Don't leave a partial index behind
+    }
+
+    return success;
+}
+
+bool SHRLoadTimeIndex(const std::string &indexFileName, const std::string &fileName,
+                      SHRTimeIndex &index)
+{
+    index = SHRTimeIndex();
+
+    FILE *f = fopen(indexFileName.c_str(), "rb");
+    if(!f) { return false; }
+
+    SHRTimeIndexFileHeader header;
+    if(fread(&header, sizeof(header), 1, f) != 1
+        || header.signature != SHRTimeIndexSignature
+        || header.version != SHRTimeIndexVersion)
+    {
+        fclose(f);
+        return false; // Invalid index, or an older version without the checks below
+    }
+
+    if(header.entryCount != header.source.coveredSweeps
+        || header.source.sweepCount < header.source.coveredSweeps
+        || !SHRCheckSideCarSource(fileName, header.source))
+    {
+        fclose(f);
+        return false; // Stale index
+    }
+
+    index.source = header.source;
+    index.entries.resize(header.entryCount);
+    bool success = true;
+    if(header.entryCount > 0) {
+        success = fread(index.entries.data(), sizeof(SHRTimeIndexEntry),
+            header.entryCount, f) == header.entryCount;
+    }
+    fclose(f);
+
+    if(!success) {
+        index = SHRTimeIndex();
+    }
+
+    return success;
+}
+
+bool SHROpenTimeIndex(const std::string &fileName, SHRTimeIndex &index, bool saveSideCar)
+{
+    std::string indexFileName = SHRTimeIndexFileName(fileName);
+    if(SHRLoadTimeIndex(indexFileName, fileName, index)) {
+        return true;
+    }
+
+    if(!SHRBuildTimeIndex(fileName, index)) {
+        return false;
+    }
+
+    if(saveSideCar) {
+        SHRSaveTimeIndex(indexFileName, index);
+    }
+
+    return true;
+}
+
+bool SHRFindSweepsInRange(const SHRTimeIndex &index, uint64_t t0, uint64_t t1,
+                          int &first, int &count)
+{
+    first = 0;
+    count = 0;
+    if(t1 < t0) { return false; }
+
+    SHRTimeIndexEntry lo, hi;
+    lo.timestamp = t0;
+    hi.timestamp = t1;
+
+    auto begin = std::lower_bound(index.entries.begin(), index.entries.end(), lo, SHRCompareEntries);
+    auto end = std::upper_bound(begin, index.entries.end(), hi, SHRCompareEntries);
+
+    first = (int)(begin - index.entries.begin());
+    count = (int)(end - begin);
+
+    return count > 0;
+}
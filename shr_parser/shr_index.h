@@ -0,0 +1,89 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates how to build a timestamp index for an SHR file so that
+//   the sweeps recorded within a time range can be found without reading the
+//   whole file.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "shr_parse.h"
+
+// Identifies the state of the SHR file a side-car file (.shri, .shrg, .shrp) was
+//   built from. The size alone misses a file rewritten to the same length, so the
+//   modification time, header and the first and last covered sweeps are kept too.
+// Stored as is in the side-car files.
+#pragma pack(push,1)
+struct SHRSideCarSource {
+    uint64_t fileSize;
+    uint64_t modTime; // SHRGetFileModTime
+    uint64_t dataOffset;
+    uint32_t sweepLength;
+    uint32_t sweepCount; // From the file header, 0 while the file is being recorded
+    uint32_t coveredSweeps; // Sweeps the side-car was built from, starting at sweep 0
+    uint32_t reserved;
+    uint64_t firstTimestamp; // Sweep 0, 0 if no sweeps are covered
+    uint64_t lastTimestamp; // Sweep coveredSweeps - 1
+};
+#pragma pack(pop)
+
+// Reads the source of a side-car covering the first coveredSweeps sweeps of the
+//   SHR file. Fails if the file cannot be read or has fewer complete sweeps.
+bool SHRGetSideCarSource(const std::string &fileName, uint32_t coveredSweeps,
+                         SHRSideCarSource &source);
+// Returns true if the SHR file still matches source, false if the side-car
+//   built from it is stale.
+bool SHRCheckSideCarSource(const std::string &fileName, const SHRSideCarSource &source);
+
+// The index is sorted by timestamp. Spike records sweeps in time order, in which
+//   case entry n is sweep n, but sweeps recorded out of order (for example after
+//   a system clock adjustment) are handled as well.
+#pragma pack(push,1)
+struct SHRTimeIndexEntry {
+    uint64_t timestamp; // milliseconds since epoch, see SHRSweepHeader
+    uint32_t sweep; // sweep index in the SHR file
+};
+#pragma pack(pop)
+
+struct SHRTimeIndex {
+    SHRTimeIndex() { memset(&source, 0, sizeof(source)); }
+
+    // Used to verify a side-car index still matches the SHR file
+    SHRSideCarSource source;
+
+    std::vector<SHRTimeIndexEntry> entries;
+};
+
+// Returns the name of the side-car index file for an SHR file, which is the SHR
+//   file name with ".shri" appended.
+std::string SHRTimeIndexFileName(const std::string &fileName);
+
+// Returns the byte offset of sweep n's SHRSweepHeader in the SHR file. The sweep
+//   data immediately follows the header. Sweeps are a fixed size so the offset
+//   is not stored in the index.
+uint64_t SHRSweepOffset(const SHRFileHeader &header, int n);
+
+// Builds the index by reading the header of every sweep in the file.
+bool SHRBuildTimeIndex(const std::string &fileName, SHRTimeIndex &index);
+// Writes/reads the index to/from a side-car file.
+// SHRLoadTimeIndex fails if the side-car does not match the SHR file, for example
+//   if the SHR file was modified after the index was written.
+bool SHRSaveTimeIndex(const std::string &indexFileName, const SHRTimeIndex &index);
+bool SHRLoadTimeIndex(const std::string &indexFileName, const std::string &fileName,
+                      SHRTimeIndex &index);
+
+// Loads the side-car index for the SHR file if one exists and is valid, otherwise
+//   builds the index from the SHR file and, if saveSideCar is true, writes the
+//   side-car for next time. Failing to write the side-car is not an error.
+bool SHROpenTimeIndex(const std::string &fileName, SHRTimeIndex &index, bool saveSideCar = true);
+
+// Finds the sweeps with t0 <= timestamp <= t1 in O(log n).
+// On return index.entries[first] through index.entries[first + count - 1] are
+//   the matching sweeps in time order.
+// Returns true if at least one sweep is in range.
+bool SHRFindSweepsInRange(const SHRTimeIndex &index, uint64_t t0, uint64_t t1,
+                          int &first, int &count);
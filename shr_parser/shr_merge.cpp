@@ -0,0 +1,352 @@
+#include "shr_merge.h"
+#include "shr_writer.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#pragma warning(disable:4996)
+
+// One file being merged. A reader thread fills buffers of whole sweeps ahead of
+//   the merge, the merge walks the sweeps of the front buffer and hands it back
+//   when done.
+struct SHRMergeInput {
+    struct Buffer {
+        std::vector<uint8_t> data;
+        uint32_t sweeps; // Sweeps held
+    };
+
+    SHRMergeInput() : f(nullptr), current(nullptr), pos(0), done(false), stop(false), error(false) {}
+
+    void ReaderThread();
+    // Returns the next filled buffer, null at the end of the file or on error
+    Buffer *AcquireFull();
+    void ReleaseFree(Buffer *b);
+    void Stop();
+
+    FILE *f;
+    SHRFileHeader header;
+    uint32_t sweepCount; // Complete sweeps in the file
+    size_t sweepSizeInBytes;
+    uint32_t sweepsPerBuffer;
+
+    std::vector<Buffer> buffers;
+    std::deque<Buffer*> freeBuffers;
+    std::deque<Buffer*> fullBuffers;
+    Buffer *current; // Owned by the merge
+    uint32_t pos; // Sweep of current being returned
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable freeCond; // Signaled when a buffer is freed or on stop
+    std::condition_variable fullCond; // Signaled when a buffer is filled or the reader is done
+    bool done; // Reader has read the whole file or failed
+    bool stop;
+    bool error;
+};
+
+void SHRMergeInput::ReaderThread()
+{
+    uint32_t remaining = sweepCount;
+    bool success = SHRFileSeek(f, header.dataOffset);
+
+    while(success && remaining > 0) {
+        Buffer *b;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            freeCond.wait(lock, [this] { return !freeBuffers.empty() || stop; });
+            if(stop) {
+                break;
+            }
+            b = freeBuffers.front();
+            freeBuffers.pop_front();
+        }
+
+        // Sweeps are contiguous in the file, one read for the whole buffer
+        uint32_t sweeps = (remaining < sweepsPerBuffer) ? remaining : sweepsPerBuffer;
+        size_t bytes = sweeps * sweepSizeInBytes;
+        success = fread(b->data.data(), 1, bytes, f) == bytes;
+        b->sweeps = success ? sweeps : 0;
+        remaining -= sweeps;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(success) {
+                fullBuffers.push_back(b);
+            } else {
+                freeBuffers.push_back(b);
+            }
+        }
+        fullCond.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = !success;
+        done = true;
+    }
+    fullCond.notify_one();
+}
+
+SHRMergeInput::Buffer *SHRMergeInput::AcquireFull()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    // Only blocks when the merge is ahead of the disk
+    fullCond.wait(lock, [this] { return !fullBuffers.empty() || done; });
+    if(fullBuffers.empty()) {
+        return nullptr;
+    }
+
+    Buffer *b = fullBuffers.front();
+    fullBuffers.pop_front();
+
+    return b;
+}
+
+void SHRMergeInput::ReleaseFree(Buffer *b)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(b);
+    }
+    freeCond.notify_one();
+}
+
+void SHRMergeInput::Stop()
+{
+    if(thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        freeCond.notify_one();
+        thread.join();
+    }
+
+    if(f) {
+        fclose(f);
+        f = nullptr;
+    }
+}
+
+SHRMergeReader::SHRMergeReader() :
+    lastInput(-1),
+    failed(false)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+SHRMergeReader::~SHRMergeReader()
+{
+    Close();
+}
+
+bool SHRMergeReader::Open(const std::vector<std::string> &fileNames,
+                          int bufferCount,
+                          int bufferSizeBytes)
+{
+    if(!inputs.empty()) { return false; } // Already open
+    if(fileNames.empty()) { return false; }
+
+    if(bufferCount < 2) {
+        bufferCount = 2;
+    }
+
+    uint64_t totalSweeps = 0;
+    for(const std::string &fileName : fileNames) {
+        SHRParseState state;
+        if(!SHROpenFile(fileName, state)) {
+            Close();
+            return false;
+        }
+
+        const SHRFileHeader &h = state.header;
+        if(!inputs.empty()) {
+            const SHRFileHeader &first = inputs[0]->header;
+            if(h.sweepLength != first.sweepLength
+                || h.firstBinFreqHz != first.firstBinFreqHz
+                || h.binSizeHz != first.binSizeHz
+                || h.refScale != first.refScale)
+            {
+                SHRCloseFile(state);
+                Close();
+                return false; // Different bin grid or units
+            }
+        }
+
+        std::unique_ptr<SHRMergeInput> input(new SHRMergeInput);
+        input->header = h;
+        SHRCloseFile(state);
+
+        // All reads are large and issued into our own buffers, skip the stdio
+        //   buffer. setvbuf must come before any I/O on the stream, so the file
+        //   is opened again for the bulk reads.
+        input->f = fopen(fileName.c_str(), "rb");
+        if(!input->f) {
+            Close();
+            return false;
+        }
+        if(setvbuf(input->f, nullptr, _IONBF, 0) != 0) {
+            fclose(input->f);
+            input->f = nullptr;
+            Close();
+            return false;
+        }
+
+        input->sweepSizeInBytes = sizeof(SHRSweepHeader) + sizeof(float) * (size_t)h.sweepLength;
+
+        // Only count complete sweeps
+        input->sweepCount = h.sweepCount;
+        uint64_t fileSize = SHRGetFileSize(fileName);
+        if(fileSize >= h.dataOffset) {
+            uint64_t sweepsInFile = (fileSize - h.dataOffset) / input->sweepSizeInBytes;
+            if(sweepsInFile < input->sweepCount) {
+                input->sweepCount = (uint32_t)sweepsInFile;
+            }
+        }
+        totalSweeps += input->sweepCount;
+
+        input->sweepsPerBuffer = (uint32_t)(bufferSizeBytes / input->sweepSizeInBytes);
+        if(input->sweepsPerBuffer < 1) {
+            input->sweepsPerBuffer = 1;
+        }
+        input->buffers.resize(bufferCount);
+        for(SHRMergeInput::Buffer &b : input->buffers) {
+            b.data.resize(input->sweepsPerBuffer * input->sweepSizeInBytes);
+            b.sweeps = 0;
+            input->freeBuffers.push_back(&b);
+        }
+
+        inputs.push_back(std::move(input));
+    }
+
+    header = inputs[0]->header;
+    header.sweepCount = (totalSweeps > UINT32_MAX) ? UINT32_MAX : (uint32_t)totalSweeps;
+
+    // Start reading every file, then prime the heap with the first sweep of each
+    for(auto &input : inputs) {
+        input->thread = std::thread(&SHRMergeInput::ReaderThread, input.get());
+    }
+
+    failed = false;
+    lastInput = -1;
+    for(int i = 0; i < (int)inputs.size(); i++) {
+        if(!Advance(i)) {
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SHRMergeReader::Close()
+{
+    for(auto &input : inputs) {
+        input->Stop();
+    }
+    inputs.clear();
+    heap = std::priority_queue<HeapEntry>();
+    lastInput = -1;
+}
+
+bool SHRMergeReader::Advance(int i)
+{
+    SHRMergeInput &input = *inputs[i];
+
+    if(input.current) {
+        input.pos++;
+        if(input.pos >= input.current->sweeps) {
+            input.ReleaseFree(input.current);
+            input.current = nullptr;
+        }
+    }
+
+    if(!input.current) {
+        input.current = input.AcquireFull();
+        input.pos = 0;
+        if(!input.current) {
+            // End of this file
+            if(input.error) {
+                failed = true;
+                return false;
+            }
+            return true;
+        }
+    }
+
+    const SHRSweepHeader *sweepInfo = (const SHRSweepHeader*)
+        (input.current->data.data() + input.pos * input.sweepSizeInBytes);
+
+    HeapEntry entry;
+    entry.timestamp = sweepInfo->timestamp;
+    entry.input = i;
+    heap.push(entry);
+
+    return true;
+}
+
+bool SHRMergeReader::Next(const SHRSweepHeader *&sweepInfo, const float *&sweep, int *source)
+{
+    if(inputs.empty() || failed) { return false; }
+
+    // The sweep returned last time is no longer needed, move that file forward
+    if(lastInput >= 0) {
+        int i = lastInput;
+        lastInput = -1;
+        if(!Advance(i)) {
+            return false;
+        }
+    }
+
+    if(heap.empty()) {
+        return false; // Every file is done
+    }
+
+    int i = heap.top().input;
+    heap.pop();
+
+    const SHRMergeInput &input = *inputs[i];
+    const uint8_t *p = input.current->data.data() + input.pos * input.sweepSizeInBytes;
+    sweepInfo = (const SHRSweepHeader*)p;
+    sweep = (const float*)(p + sizeof(SHRSweepHeader));
+    if(source) {
+        *source = i;
+    }
+
+    lastInput = i;
+
+    return true;
+}
+
+bool SHRMergeFiles(const std::vector<std::string> &fileNames, const std::string &outFileName)
+{
+    SHRMergeReader merge;
+    if(!merge.Open(fileNames)) {
+        return false;
+    }
+
+    SHRWriter writer;
+    if(!writer.Open(outFileName, merge.Header())) {
+        return false;
+    }
+
+    const SHRSweepHeader *sweepInfo;
+    const float *sweep;
+    bool success = true;
+    while(success && merge.Next(sweepInfo, sweep)) {
+        success = writer.Write(sweep, *sweepInfo);
+    }
+    success = success && !merge.Failed();
+
+    success = writer.Close() && success;
+    merge.Close();
+
+    if(!success) {
+        remove(outFileName.c_str());
+    }
+
+    return success;
+}
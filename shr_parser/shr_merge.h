@@ -0,0 +1,88 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates merging several SHR files, for example hourly files or
+//   files from several receivers recording side by side, into a single stream
+//   of sweeps ordered by timestamp.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "shr_parse.h"
+
+struct SHRMergeInput;
+
+// Reads several SHR files as one stream ordered by SHRSweepHeader::timestamp.
+// Each file must be in time order, as recorded by Spike/SHRWriter. The files
+//   must have the same sweepLength, firstBinFreqHz, binSizeHz and refScale.
+// Sweeps with equal timestamps are returned in the order the files were given.
+//
+// Every file has a background thread which reads ahead of the merge in large
+//   sequential reads, so the merge reads each file at disk bandwidth instead of
+//   seeking between files for every sweep.
+//
+// Example:
+//   SHRMergeReader merge;
+//   merge.Open({ "site_0000.shr", "site_0100.shr", "site_0200.shr" });
+//   const SHRSweepHeader *sweepInfo;
+//   const float *sweep;
+//   while(merge.Next(sweepInfo, sweep)) {
+//       ...
+//   }
+//   merge.Close();
+class SHRMergeReader {
+public:
+    SHRMergeReader();
+    ~SHRMergeReader(); // Closes the files if open
+
+    // fileNames = files to merge
+    // bufferCount = read ahead buffers per file, at least 2
+    // bufferSizeBytes = target size of each buffer, rounded up to hold at least
+    //   one sweep
+    // Returns false if any file cannot be opened or the files are not compatible.
+    bool Open(const std::vector<std::string> &fileNames,
+              int bufferCount = 2,
+              int bufferSizeBytes = 4 << 20);
+    void Close();
+
+    // Returns the next sweep in time order.
+    // sweepInfo/sweep = valid until the next call to Next or Close
+    // source = optional, set to the index of the file the sweep came from
+    // Returns false when every sweep has been returned or a read failed.
+    bool Next(const SHRSweepHeader *&sweepInfo, const float *&sweep, int *source = nullptr);
+
+    // Header of the first file, sweepCount is the total number of sweeps in all files
+    const SHRFileHeader &Header() const { return header; }
+    // True if a read failed, Next returns false after a failure
+    bool Failed() const { return failed; }
+
+private:
+    struct HeapEntry {
+        uint64_t timestamp;
+        int input;
+        // Orders the priority queue as a min heap, earlier files first on ties
+        bool operator<(const HeapEntry &other) const {
+            if(timestamp != other.timestamp) {
+                return timestamp > other.timestamp;
+            }
+            return input > other.input;
+        }
+    };
+
+    // Moves an input to its next sweep and adds it back to the heap if it has one
+    bool Advance(int input);
+
+    std::vector<std::unique_ptr<SHRMergeInput>> inputs;
+    std::priority_queue<HeapEntry> heap;
+    int lastInput; // Input of the sweep returned by the previous call to Next
+    SHRFileHeader header;
+    bool failed;
+};
+
+// Merges several SHR files into one SHR file ordered by timestamp.
+// The output header is the header of the first file.
+bool SHRMergeFiles(const std::vector<std::string> &fileNames, const std::string &outFileName);
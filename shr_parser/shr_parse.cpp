@@ -1,5 +1,19 @@
 #include "shr_parse.h"
 
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
 #pragma warning(disable:4996)
 
 bool SHROpenFile(const std::string &fileName, SHRParseState &state)
@@ -33,6 +47,45 @@ void SHRCloseFile(SHRParseState &state)
     }
 }
 
+uint64_t SHRGetFileSize(const std::string &fileName)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if(_stat64(fileName.c_str(), &st) != 0) { return 0; }
+#else
+    struct stat st;
+    if(stat(fileName.c_str(), &st) != 0) { return 0; }
+#endif
+
+    return st.st_size;
+}
+
+uint64_t SHRGetFileModTime(const std::string &fileName)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if(_stat64(fileName.c_str(), &st) != 0) { return 0; }
+    return (uint64_t)st.st_mtime;
+#else
+    struct stat st;
+    if(stat(fileName.c_str(), &st) != 0) { return 0; }
+#ifdef __APPLE__
+    return (uint64_t)st.st_mtimespec.tv_sec * 1000000000ull + st.st_mtimespec.tv_nsec;
+#else
+    return (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+#endif
+#endif
+}
+
+bool SHRFileSeek(FILE *f, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, (int64_t)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
 bool SHRGetSweep(SHRParseState &state, int n, float *sweep, SHRSweepHeader &sweepInfo)
 {
     if(!state.f) { return false; } // Invalid file handle
@@ -43,10 +96,266 @@ bool SHRGetSweep(SHRParseState &state, int n, float *sweep, SHRSweepHeader &swee
     // Move to beginning of sweep
     // Currently the state.header.dataOffset is the same size as the file header itself.
     // This may not always be the case. Use the data offset.
-    fseek(state.f, state.header.dataOffset + sweepSizeInBytes * n, SEEK_SET);
+    SHRFileSeek(state.f, state.header.dataOffset + (uint64_t)sweepSizeInBytes * n);
 
     size_t headerBytesRead = fread(&sweepInfo, 1, sizeof(SHRSweepHeader), state.f);
     size_t sweepBytesRead = fread(sweep, 1, sizeof(float) * state.header.sweepLength, state.f);
 
-    return (headerBytesRead == sizeof(SHRSweepHeader)) && (sweepBytesRead == sweepSizeInBytes);
-}
\ No newline at end of file
+    return (headerBytesRead == sizeof(SHRSweepHeader)) 
+        && (sweepBytesRead == sizeof(float) * state.header.sweepLength);
+}
+
+bool SHRGetSweeps(SHRParseState &state, int first, int count,
+                  float *sweeps, SHRSweepHeader *sweepInfo, bool readAhead)
+{
+    if(!state.f) { return false; } // Invalid file handle
+    if(first < 0 || count <= 0) { return false; }
+
+    const size_t sweepBytes = sizeof(float) * state.header.sweepLength;
+    const uint64_t sweepSizeInBytes = sweepBytes + sizeof(SHRSweepHeader);
+    const uint64_t offset = state.header.dataOffset + sweepSizeInBytes * first;
+
+#ifdef _WIN32
+    // No scatter read, read the run into one buffer and split it
+    std::vector<uint8_t> buf((size_t)(sweepSizeInBytes * count));
+    if(!SHRFileSeek(state.f, offset) || fread(buf.data(), 1, buf.size(), state.f) != buf.size()) {
+        return false;
+    }
+    for(int i = 0; i < count; i++) {
+        const uint8_t *src = buf.data() + sweepSizeInBytes * i;
+        memcpy(&sweepInfo[i], src, sizeof(SHRSweepHeader));
+        memcpy(sweeps + (size_t)i * state.header.sweepLength, src + sizeof(SHRSweepHeader), sweepBytes);
+    }
+    (void)readAhead;
+#else
+    const int fd = fileno(state.f);
+
+    if(readAhead) {
+        posix_fadvise(fd, (off_t)(offset + sweepSizeInBytes * count),
+            (off_t)(sweepSizeInBytes * count), POSIX_FADV_WILLNEED);
+    }
+
+    // Two iovecs per sweep, header then data
+#ifdef IOV_MAX
+    const int maxSweepsPerRead = IOV_MAX / 2;
+#else
+    const int maxSweepsPerRead = 512;
+#endif
+    std::vector<struct iovec> iov(2 * (size_t)((count < maxSweepsPerRead) ? count : maxSweepsPerRead));
+
+    uint64_t pos = offset;
+    for(int done = 0; done < count; ) {
+        int batch = (count - done < maxSweepsPerRead) ? count - done : maxSweepsPerRead;
+        for(int i = 0; i < batch; i++) {
+            iov[2 * i].iov_base = &sweepInfo[done + i];
+            iov[2 * i].iov_len = sizeof(SHRSweepHeader);
+            iov[2 * i + 1].iov_base = sweeps + (size_t)(done + i) * state.header.sweepLength;
+            iov[2 * i + 1].iov_len = sweepBytes;
+        }
+
+        // preadv may return less than requested, continue from where it stopped
+        struct iovec *v = iov.data();
+        int vcount = 2 * batch;
+        while(vcount > 0) {
+            ssize_t bytesRead = preadv(fd, v, vcount, (off_t)pos);
+            if(bytesRead <= 0) {
+                return false; // Error or end of file
+            }
+            pos += bytesRead;
+
+            while(vcount > 0 && (size_t)bytesRead >= v->iov_len) {
+                bytesRead -= v->iov_len;
+                v++;
+                vcount--;
+            }
+            if(vcount > 0) {
+                v->iov_base = (uint8_t*)v->iov_base + bytesRead;
+                v->iov_len -= bytesRead;
+            }
+        }
+
+        done += batch;
+    }
+#endif
+
+    return true;
+}
+
+// Validates the header at the start of the mapping and determines the number of
+//   complete sweeps in the file.
+static bool SHRValidateMapping(SHRMappedFile &file)
+{
+    if(file.size < sizeof(SHRFileHeader)) { return false; } // Couldn't read header
+
+    file.header = (const SHRFileHeader*)file.base;
+    if(file.header->signature != SHRFileSignature 
+        || file.header->version > SHRFileVersion
+        || file.header->dataOffset > file.size)
+    {
+        return false; // Invalid file
+    }
+
+    uint64_t sweepSizeInBytes = sizeof(float) * (uint64_t)file.header->sweepLength
+        + sizeof(SHRSweepHeader);
+    uint64_t sweepsInFile = (file.size - file.header->dataOffset) / sweepSizeInBytes;
+
+    file.sweepCount = file.header->sweepCount;
+    if(sweepsInFile < file.sweepCount) {
+        file.sweepCount = (uint32_t)sweepsInFile;
+    }
+
+    return true;
+}
+
+bool SHROpenMappedFile(const std::string &fileName, SHRMappedFile &file)
+{
+    if(file.base) { return false; } // Already open
+
+#ifdef _WIN32
+    HANDLE h = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(h == INVALID_HANDLE_VALUE) { return false; } // Unable to open file
+    file.fileHandle = h;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(h, &fileSize) || fileSize.QuadPart == 0
+        || (uint64_t)fileSize.QuadPart > SIZE_MAX)
+    {
+        SHRCloseMappedFile(file);
+        return false;
+    }
+
+    file.mapHandle = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!file.mapHandle) {
+        SHRCloseMappedFile(file);
+        return false;
+    }
+
+    file.base = (const uint8_t*)MapViewOfFile(file.mapHandle, FILE_MAP_READ, 0, 0, 0);
+    if(!file.base) {
+        SHRCloseMappedFile(file);
+        return false;
+    }
+    file.size = fileSize.QuadPart;
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0) { return false; } // Unable to open file
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping holds its own reference to the file
+    close(fd);
+    if(addr == MAP_FAILED) { return false; } // Unable to map, e.g. out of address space
+
+    // Files are typically scanned front to back
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    file.base = (const uint8_t*)addr;
+    file.size = st.st_size;
+#endif
+
+    if(!SHRValidateMapping(file)) {
+        SHRCloseMappedFile(file);
+        return false;
+    }
+
+    file.fileName = fileName;
+
+    return true;
+}
+
+void SHRCloseMappedFile(SHRMappedFile &file)
+{
+#ifdef _WIN32
+    if(file.base) {
+        UnmapViewOfFile(file.base);
+    }
+    if(file.mapHandle) {
+        CloseHandle(file.mapHandle);
+    }
+    if(file.fileHandle) {
+        CloseHandle(file.fileHandle);
+    }
+#else
+    if(file.base) {
+        munmap((void*)file.base, file.size);
+    }
+#endif
+
+    file = SHRMappedFile();
+}
+
+bool SHRGetMappedSweep(const SHRMappedFile &file, int n,
+                       const SHRSweepHeader *&sweepInfo, const float *&sweep)
+{
+    if(!file.base) { return false; } // Not mapped
+    if(n < 0 || (uint32_t)n >= file.sweepCount) { return false; }
+
+    uint64_t sweepSizeInBytes = sizeof(float) * (uint64_t)file.header->sweepLength 
+        + sizeof(SHRSweepHeader);
+
+    const uint8_t *p = file.base + file.header->dataOffset + sweepSizeInBytes * n;
+    sweepInfo = (const SHRSweepHeader*)p;
+    sweep = (const float*)(p + sizeof(SHRSweepHeader));
+
+    return true;
+}
+
+bool SHROpenReader(const std::string &fileName, SHRReader &reader)
+{
+    if(SHROpenMappedFile(fileName, reader.mapped)) {
+        reader.state.header = *reader.mapped.header;
+        reader.state.header.sweepCount = reader.mapped.sweepCount;
+        reader.state.fileName = fileName;
+        return true;
+    }
+
+    if(!SHROpenFile(fileName, reader.state)) {
+        return false;
+    }
+
+    // Only count complete sweeps
+    uint64_t fileSize = SHRGetFileSize(fileName);
+    uint64_t sweepSizeInBytes = sizeof(float) * (uint64_t)reader.state.header.sweepLength
+        + sizeof(SHRSweepHeader);
+    if(fileSize >= reader.state.header.dataOffset) {
+        uint64_t sweepsInFile = (fileSize - reader.state.header.dataOffset) / sweepSizeInBytes;
+        if(sweepsInFile < reader.state.header.sweepCount) {
+            reader.state.header.sweepCount = (uint32_t)sweepsInFile;
+        }
+    }
+
+    reader.state.fileName = fileName;
+    reader.sweepBuf.resize(reader.state.header.sweepLength);
+
+    return true;
+}
+
+void SHRCloseReader(SHRReader &reader)
+{
+    SHRCloseMappedFile(reader.mapped);
+    SHRCloseFile(reader.state);
+    reader.sweepBuf.clear();
+}
+
+bool SHRReadSweep(SHRReader &reader, int n, const SHRSweepHeader *&sweepInfo, const float *&sweep)
+{
+    if(reader.mapped.base) {
+        return SHRGetMappedSweep(reader.mapped, n, sweepInfo, sweep);
+    }
+
+    if(n < 0 || (uint32_t)n >= reader.state.header.sweepCount) { return false; }
+    if(!SHRGetSweep(reader.state, n, reader.sweepBuf.data(), reader.sweepInfoBuf)) {
+        return false;
+    }
+
+    sweepInfo = &reader.sweepInfoBuf;
+    sweep = reader.sweepBuf.data();
+
+    return true;
+}
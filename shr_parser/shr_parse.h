@@ -10,7 +10,9 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 // The basic format of the SHR file is shown below
 //
@@ -160,9 +162,95 @@ bool SHROpenFile(const std::string &fileName, SHRParseState &state);
 // state = valid parser state struct
 void SHRCloseFile(SHRParseState &state);
 
+// Returns the size of a file in bytes, 0 if the file cannot be found
+uint64_t SHRGetFileSize(const std::string &fileName);
+// Returns the last modification time of a file, 0 if the file cannot be found.
+// Only meaningful compared to another value from this function, the resolution
+//   depends on the platform.
+uint64_t SHRGetFileModTime(const std::string &fileName);
+// 64-bit fseek(f, offset, SEEK_SET), returns true if success
+bool SHRFileSeek(FILE *f, uint64_t offset);
+
 // state = valid parser state struct
 // n = the sweep you want to retrieve from [0, state.header.sweepCount-1]
 // sweep = preallocated array of floats, will store the sweep if function returns 
 //   successfully. Should be state.header.sweepLength number of floats in size
 // sweepInfo = timestamp and position of sweep if successful
-bool SHRGetSweep(SHRParseState &state, int n, float *sweep, SHRSweepHeader &sweepInfo);
\ No newline at end of file
+bool SHRGetSweep(SHRParseState &state, int n, float *sweep, SHRSweepHeader &sweepInfo);
+
+// Reads a run of consecutive sweeps. The sweeps are stored back to back in the
+//   file, so the whole run is read with one positional read (preadv, in batches
+//   of IOV_MAX/2 sweeps) which scatters the sweep headers and sweep data
+//   directly into the caller's arrays.
+// state = valid parser state struct
+// first/count = sweeps [first, first+count) to retrieve
+// sweeps = preallocated array of count * state.header.sweepLength floats, sweep
+//   i of the run is stored at sweeps + i * state.header.sweepLength
+// sweepInfo = preallocated array of count headers
+// readAhead = hint the OS to start reading the next count sweeps, so a scan which
+//   calls this for successive runs overlaps the disk reads with processing
+bool SHRGetSweeps(SHRParseState &state, int first, int count,
+                  float *sweeps, SHRSweepHeader *sweepInfo, bool readAhead = false);
+
+// These functions and data types are an alternative to the functions above which
+//   map the entire file into memory rather than reading it with fread.
+// Sweeps are returned as read-only pointers into the mapping, no data is copied
+//   and no system calls are made per sweep. This is the preferred approach for
+//   scanning large files.
+// If the file cannot be mapped (for example a very large file in a 32-bit process)
+//   SHROpenMappedFile returns false and the fopen based functions above should be
+//   used instead.
+
+struct SHRMappedFile {
+    SHRMappedFile() : base(nullptr), size(0), header(nullptr), sweepCount(0),
+        fileHandle(nullptr), mapHandle(nullptr) {}
+
+    const uint8_t *base; // Start of the mapping, i.e. the first byte of the file
+    uint64_t size; // Size of the mapping in bytes
+    const SHRFileHeader *header; // Points into the mapping
+    // Number of complete sweeps in the file. This is header->sweepCount unless the
+    //   file is truncated, in which case only the complete sweeps are counted.
+    uint32_t sweepCount;
+    std::string fileName;
+
+    // OS specific handles
+    void *fileHandle;
+    void *mapHandle;
+};
+
+// Map an SHR file, return true if success
+// If success, file will contain a valid mapping which can be used for the
+//   SHRGetMappedSweep function.
+bool SHROpenMappedFile(const std::string &fileName, SHRMappedFile &file);
+// file = valid mapped file struct
+void SHRCloseMappedFile(SHRMappedFile &file);
+
+// file = valid mapped file struct
+// n = the sweep you want to retrieve from [0, file.sweepCount-1]
+// sweepInfo = set to the timestamp and position of the sweep if successful
+// sweep = set to the first of file.header->sweepLength floats if successful
+// The pointers remain valid until SHRCloseMappedFile is called.
+bool SHRGetMappedSweep(const SHRMappedFile &file, int n,
+                       const SHRSweepHeader *&sweepInfo, const float *&sweep);
+
+// Convenience for reading sweeps sequentially, or in any order, using the
+//   memory mapped functions when possible and the fopen based functions otherwise.
+
+struct SHRReader {
+    SHRMappedFile mapped;
+    SHRParseState state; // state.header is valid for both methods
+
+    // Used when the file is not mapped
+    std::vector<float> sweepBuf;
+    SHRSweepHeader sweepInfoBuf;
+};
+
+// Open an SHR file, return true if success
+// On success reader.state.header.sweepCount is the number of complete sweeps
+bool SHROpenReader(const std::string &fileName, SHRReader &reader);
+void SHRCloseReader(SHRReader &reader);
+
+// n = the sweep you want to retrieve from [0, reader.state.header.sweepCount-1]
+// sweepInfo/sweep = set to the sweep header and sweep data if successful, valid
+//   until the next call to SHRReadSweep or SHRCloseReader
+bool SHRReadSweep(SHRReader &reader, int n, const SHRSweepHeader *&sweepInfo, const float *&sweep);
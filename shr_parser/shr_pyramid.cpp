@@ -0,0 +1,529 @@
+#include "shr_pyramid.h"
+#include "trace_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#pragma warning(disable:4996)
+
+// Levels stop here even if the last level does not fit in one tile
+static const int SHR_PYRAMID_MAX_LEVELS = 30;
+
+namespace {
+
+struct SHRPyramidLevelState {
+    SHRPyramidLevel info;
+    // Up to tileSize rows of the level waiting to be written as a row of tiles
+    std::vector<float> stripe;
+    uint32_t stripeRows;
+    uint32_t rowsDone; // Rows of the level already written
+    std::vector<uint64_t> tileOffsets;
+};
+
+struct SHRPyramidBuilder {
+    FILE *f;
+    uint64_t pos; // Current write offset in the pyramid file
+    bool avg;
+    bool dbm;
+    uint32_t sweepCount;
+    uint32_t sweepLength;
+    uint32_t tileSize;
+    int threadCount;
+    std::vector<SHRPyramidLevelState> levels;
+    std::vector<float> tile;
+};
+
+} // namespace
+
+std::string SHRPyramidFileName(const std::string &fileName, SHRDecimationDetector detector)
+{
+    return fileName + ((detector == SHRDecimationDetectorMax) ? ".max.shrp" : ".avg.shrp");
+}
+
+// Number of source sweeps/bins in element n of a level with the given factor
+static double SHRPyramidWeight(uint32_t n, uint32_t factor, uint32_t total)
+{
+    uint64_t first = (uint64_t)n * factor;
+    return (double)std::min<uint64_t>(factor, total - first);
+}
+
+// Calls fn(first, last) over [0, count) split into threadCount contiguous ranges
+static void SHRParallelFor(int count, int threadCount, const std::function<void(int, int)> &fn)
+{
+    if(threadCount > count) {
+        threadCount = count;
+    }
+    if(threadCount <= 1) {
+        if(count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < threadCount; i++) {
+        threads.push_back(std::thread(fn, (int)((int64_t)count * i / threadCount),
+            (int)((int64_t)count * (i + 1) / threadCount)));
+    }
+    // The calling thread does its share of the work
+    fn(0, (int)(count / threadCount));
+    for(std::thread &t : threads) {
+        t.join();
+    }
+}
+
+// Combines one or two rows of the level below into one row of the next level.
+// r0/r1 = rows of inCols values, r1 may be null at the end of the file
+// w0/w1 = number of sweeps in each row
+// inFactor = decimation of the input rows, 1 for SHR sweeps
+// lin0/lin1 = scratch, inCols floats each
+static void SHRPyramidReduceRow(const SHRPyramidBuilder &b,
+                                const float *r0, const float *r1, double w0, double w1,
+                                uint32_t inCols, uint32_t inFactor,
+                                float *dst, float *lin0, float *lin1)
+{
+    const uint32_t outCols = (inCols + 1) / 2;
+
+    if(!b.avg) {
+        const float *src = r0;
+        if(r1) {
+            memcpy(lin0, r0, sizeof(float) * inCols);
+            traceMaxHold(lin0, r1, inCols);
+            src = lin0;
+        }
+        for(uint32_t c = 0; c < outCols; c++) {
+            uint32_t i = 2 * c;
+            dst[c] = (i + 1 < inCols) ? std::max(src[i], src[i + 1]) : src[i];
+        }
+        return;
+    }
+
+    // Average in linear power, weighted by the number of sweeps/bins in each input
+    if(b.dbm) {
+        memset(lin0, 0, sizeof(float) * inCols);
+        traceAccumulatePower(lin0, r0, inCols);
+        if(r1) {
+            memset(lin1, 0, sizeof(float) * inCols);
+            traceAccumulatePower(lin1, r1, inCols);
+        }
+    } else {
+        for(uint32_t i = 0; i < inCols; i++) {
+            lin0[i] = r0[i] * r0[i];
+        }
+        if(r1) {
+            for(uint32_t i = 0; i < inCols; i++) {
+                lin1[i] = r1[i] * r1[i];
+            }
+        }
+    }
+
+    const uint32_t inBins = b.sweepLength;
+    for(uint32_t c = 0; c < outCols; c++) {
+        double sum = 0.0, weight = 0.0;
+        for(uint32_t i = 2 * c; i < 2 * c + 2 && i < inCols; i++) {
+            double wc = (inFactor == 1) ? 1.0 : SHRPyramidWeight(i, inFactor, inBins);
+            sum += wc * w0 * lin0[i];
+            weight += wc * w0;
+            if(r1) {
+                sum += wc * w1 * lin1[i];
+                weight += wc * w1;
+            }
+        }
+        // Output column c only reads inputs 2c and above, safe to write in place
+        lin0[c] = (float)(sum / weight);
+    }
+
+    if(b.dbm) {
+        tracePowerAverageToDBm(dst, lin0, 1, outCols);
+    } else {
+        for(uint32_t c = 0; c < outCols; c++) {
+            dst[c] = sqrtf(lin0[c]);
+        }
+    }
+}
+
+// Reduces rows [first, last) of the next level from pairs of source rows
+static void SHRPyramidReduceRows(const SHRPyramidBuilder &b,
+                                 const std::vector<const float*> &rows,
+                                 uint32_t firstRowIndex, uint32_t inCols, uint32_t inFactor,
+                                 float *dst, uint32_t outCols)
+{
+    const int outRows = (int)(rows.size() + 1) / 2;
+    const uint32_t inTotal = b.sweepCount;
+
+    SHRParallelFor(outRows, b.threadCount, [&](int first, int last) {
+        std::vector<float> lin0(inCols), lin1(inCols);
+        for(int r = first; r < last; r++) {
+            size_t i = 2 * (size_t)r;
+            const float *r1 = (i + 1 < rows.size()) ? rows[i + 1] : nullptr;
+            double w0 = SHRPyramidWeight(firstRowIndex + (uint32_t)i, inFactor, inTotal);
+            double w1 = r1 ? SHRPyramidWeight(firstRowIndex + (uint32_t)i + 1, inFactor, inTotal) : 0.0;
+            SHRPyramidReduceRow(b, rows[i], r1, w0, w1, inCols, inFactor,
+                dst + (size_t)r * outCols, lin0.data(), lin1.data());
+        }
+    });
+}
+
+static bool SHRPyramidFlushLevel(SHRPyramidBuilder &b, int k)
+{
+    SHRPyramidLevelState &level = b.levels[k];
+    const uint32_t tileSize = b.tileSize;
+    const uint32_t cols = level.info.cols;
+    const uint32_t tileRow = level.rowsDone / tileSize;
+
+    // Write the stripe out as one row of tiles
+    for(uint32_t tc = 0; tc < level.info.tileCols; tc++) {
+        uint32_t c0 = tc * tileSize;
+        uint32_t width = std::min(tileSize, cols - c0);
+        if(level.stripeRows < tileSize || width < tileSize) {
+            std::fill(b.tile.begin(), b.tile.end(), std::numeric_limits<float>::quiet_NaN());
+        }
+        for(uint32_t r = 0; r < level.stripeRows; r++) {
+            memcpy(&b.tile[(size_t)r * tileSize], &level.stripe[(size_t)r * cols + c0],
+                sizeof(float) * width);
+        }
+
+        if(fwrite(b.tile.data(), sizeof(float), b.tile.size(), b.f) != b.tile.size()) {
+            return false;
+        }
+        level.tileOffsets[(size_t)tileRow * level.info.tileCols + tc] = b.pos;
+        b.pos += sizeof(float) * b.tile.size();
+    }
+
+    // Feed the stripe into the next level
+    bool flushNext = false;
+    if(k + 1 < (int)b.levels.size()) {
+        SHRPyramidLevelState &next = b.levels[k + 1];
+        std::vector<const float*> rows(level.stripeRows);
+        for(uint32_t r = 0; r < level.stripeRows; r++) {
+            rows[r] = &level.stripe[(size_t)r * cols];
+        }
+        SHRPyramidReduceRows(b, rows, level.rowsDone, cols, level.info.factor,
+            &next.stripe[(size_t)next.stripeRows * next.info.cols], next.info.cols);
+        next.stripeRows += (level.stripeRows + 1) / 2;
+        flushNext = next.stripeRows == tileSize
+            || next.rowsDone + next.stripeRows == next.info.rows;
+    }
+
+    level.rowsDone += level.stripeRows;
+    level.stripeRows = 0;
+
+    return flushNext ? SHRPyramidFlushLevel(b, k + 1) : true;
+}
+
+bool SHRBuildPyramid(const std::string &fileName,
+                     const std::string &pyramidFileName,
+                     SHRDecimationDetector detector,
+                     int tileSize,
+                     int threadCount)
+{
+    SHRReader reader;
+    if(!SHROpenReader(fileName, reader)) {
+        return false;
+    }
+
+    const SHRFileHeader &shrHeader = reader.state.header;
+    if(shrHeader.sweepCount == 0 || shrHeader.sweepLength == 0) {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    if(tileSize < 2) {
+        tileSize = 2;
+    }
+    tileSize += tileSize & 1; // Each level stripe must reduce to whole rows
+
+    if(threadCount <= 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if(threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+
+    SHRPyramidBuilder b;
+    b.avg = detector != SHRDecimationDetectorMax;
+    b.dbm = shrHeader.refScale == SHRScaleDBM;
+    b.sweepCount = shrHeader.sweepCount;
+    b.sweepLength = shrHeader.sweepLength;
+    b.tileSize = tileSize;
+    b.threadCount = threadCount;
+    b.tile.resize((size_t)tileSize * tileSize);
+
+    uint32_t factor = 2;
+    for(int k = 0; k < SHR_PYRAMID_MAX_LEVELS; k++, factor *= 2) {
+        SHRPyramidLevelState level;
+        level.info.factor = factor;
+        level.info.rows = (uint32_t)(((uint64_t)b.sweepCount + factor - 1) / factor);
+        level.info.cols = (uint32_t)(((uint64_t)b.sweepLength + factor - 1) / factor);
+        level.info.tileRows = (level.info.rows + tileSize - 1) / tileSize;
+        level.info.tileCols = (level.info.cols + tileSize - 1) / tileSize;
+        level.info.tileTableOffset = 0;
+        level.stripe.resize((size_t)tileSize * level.info.cols);
+        level.stripeRows = 0;
+        level.rowsDone = 0;
+        level.tileOffsets.resize((size_t)level.info.tileRows * level.info.tileCols);
+        b.levels.push_back(level);
+
+        if(level.info.tileRows == 1 && level.info.tileCols == 1) {
+            break;
+        }
+    }
+
+    b.f = fopen(pyramidFileName.c_str(), "wb");
+    if(!b.f) {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    SHRPyramidHeader header;
+    memset(&header, 0, sizeof(header));
+    header.signature = SHRPyramidSignature;
+    header.version = SHRPyramidVersion;
+    header.shrHeader = shrHeader;
+    if(!SHRGetSideCarSource(fileName, shrHeader.sweepCount, header.source)) {
+        fclose(b.f);
+        remove(pyramidFileName.c_str());
+        SHRCloseReader(reader);
+        return false;
+    }
+    header.detector = b.avg ? SHRDecimationDetectorAvg : SHRDecimationDetectorMax;
+    header.tileSize = tileSize;
+    header.levelCount = (uint32_t)b.levels.size();
+
+    // Header is rewritten at the end, written now to reserve the space
+    bool success = fwrite(&header, sizeof(header), 1, b.f) == 1;
+    b.pos = sizeof(header);
+
+    // Each block of 2*tileSize sweeps becomes one stripe of level 0
+    const uint32_t sweepsPerBlock = 2 * tileSize;
+    std::vector<const float*> sweeps;
+    std::vector<float> sweepBuf;
+    if(!reader.mapped.base) {
+        sweepBuf.resize((size_t)sweepsPerBlock * b.sweepLength);
+    }
+
+    SHRPyramidLevelState &level0 = b.levels[0];
+    for(uint32_t first = 0; first < b.sweepCount && success; first += sweepsPerBlock) {
+        uint32_t count = std::min(sweepsPerBlock, b.sweepCount - first);
+
+        // Mapped sweeps are used in place
+        sweeps.resize(count);
+        for(uint32_t i = 0; i < count; i++) {
+            const SHRSweepHeader *sweepInfo;
+            const float *sweep;
+            if(!SHRReadSweep(reader, first + i, sweepInfo, sweep)) {
+                success = false;
+                break;
+            }
+            if(reader.mapped.base) {
+                sweeps[i] = sweep;
+            } else {
+                float *dst = &sweepBuf[(size_t)i * b.sweepLength];
+                memcpy(dst, sweep, sizeof(float) * b.sweepLength);
+                sweeps[i] = dst;
+            }
+        }
+        if(!success) {
+            break;
+        }
+
+        SHRPyramidReduceRows(b, sweeps, first, b.sweepLength, 1, level0.stripe.data(), level0.info.cols);
+        level0.stripeRows = (count + 1) / 2;
+        success = SHRPyramidFlushLevel(b, 0);
+    }
+
+    // Tile tables and level descriptions
+    for(size_t k = 0; k < b.levels.size() && success; k++) {
+        SHRPyramidLevelState &level = b.levels[k];
+        level.info.tileTableOffset = b.pos;
+        success = fwrite(level.tileOffsets.data(), sizeof(uint64_t),
+            level.tileOffsets.size(), b.f) == level.tileOffsets.size();
+        b.pos += sizeof(uint64_t) * level.tileOffsets.size();
+    }
+
+    header.levelOffset = b.pos;
+    for(size_t k = 0; k < b.levels.size() && success; k++) {
+        success = fwrite(&b.levels[k].info, sizeof(SHRPyramidLevel), 1, b.f) == 1;
+    }
+
+    if(success) {
+        success = SHRFileSeek(b.f, 0) && fwrite(&header, sizeof(header), 1, b.f) == 1;
+    }
+
+    success = (fclose(b.f) == 0) && success;
+    SHRCloseReader(reader);
+
+    if(!success) {
+        remove(pyramidFileName.c_str());
+    }
+
+    return success;
+}
+
+bool SHROpenPyramidFile(const std::string &pyramidFileName, SHRPyramidFile &file)
+{
+    if(file.f) { return false; } // Already open
+
+    file.f = fopen(pyramidFileName.c_str(), "rb");
+    if(!file.f) { return false; }
+
+    SHRPyramidHeader &header = file.header;
+    if(fread(&header, sizeof(header), 1, file.f) != 1
+        || header.signature != SHRPyramidSignature
+        || header.version != SHRPyramidVersion
+        || header.tileSize == 0
+        || header.levelCount == 0
+        || header.levelCount > SHR_PYRAMID_MAX_LEVELS)
+    {
+        SHRClosePyramid(file);
+        return false;
+    }
+
+    file.levels.resize(header.levelCount);
+    file.tileOffsets.resize(header.levelCount);
+    bool success = SHRFileSeek(file.f, header.levelOffset)
+        && fread(file.levels.data(), sizeof(SHRPyramidLevel), header.levelCount, file.f) == header.levelCount;
+
+    for(uint32_t k = 0; k < header.levelCount && success; k++) {
+        const SHRPyramidLevel &level = file.levels[k];
+        size_t tileCount = (size_t)level.tileRows * level.tileCols;
+        file.tileOffsets[k].resize(tileCount);
+        success = SHRFileSeek(file.f, level.tileTableOffset)
+            && fread(file.tileOffsets[k].data(), sizeof(uint64_t), tileCount, file.f) == tileCount;
+    }
+
+    if(!success) {
+        SHRClosePyramid(file);
+        return false;
+    }
+
+    file.fileName = pyramidFileName;
+
+    return true;
+}
+
+// Returns true if the pyramid was built from the SHR file as it is now
+static bool SHRPyramidIsCurrent(const std::string &fileName, const SHRPyramidHeader &header)
+{
+    if(header.source.coveredSweeps != header.shrHeader.sweepCount
+        || !SHRCheckSideCarSource(fileName, header.source)) {
+        return false;
+    }
+
+    SHRParseState state;
+    if(!SHROpenFile(fileName, state)) {
+        return false;
+    }
+    SHRCloseFile(state);
+
+    // The cells are only valid for the same frequency axis and units
+    return state.header.sweepLength == header.shrHeader.sweepLength
+        && state.header.firstBinFreqHz == header.shrHeader.firstBinFreqHz
+        && state.header.binSizeHz == header.shrHeader.binSizeHz
+        && state.header.refScale == header.shrHeader.refScale;
+}
+
+bool SHROpenPyramid(const std::string &fileName,
+                    SHRDecimationDetector detector,
+                    SHRPyramidFile &file,
+                    bool build)
+{
+    std::string pyramidFileName = SHRPyramidFileName(fileName, detector);
+
+    if(SHRGetFileSize(fileName) == 0) {
+        return false;
+    }
+
+    if(SHROpenPyramidFile(pyramidFileName, file)) {
+        if(SHRPyramidIsCurrent(fileName, file.header)) {
+            return true;
+        }
+        SHRClosePyramid(file); // Stale
+    }
+
+    if(!build || !SHRBuildPyramid(fileName, pyramidFileName, detector)) {
+        return false;
+    }
+
+    return SHROpenPyramidFile(pyramidFileName, file);
+}
+
+void SHRClosePyramid(SHRPyramidFile &file)
+{
+    if(file.f) {
+        fclose(file.f);
+        file.f = nullptr;
+    }
+    file.levels.clear();
+    file.tileOffsets.clear();
+}
+
+int SHRPyramidLevelForScale(const SHRPyramidFile &file, double sweepsPerPixel, double binsPerPixel)
+{
+    double scale = std::min(sweepsPerPixel, binsPerPixel);
+
+    int best = -1;
+    for(size_t k = 0; k < file.levels.size(); k++) {
+        if(file.levels[k].factor <= scale) {
+            best = (int)k;
+        }
+    }
+
+    return best;
+}
+
+bool SHRReadPyramidTile(SHRPyramidFile &file, int level, int tileRow, int tileCol, float *dst)
+{
+    if(!file.f) { return false; }
+    if(level < 0 || level >= (int)file.levels.size()) { return false; }
+
+    const SHRPyramidLevel &info = file.levels[level];
+    if(tileRow < 0 || tileRow >= (int)info.tileRows || tileCol < 0 || tileCol >= (int)info.tileCols) {
+        return false;
+    }
+
+    size_t tileLen = (size_t)file.header.tileSize * file.header.tileSize;
+    return SHRFileSeek(file.f, file.tileOffsets[level][(size_t)tileRow * info.tileCols + tileCol])
+        && fread(dst, sizeof(float), tileLen, file.f) == tileLen;
+}
+
+bool SHRReadPyramidRegion(SHRPyramidFile &file, int level,
+                          int firstRow, int rowCount,
+                          int firstCol, int colCount,
+                          float *dst)
+{
+    if(!file.f) { return false; }
+    if(level < 0 || level >= (int)file.levels.size()) { return false; }
+
+    const SHRPyramidLevel &info = file.levels[level];
+    if(firstRow < 0 || rowCount <= 0 || (uint64_t)firstRow + rowCount > info.rows) { return false; }
+    if(firstCol < 0 || colCount <= 0 || (uint64_t)firstCol + colCount > info.cols) { return false; }
+
+    const int tileSize = file.header.tileSize;
+    std::vector<float> tile((size_t)tileSize * tileSize);
+
+    for(int tr = firstRow / tileSize; tr <= (firstRow + rowCount - 1) / tileSize; tr++) {
+        for(int tc = firstCol / tileSize; tc <= (firstCol + colCount - 1) / tileSize; tc++) {
+            if(!SHRReadPyramidTile(file, level, tr, tc, tile.data())) {
+                return false;
+            }
+
+            // Portion of this tile within the region
+            int r0 = std::max(firstRow, tr * tileSize);
+            int r1 = std::min(firstRow + rowCount, (tr + 1) * tileSize);
+            int c0 = std::max(firstCol, tc * tileSize);
+            int c1 = std::min(firstCol + colCount, (tc + 1) * tileSize);
+            for(int r = r0; r < r1; r++) {
+                memcpy(dst + (size_t)(r - firstRow) * colCount + (c0 - firstCol),
+                    &tile[(size_t)(r - tr * tileSize) * tileSize + (c0 - tc * tileSize)],
+                    sizeof(float) * (c1 - c0));
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,123 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates building a multi-resolution waterfall (spectrogram)
+//   cache for an SHR file. A viewer can pan and zoom over a very large recording
+//   at any zoom level by reading only the tiles that are on screen.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shr_index.h"
+
+// The basic format of the pyramid (.shrp) file is shown below
+//
+// SHRPyramidHeader
+// Tiles, in the order they were built
+// uint64_t tileOffsets[tileRows*tileCols] for level 0
+// ...
+// uint64_t tileOffsets[tileRows*tileCols] for level levelCount-1
+// SHRPyramidLevel[levelCount]
+//
+// Level k is the SHR file decimated by factor = 2^(k+1) along both time and
+//   frequency, i.e. each cell of level k combines factor sweeps x factor bins.
+//   Cells at the end of the file/sweep combine whatever sweeps/bins remain.
+// Levels are added until a level fits within a single tile. Full resolution
+//   (factor 1) is not stored, read it from the SHR file.
+// Each level is split into tiles of tileSize x tileSize cells. A tile is
+//   tileSize rows (time) of tileSize floats (frequency), the tiles on the
+//   right/bottom edge of a level are padded with NaN.
+// Cells are in the units of the SHR file (dBm or mV).
+//
+// Decimation follows the SHR decimation detectors,
+//   SHRDecimationDetectorAvg averages in linear power,
+//   SHRDecimationDetectorMax keeps the largest value.
+
+const uint32_t SHRPyramidSignature = 0x50524853; // "SHRP"
+// Version 2 identifies the SHR file with SHRSideCarSource
+const uint32_t SHRPyramidVersion = 0x2;
+
+#pragma pack(push,1)
+struct SHRPyramidHeader {
+    uint32_t signature;
+    uint32_t version;
+
+    // Header of the source SHR file, sweepCount is the number of sweeps used
+    SHRFileHeader shrHeader;
+    // The SHR file when the pyramid was built, used to detect stale pyramids
+    SHRSideCarSource source;
+
+    int32_t detector; // SHRDecimationDetector
+    uint32_t tileSize; // Rows and columns of cells per tile
+    uint32_t levelCount;
+    uint64_t levelOffset; // Byte offset of SHRPyramidLevel[levelCount]
+};
+
+struct SHRPyramidLevel {
+    uint32_t factor; // Sweeps and bins combined into each cell
+    uint32_t rows; // Cells along time
+    uint32_t cols; // Cells along frequency
+    uint32_t tileRows;
+    uint32_t tileCols;
+    uint64_t tileTableOffset; // Byte offset of the tile offsets of this level
+};
+#pragma pack(pop)
+
+struct SHRPyramidFile {
+    SHRPyramidFile() { f = nullptr; }
+
+    FILE *f;
+    std::string fileName;
+    SHRPyramidHeader header;
+    std::vector<SHRPyramidLevel> levels;
+    // Byte offset of each tile, tileOffsets[level][tileRow * tileCols + tileCol]
+    std::vector<std::vector<uint64_t>> tileOffsets;
+};
+
+// Returns the name of the pyramid file for an SHR file and detector, which is
+//   the SHR file name with ".avg.shrp" or ".max.shrp" appended.
+std::string SHRPyramidFileName(const std::string &fileName, SHRDecimationDetector detector);
+
+// Builds the pyramid for an SHR file in a single pass over the file.
+// Every level is built while the file is read, the decimation of each block of
+//   sweeps is split across threadCount threads.
+// Memory use is a few times tileSize sweeps of the SHR file.
+// tileSize = rows and columns per tile, rounded up to an even number
+// threadCount = number of worker threads, 0 to use one per hardware thread
+bool SHRBuildPyramid(const std::string &fileName,
+                     const std::string &pyramidFileName,
+                     SHRDecimationDetector detector,
+                     int tileSize = 256,
+                     int threadCount = 0);
+
+// Opens the pyramid file of an SHR file.
+// If the pyramid file is missing or was built from a different version of the
+//   SHR file (see SHRSideCarSource, the frequency axis is compared as well), it is
+//   rebuilt when build is true, otherwise false is returned.
+bool SHROpenPyramid(const std::string &fileName,
+                    SHRDecimationDetector detector,
+                    SHRPyramidFile &file,
+                    bool build = true);
+// Opens a pyramid file directly without checking it against the SHR file
+bool SHROpenPyramidFile(const std::string &pyramidFileName, SHRPyramidFile &file);
+void SHRClosePyramid(SHRPyramidFile &file);
+
+// Returns the coarsest level which has at least one cell per screen pixel when
+//   each pixel covers sweepsPerPixel sweeps and binsPerPixel bins.
+// Returns -1 when no level is coarse enough, in which case draw from the SHR file.
+int SHRPyramidLevelForScale(const SHRPyramidFile &file, double sweepsPerPixel, double binsPerPixel);
+
+// Reads one tile, dst = tileSize * tileSize floats
+bool SHRReadPyramidTile(SHRPyramidFile &file, int level, int tileRow, int tileCol, float *dst);
+
+// Reads cells [firstRow, firstRow+rowCount) x [firstCol, firstCol+colCount) of a
+//   level, reading only the tiles which overlap the region.
+// dst = rowCount * colCount floats, dst[r * colCount + c]
+// Cell (r, c) of level k covers sweeps [r * factor, (r+1) * factor) and bins
+//   [c * factor, (c+1) * factor) of the SHR file.
+bool SHRReadPyramidRegion(SHRPyramidFile &file, int level,
+                          int firstRow, int rowCount,
+                          int firstCol, int colCount,
+                          float *dst);
@@ -0,0 +1,285 @@
+#include "shr_transpose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#pragma warning(disable:4996)
+
+// Defaults when sweepsPerTile/binsPerTile are not specified
+static const int SHR_TRANSPOSE_SWEEPS_PER_TILE = 65536;
+static const int SHR_TRANSPOSE_BINS_PER_TILE = 32;
+// Sweeps held in memory while converting
+static const uint64_t SHR_TRANSPOSE_BUFFER_BYTES = 256 << 20;
+
+std::string SHRTransposedFileName(const std::string &fileName)
+{
+    return fileName + ".shrt";
+}
+
+// Gathers bins [firstBin, firstBin+binCount) of sweeps rows of sweepLength floats
+//   into binCount rows of sweeps floats, dst[b * sweeps + s] = src[s * sweepLength + firstBin + b].
+//   Rows past the end of the sweep are filled with NaN.
+static void SHRTransposeBlock(const float *src, int sweeps, int sweepLength,
+                              int firstBin, int binCount, float *dst)
+{
+    int validBins = std::min(binCount, sweepLength - firstBin);
+    for(int s = 0; s < sweeps; s++) {
+        const float *row = src + (size_t)s * sweepLength + firstBin;
+        for(int b = 0; b < validBins; b++) {
+            dst[(size_t)b * sweeps + s] = row[b];
+        }
+    }
+    for(int b = validBins; b < binCount; b++) {
+        std::fill(dst + (size_t)b * sweeps, dst + (size_t)(b + 1) * sweeps,
+            std::numeric_limits<float>::quiet_NaN());
+    }
+}
+
+// Byte offset of a row of tile (binTile, sweepTile), plus sweep offset within the run
+static uint64_t SHRTransposedOffset(const SHRTransposedHeader &header, uint32_t binTile,
+                                    uint32_t sweepTile, uint32_t row, uint32_t sweep)
+{
+    uint64_t tileFloats = (uint64_t)header.binsPerTile * header.sweepsPerTile;
+    uint64_t tile = (uint64_t)binTile * header.sweepTileCount + sweepTile;
+
+    return header.tileOffset
+        + (tile * tileFloats + (uint64_t)row * header.sweepsPerTile + sweep) * sizeof(float);
+}
+
+bool SHRTransposeFile(const std::string &fileName, const std::string &transposedFileName,
+                      int sweepsPerTile, int binsPerTile)
+{
+    SHRReader reader;
+    if(!SHROpenReader(fileName, reader)) {
+        return false;
+    }
+
+    const SHRFileHeader &shrHeader = reader.state.header;
+    const int sweepLength = shrHeader.sweepLength;
+    const int sweepCount = shrHeader.sweepCount;
+
+    // Nothing to transpose, and the buffer size below divides by the sweep length
+    if(sweepLength <= 0) {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    if(sweepsPerTile <= 0) {
+        sweepsPerTile = SHR_TRANSPOSE_SWEEPS_PER_TILE;
+    }
+    if(sweepCount > 0 && sweepsPerTile > sweepCount) {
+        sweepsPerTile = sweepCount;
+    }
+    if(binsPerTile <= 0) {
+        binsPerTile = SHR_TRANSPOSE_BINS_PER_TILE;
+    }
+    if(binsPerTile > sweepLength) {
+        binsPerTile = sweepLength;
+    }
+
+    // Sweeps read at a time, never more than one run
+    int chunkSweeps = (int)std::max<uint64_t>(1,
+        SHR_TRANSPOSE_BUFFER_BYTES / (sizeof(float) * (uint64_t)sweepLength));
+    chunkSweeps = std::min(chunkSweeps, sweepsPerTile);
+
+    FILE *f = fopen(transposedFileName.c_str(), "wb");
+    if(!f) {
+        SHRCloseReader(reader);
+        return false;
+    }
+
+    SHRTransposedHeader header;
+    memset(&header, 0, sizeof(header));
+    header.signature = SHRTransposedSignature;
+    header.version = SHRTransposedVersion;
+    header.shrHeader = shrHeader;
+    header.sweepsPerTile = sweepsPerTile;
+    header.binsPerTile = binsPerTile;
+    header.sweepTileCount = (sweepCount + sweepsPerTile - 1) / sweepsPerTile;
+    header.binTileCount = (sweepLength + binsPerTile - 1) / binsPerTile;
+    header.tileOffset = sizeof(SHRTransposedHeader);
+    header.timestampOffset = SHRTransposedOffset(header, header.binTileCount, 0, 0, 0);
+
+    // Header is rewritten at the end, written now to reserve the space
+    bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    std::vector<float> sweeps((size_t)chunkSweeps * sweepLength);
+    std::vector<float> rows((size_t)binsPerTile * chunkSweeps);
+    std::vector<float> padding;
+    std::vector<uint64_t> timestamps(sweepCount);
+
+    for(uint32_t t = 0; t < header.sweepTileCount && success; t++) {
+        int runFirst = t * sweepsPerTile;
+        int runEnd = std::min(runFirst + sweepsPerTile, sweepCount);
+
+        for(int first = runFirst; first < runEnd && success; first += chunkSweeps) {
+            int count = std::min(chunkSweeps, runEnd - first);
+
+            for(int s = 0; s < count; s++) {
+                const SHRSweepHeader *sweepInfo;
+                const float *sweep;
+                if(!SHRReadSweep(reader, first + s, sweepInfo, sweep)) {
+                    success = false;
+                    break;
+                }
+                memcpy(&sweeps[(size_t)s * sweepLength], sweep, sizeof(float) * sweepLength);
+                timestamps[first + s] = sweepInfo->timestamp;
+            }
+
+            // The last run is padded to a full run, after the last chunk of each row
+            int padCount = (first + count == runEnd) ? runFirst + sweepsPerTile - runEnd : 0;
+            if(padCount > 0) {
+                padding.assign(padCount, std::numeric_limits<float>::quiet_NaN());
+            }
+
+            for(uint32_t c = 0; c < header.binTileCount && success; c++) {
+                SHRTransposeBlock(sweeps.data(), count, sweepLength, c * binsPerTile, binsPerTile,
+                    rows.data());
+
+                if(count == sweepsPerTile) {
+                    // The chunk is the whole run, the tile is written in one piece
+                    success = SHRFileSeek(f, SHRTransposedOffset(header, c, t, 0, 0))
+                        && fwrite(rows.data(), sizeof(float), (size_t)binsPerTile * count, f)
+                            == (size_t)binsPerTile * count;
+                    continue;
+                }
+
+                for(int r = 0; r < binsPerTile && success; r++) {
+                    success = SHRFileSeek(f, SHRTransposedOffset(header, c, t, r, first - runFirst))
+                        && fwrite(&rows[(size_t)r * count], sizeof(float), count, f) == (size_t)count;
+                    if(success && padCount > 0) {
+                        success = fwrite(padding.data(), sizeof(float), padCount, f) == (size_t)padCount;
+                    }
+                }
+            }
+        }
+    }
+
+    if(success && sweepCount > 0) {
+        success = SHRFileSeek(f, header.timestampOffset)
+            && fwrite(timestamps.data(), sizeof(uint64_t), sweepCount, f) == (size_t)sweepCount;
+    }
+
+    if(success) {
+        success = SHRFileSeek(f, 0) && fwrite(&header, sizeof(header), 1, f) == 1;
+    }
+
+    success = (fclose(f) == 0) && success;
+    SHRCloseReader(reader);
+
+    if(!success) {
+        remove(transposedFileName.c_str());
+    }
+
+    return success;
+}
+
+bool SHROpenTransposedFile(const std::string &fileName, SHRTransposedFile &file)
+{
+    if(file.f) { return false; } // Already open
+
+    file.f = fopen(fileName.c_str(), "rb");
+    if(!file.f) { return false; }
+
+    if(fread(&file.header, sizeof(SHRTransposedHeader), 1, file.f) != 1
+        || file.header.signature != SHRTransposedSignature
+        || file.header.version != SHRTransposedVersion
+        || file.header.sweepsPerTile == 0
+        || file.header.binsPerTile == 0)
+    {
+        SHRCloseTransposedFile(file);
+        return false;
+    }
+
+    file.fileName = fileName;
+
+    return true;
+}
+
+void SHRCloseTransposedFile(SHRTransposedFile &file)
+{
+    if(file.f) {
+        fclose(file.f);
+        file.f = nullptr;
+    }
+}
+
+int SHRFreqToBin(const SHRFileHeader &header, double freqHz)
+{
+    int bin = (int)floor((freqHz - header.firstBinFreqHz) / header.binSizeHz + 0.5);
+    if(bin < 0) {
+        bin = 0;
+    }
+    if(bin >= (int)header.sweepLength) {
+        bin = header.sweepLength - 1;
+    }
+
+    return bin;
+}
+
+bool SHRReadBinSeries(SHRTransposedFile &file, int firstBin, int binCount,
+                      int firstSweep, int sweepCount, float *dst)
+{
+    if(!file.f) { return false; }
+
+    const SHRTransposedHeader &header = file.header;
+    const int sweepsPerTile = header.sweepsPerTile;
+    const int binsPerTile = header.binsPerTile;
+
+    if(firstBin < 0 || binCount <= 0 || firstBin + binCount > (int)header.shrHeader.sweepLength) {
+        return false;
+    }
+    if(firstSweep < 0 || sweepCount <= 0 || firstSweep + sweepCount > (int)header.shrHeader.sweepCount) {
+        return false;
+    }
+
+    const int lastBin = firstBin + binCount;
+    const int lastSweep = firstSweep + sweepCount;
+
+    // Each bin is read one run at a time straight into dst. Rows which follow each
+    //   other in the file are read without seeking, so a whole block of bins over
+    //   whole runs is one sequential read.
+    uint64_t pos = UINT64_MAX;
+    for(int c = firstBin / binsPerTile; c <= (lastBin - 1) / binsPerTile; c++) {
+        int b0 = std::max(firstBin, c * binsPerTile);
+        int b1 = std::min(lastBin, (c + 1) * binsPerTile);
+
+        for(int b = b0; b < b1; b++) {
+            for(int t = firstSweep / sweepsPerTile; t <= (lastSweep - 1) / sweepsPerTile; t++) {
+                int runFirst = t * sweepsPerTile;
+                int s0 = std::max(firstSweep, runFirst);
+                int s1 = std::min(lastSweep, runFirst + sweepsPerTile);
+
+                uint64_t offset = SHRTransposedOffset(header, c, t, b - c * binsPerTile, s0 - runFirst);
+                if(offset != pos && !SHRFileSeek(file.f, offset)) {
+                    return false;
+                }
+
+                size_t n = s1 - s0;
+                if(fread(dst + (size_t)(b - firstBin) * sweepCount + (s0 - firstSweep),
+                    sizeof(float), n, file.f) != n)
+                {
+                    return false;
+                }
+                pos = offset + n * sizeof(float);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool SHRReadTransposedTimestamps(SHRTransposedFile &file, int firstSweep, int sweepCount,
+                                 uint64_t *timestamps)
+{
+    if(!file.f) { return false; }
+    if(firstSweep < 0 || sweepCount <= 0 || firstSweep + sweepCount > (int)file.header.shrHeader.sweepCount) {
+        return false;
+    }
+
+    return SHRFileSeek(file.f, file.header.timestampOffset + sizeof(uint64_t) * (uint64_t)firstSweep)
+        && fread(timestamps, sizeof(uint64_t), sweepCount, file.f) == (size_t)sweepCount;
+}
@@ -0,0 +1,95 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates converting an SHR file into a frequency-major companion
+//   file, so the history of a single frequency bin (or a narrow band of bins)
+//   can be read without touching every sweep record in the SHR file.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "shr_parse.h"
+
+// The basic format of the transposed (.shrt) file is shown below
+//
+// SHRTransposedHeader
+// Tile[0]
+// Tile[1]
+// ...
+// Tile[binTileCount*sweepTileCount-1]
+// uint64_t timestamps[sweepCount]
+//
+// The sweeps are split along frequency into blocks of binsPerTile bins and along
+//   time into runs of sweepsPerTile sweeps. A tile holds one block of bins over
+//   one run of sweeps, stored frequency-major, i.e. binsPerTile rows of
+//   sweepsPerTile floats where row b holds one bin of each sweep in the run.
+//   Tiles at the end of the file/sweep are padded with NaN.
+// Tile (binTile, sweepTile) is tile number binTile * sweepTileCount + sweepTile,
+//   so the tiles of one block of bins follow each other in time.
+// Reading bin b across all sweeps is one sequential read of sweepsPerTile floats
+//   per run, sweepCount / sweepsPerTile reads in all. Reading a whole block of
+//   bins across all sweeps is a single sequential read.
+
+const uint32_t SHRTransposedSignature = 0x54524853; // "SHRT"
+// Version 2 tiles along frequency as well as time
+const uint32_t SHRTransposedVersion = 0x2;
+
+#pragma pack(push,1)
+struct SHRTransposedHeader {
+    uint32_t signature;
+    uint32_t version;
+
+    // Header of the source SHR file, sweepCount is the number of sweeps converted.
+    // Use firstBinFreqHz and binSizeHz to map frequencies to bins.
+    SHRFileHeader shrHeader;
+
+    uint32_t sweepsPerTile;
+    uint32_t binsPerTile;
+    uint32_t sweepTileCount;
+    uint32_t binTileCount;
+    uint64_t tileOffset; // Byte offset of the first tile
+    uint64_t timestampOffset; // Byte offset of the timestamp array
+};
+#pragma pack(pop)
+
+struct SHRTransposedFile {
+    SHRTransposedFile() { f = nullptr; }
+
+    FILE *f;
+    std::string fileName;
+    SHRTransposedHeader header;
+};
+
+// Returns the name of the transposed file for an SHR file, which is the SHR file
+//   name with ".shrt" appended.
+std::string SHRTransposedFileName(const std::string &fileName);
+
+// Converts an SHR file into the transposed format.
+// sweepsPerTile = length of each run of sweeps, 0 for 65536. Longer runs mean
+//   fewer, larger reads of a bin's history.
+// binsPerTile = bins per block, 0 for 32
+// Converting holds ~256MB of sweeps in memory, independent of the tile size. Each
+//   bin of those sweeps is written as one piece, so conversion writes grow with
+//   this buffer and shrink with the sweep length.
+// Returns false if the file cannot be read, has no bins (sweepLength <= 0), or
+//   the transposed file cannot be written.
+bool SHRTransposeFile(const std::string &fileName, const std::string &transposedFileName,
+                      int sweepsPerTile = 0, int binsPerTile = 0);
+
+// Open/close a transposed file, return true if success
+bool SHROpenTransposedFile(const std::string &fileName, SHRTransposedFile &file);
+void SHRCloseTransposedFile(SHRTransposedFile &file);
+
+// Returns the bin closest to freqHz, clamped to [0, sweepLength-1]
+int SHRFreqToBin(const SHRFileHeader &header, double freqHz);
+
+// Reads bins [firstBin, firstBin+binCount) of sweeps [firstSweep, firstSweep+sweepCount).
+// dst = binCount * sweepCount floats, stored as binCount rows of sweepCount
+//   values, i.e. dst[b * sweepCount + s] is bin firstBin+b of sweep firstSweep+s
+bool SHRReadBinSeries(SHRTransposedFile &file, int firstBin, int binCount,
+                      int firstSweep, int sweepCount, float *dst);
+
+// Reads the timestamps of sweeps [firstSweep, firstSweep+sweepCount)
+bool SHRReadTransposedTimestamps(SHRTransposedFile &file, int firstSweep, int sweepCount,
+                                 uint64_t *timestamps);
@@ -0,0 +1,235 @@
+#include "shr_writer.h"
+
+#include <cstddef>
+#include <cstring>
+
+#pragma warning(disable:4996)
+
+void SHRInitFileHeader(SHRFileHeader &header,
+                       int sweepLength,
+                       double firstBinFreqHz,
+                       double binSizeHz,
+                       double rbwHz,
+                       double vbwHz,
+                       float refLevel,
+                       SHRScale scale)
+{
+    memset(&header, 0, sizeof(SHRFileHeader));
+
+    header.signature = SHRFileSignature;
+    header.version = SHRFileVersion;
+    header.dataOffset = sizeof(SHRFileHeader);
+
+    header.sweepCount = 0;
+    header.sweepLength = sweepLength;
+    header.firstBinFreqHz = firstBinFreqHz;
+    header.binSizeHz = binSizeHz;
+
+    header.spanHz = binSizeHz * (sweepLength - 1);
+    header.centerFreqHz = firstBinFreqHz + header.spanHz / 2.0;
+    header.rbwHz = rbwHz;
+    header.vbwHz = vbwHz;
+    header.refLevel = refLevel;
+    header.refScale = scale;
+    header.div = 10.0f;
+    header.window = SHRWindowNuttall;
+    header.detector = SHRVideoDetectorMinMax;
+    header.processingUnits = SHRVideoUnitsPower;
+
+    // No decimation, every sweep recorded
+    header.decimationType = SHRDecimationTypeCount;
+    header.decimationDetector = SHRDecimationDetectorAvg;
+    header.decimationCount = 1;
+    header.decimationTimeMs = 0;
+
+    header.channelizeEnabled = 0;
+}
+
+void SHRSetFileTitle(SHRFileHeader &header, const std::string &title)
+{
+    memset(header.title, 0, sizeof(header.title));
+    for(size_t i = 0; i < title.size() && i < 127; i++) {
+        header.title[i] = (uint16_t)(uint8_t)title[i];
+    }
+}
+
+SHRWriter::SHRWriter() :
+    file(nullptr),
+    sweepSizeInBytes(0),
+    sweepCount(0),
+    current(nullptr),
+    closing(false),
+    writeError(false)
+{
+}
+
+SHRWriter::~SHRWriter()
+{
+    Close();
+}
+
+bool SHRWriter::Open(const std::string &fileName,
+                     const SHRFileHeader &header,
+                     int bufferCount,
+                     int bufferSizeBytes)
+{
+    if(file) { return false; } // Already open
+    if(header.sweepLength == 0) { return false; }
+
+    file = fopen(fileName.c_str(), "wb");
+    if(!file) { return false; } // Unable to create file
+
+    // All writes are large and issued from our own buffers, skip the stdio buffer
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    fileHeader = header;
+    fileHeader.sweepCount = 0;
+    fileHeader.dataOffset = sizeof(SHRFileHeader);
+    if(fwrite(&fileHeader, sizeof(SHRFileHeader), 1, file) != 1) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    sweepSizeInBytes = sizeof(SHRSweepHeader) + sizeof(float) * (size_t)header.sweepLength;
+    sweepCount = 0;
+
+    // Whole sweeps per buffer
+    if(bufferCount < 2) {
+        bufferCount = 2;
+    }
+    // A negative size would wrap to a huge size_t, clamp it like bufferCount
+    if(bufferSizeBytes < 0) {
+        bufferSizeBytes = 0;
+    }
+    size_t sweepsPerBuffer = (size_t)bufferSizeBytes / sweepSizeInBytes;
+    if(sweepsPerBuffer < 1) {
+        sweepsPerBuffer = 1;
+    }
+
+    // All memory is allocated up front, nothing is allocated while recording
+    buffers.resize(bufferCount);
+    freeBuffers.clear();
+    fullBuffers.clear();
+    for(Buffer &b : buffers) {
+        b.data.resize(sweepsPerBuffer * sweepSizeInBytes);
+        b.used = 0;
+        freeBuffers.push_back(&b);
+    }
+    current = freeBuffers.front();
+    freeBuffers.pop_front();
+
+    closing = false;
+    writeError = false;
+    thread = std::thread(&SHRWriter::WriterThread, this);
+
+    return true;
+}
+
+bool SHRWriter::Write(const float *sweep, const SHRSweepHeader &sweepInfo)
+{
+    if(!file || !current) { return false; } // Not open or a write failed
+
+    if(current->used + sweepSizeInBytes > current->data.size()) {
+        if(!SubmitBuffer()) {
+            return false;
+        }
+    }
+
+    uint8_t *dst = current->data.data() + current->used;
+    memcpy(dst, &sweepInfo, sizeof(SHRSweepHeader));
+    memcpy(dst + sizeof(SHRSweepHeader), sweep, sweepSizeInBytes - sizeof(SHRSweepHeader));
+    current->used += sweepSizeInBytes;
+    sweepCount++;
+
+    return true;
+}
+
+bool SHRWriter::SubmitBuffer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    fullBuffers.push_back(current);
+    current = nullptr;
+    fullCond.notify_one();
+
+    // Only blocks when the disk is not keeping up
+    freeCond.wait(lock, [this] { return !freeBuffers.empty() || writeError; });
+    if(writeError) {
+        return false;
+    }
+
+    current = freeBuffers.front();
+    freeBuffers.pop_front();
+
+    return true;
+}
+
+void SHRWriter::WriterThread()
+{
+    while(true) {
+        Buffer *b;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fullCond.wait(lock, [this] { return !fullBuffers.empty() || closing; });
+            if(fullBuffers.empty()) {
+                return; // Closing and everything is written
+            }
+            b = fullBuffers.front();
+            fullBuffers.pop_front();
+        }
+
+        bool success = true;
+        if(b->used > 0) {
+            success = fwrite(b->data.data(), 1, b->used, file) == b->used;
+        }
+        b->used = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!success) {
+                writeError = true;
+            }
+            freeBuffers.push_back(b);
+        }
+        freeCond.notify_one();
+    }
+}
+
+bool SHRWriter::Close()
+{
+    if(!file) { return false; }
+
+    // Write out the partially filled buffer and wait for the writer to drain
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(current) {
+            fullBuffers.push_back(current);
+            current = nullptr;
+        }
+        closing = true;
+    }
+    fullCond.notify_one();
+    thread.join();
+
+    bool success = !writeError;
+
+    // Patch the sweep count into the file header
+    fileHeader.sweepCount = sweepCount;
+    if(fseek(file, offsetof(SHRFileHeader, sweepCount), SEEK_SET) != 0
+        || fwrite(&fileHeader.sweepCount, sizeof(fileHeader.sweepCount), 1, file) != 1)
+    {
+        success = false;
+    }
+
+    if(fclose(file) != 0) {
+        success = false;
+    }
+    file = nullptr;
+
+    buffers.clear();
+    freeBuffers.clear();
+    fullBuffers.clear();
+
+    return success;
+}
@@ -0,0 +1,112 @@
+// Copyright Signal Hound 2018
+
+// This file demonstrates how to record sweeps to an SHR file which can be opened
+//   by the Spike software and the parsing functions in shr_parse.h.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shr_parse.h"
+
+// Initializes an SHR file header for sweeps of the given configuration. The sweep
+//   parameters correspond to the values returned from smGetSweepParameters
+//   (or bbQueryTraceInfo), the remaining fields are set to defaults and can be
+//   modified before the header is passed to SHRWriter::Open.
+// A sweepCount of zero is written and is updated by SHRWriter::Close.
+void SHRInitFileHeader(SHRFileHeader &header,
+                       int sweepLength,
+                       double firstBinFreqHz,
+                       double binSizeHz,
+                       double rbwHz,
+                       double vbwHz,
+                       float refLevel,
+                       SHRScale scale);
+
+// Sets the title stored in the file header, truncated to 127 characters.
+void SHRSetFileTitle(SHRFileHeader &header, const std::string &title);
+
+// Writes SHR files from an acquisition loop.
+// Write copies the sweep into a pool of large buffers and returns immediately.
+//   A background thread writes full buffers to disk, so the acquisition thread
+//   never waits on the disk unless every buffer in the pool is waiting to be
+//   written, i.e. the disk cannot sustain the sweep rate.
+//
+// Example, recording in the SM THz sweep loop:
+//   smGetSweepParameters(handle, &rbw, &vbw, &startFreq, &binSize, &sweepSize);
+//   SHRFileHeader header;
+//   SHRInitFileHeader(header, sweepSize, startFreq, binSize, rbw, vbw, -20.0f, SHRScaleDBM);
+//   SHRWriter writer;
+//   writer.Open("recording.shr", header);
+//   SHRSweepHeader sweepInfo = {};
+//   while(...) {
+//       smFinishSweep(handle, queuePos, nullptr, sweep, nullptr);
+//       sweepInfo.timestamp = <milliseconds since epoch>;
+//       writer.Write(sweep, sweepInfo);
+//       ...
+//   }
+//   writer.Close();
+class SHRWriter {
+public:
+    SHRWriter();
+    ~SHRWriter(); // Closes the file if open
+
+    // fileName = file to create, overwritten if it exists
+    // header = header from SHRInitFileHeader, sweepCount and dataOffset are set
+    //   by the writer
+    // bufferCount = number of buffers in the pool, at least 2
+    // bufferSizeBytes = target size of each buffer, rounded up to hold at least
+    //   one sweep. Larger buffers result in fewer, larger writes.
+    // Returns false if the file cannot be created or the writer is already open.
+    bool Open(const std::string &fileName,
+              const SHRFileHeader &header,
+              int bufferCount = 8,
+              int bufferSizeBytes = 4 << 20);
+
+    // Queue one sweep to be written.
+    // sweep = header.sweepLength floats
+    // Returns false if the writer is not open or a previous write failed.
+    bool Write(const float *sweep, const SHRSweepHeader &sweepInfo);
+
+    // Writes all queued sweeps, updates the sweep count in the file header and
+    //   closes the file. Returns false if any write failed.
+    bool Close();
+
+    bool IsOpen() const { return file != nullptr; }
+    // Number of sweeps queued with Write since Open
+    uint32_t SweepCount() const { return sweepCount; }
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> data;
+        size_t used;
+    };
+
+    void WriterThread();
+    // Hands the current buffer to the writer thread and acquires a free one.
+    // Returns false if a write has failed.
+    bool SubmitBuffer();
+
+    FILE *file;
+    SHRFileHeader fileHeader;
+    size_t sweepSizeInBytes;
+    uint32_t sweepCount;
+
+    std::vector<Buffer> buffers;
+    Buffer *current;
+    std::deque<Buffer*> freeBuffers;
+    std::deque<Buffer*> fullBuffers;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable freeCond; // Signaled when a buffer is freed
+    std::condition_variable fullCond; // Signaled when a buffer is submitted or on close
+    bool closing;
+    bool writeError;
+};
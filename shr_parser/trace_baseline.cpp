@@ -0,0 +1,139 @@
+#include "trace_baseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+TraceBaseline::TraceBaseline() :
+    len(0),
+    maxDetections(0),
+    mergeGap(0),
+    traceCount(0),
+    detectionCount(0),
+    detectedBins(0),
+    overflowed(false)
+{
+    memset(&params, 0, sizeof(params));
+}
+
+bool TraceBaseline::Configure(int len,
+                              float nSigma,
+                              float alpha,
+                              int warmup,
+                              float minSigma,
+                              bool gate,
+                              int maxDetections,
+                              int mergeGap)
+{
+    this->len = 0;
+    if(len <= 0 || !(nSigma > 0.0f) || alpha < 0.0f || alpha > 1.0f || maxDetections <= 0) {
+        return false;
+    }
+
+    this->len = len;
+    this->maxDetections = maxDetections;
+    this->mergeGap = std::max(mergeGap, 0);
+
+    params.alpha = alpha;
+    params.k2 = nSigma * nSigma;
+    params.minVar = minSigma * minSigma;
+    params.minCount = (float)std::max(warmup, 1);
+    params.gate = gate;
+
+    mean.assign(len, 0.0f);
+    var.assign(len, 0.0f);
+    count.assign(len, 0.0f);
+    // Padded to whole 64-bit words so the mask can be scanned a word at a time
+    mask.assign(((len + 63) / 64) * 8, 0);
+    score.assign(len, 0.0f);
+    detections.resize(maxDetections);
+
+    Reset();
+
+    return true;
+}
+
+void TraceBaseline::Reset()
+{
+    std::fill(mean.begin(), mean.end(), 0.0f);
+    std::fill(var.begin(), var.end(), 0.0f);
+    std::fill(count.begin(), count.end(), 0.0f);
+    traceCount = 0;
+    detectionCount = 0;
+    detectedBins = 0;
+    overflowed = false;
+}
+
+float TraceBaseline::StdDev(int bin) const
+{
+    if(bin < 0 || bin >= len) {
+        return 0.0f;
+    }
+
+    return sqrtf(var[bin]);
+}
+
+int TraceBaseline::Process(const float *trace)
+{
+    detectionCount = 0;
+    overflowed = false;
+    if(len == 0) {
+        detectedBins = 0;
+        return 0;
+    }
+
+    detectedBins = traceBaselineUpdate(mean.data(), var.data(), count.data(), trace, len,
+        params, mask.data(), score.data());
+    traceCount++;
+
+    if(detectedBins == 0) {
+        return 0;
+    }
+
+    // Turn the detected bins into runs, skipping empty words of the mask
+    TraceDetection *current = nullptr;
+    const int wordCount = (len + 63) / 64;
+    for(int w = 0; w < wordCount; w++) {
+        uint64_t word;
+        memcpy(&word, &mask[w * 8], sizeof(word));
+        if(w == wordCount - 1 && (len & 63)) {
+            word &= (1ull << (len & 63)) - 1; // Bits past len are not written
+        }
+
+        for(int bit = 0; word; bit++, word >>= 1) {
+            // Detections are sparse, skip empty bytes
+            while(!(word & 0xFF)) {
+                word >>= 8;
+                bit += 8;
+            }
+            if(!(word & 1)) {
+                continue;
+            }
+            int bin = w * 64 + bit;
+
+            if(current && bin <= current->lastBin + 1 + mergeGap) {
+                current->lastBin = bin;
+                if(trace[bin] > current->peakAmpl) {
+                    current->peakBin = bin;
+                    current->peakAmpl = trace[bin];
+                    current->peakSigma = score[bin];
+                }
+                continue;
+            }
+
+            if(detectionCount == maxDetections) {
+                overflowed = true;
+                return detectionCount;
+            }
+
+            current = &detections[detectionCount++];
+            current->firstBin = bin;
+            current->lastBin = bin;
+            current->peakBin = bin;
+            current->peakAmpl = trace[bin];
+            current->peakSigma = score[bin];
+        }
+    }
+
+    return detectionCount;
+}
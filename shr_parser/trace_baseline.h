@@ -0,0 +1,104 @@
+// Copyright Signal Hound 2018
+
+// Per-bin baseline and anomaly detection over a stream of traces.
+// Works on any stream of equal length log (dBm) traces, such as the sweeps of an
+//   SHR file (SHRForEachSweep/SHRFollower), smGetSweep or bbFetchTrace_32f.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "trace_kernels.h"
+
+// A run of adjacent bins above the baseline in one trace
+struct TraceDetection {
+    int firstBin;
+    int lastBin; // Inclusive
+    int peakBin; // Highest bin of the run
+    float peakAmpl; // Amplitude of the peak bin, in the units of the trace
+    float peakSigma; // Excess of the peak bin over the baseline, in standard deviations
+};
+
+// Learns the mean and variance of every bin and reports the bins which exceed
+//   their mean by more than nSigma standard deviations as compact detection
+//   events, one per run of adjacent bins, rather than full traces.
+// All memory is allocated in Configure, Process does not allocate. Updates and
+//   comparisons are vectorized through traceBaselineUpdate and run at close to a
+//   billion bins per second with AVX2, far above the bin rate of the 1THz/s
+//   sweeps in sm_example_thz_sweep.cpp.
+//
+// Example:
+//   TraceBaseline baseline;
+//   baseline.Configure(sweepSize, 6.0f);
+//   while(...) {
+//       smGetSweep(handle, nullptr, sweep, &timestamp);
+//       int count = baseline.Process(sweep);
+//       for(int i = 0; i < count; i++) {
+//           const TraceDetection &d = baseline.Detections()[i];
+//           ... frequency = startFreq + d.peakBin * binSize
+//       }
+//   }
+class TraceBaseline {
+public:
+    TraceBaseline();
+
+    // len = trace length
+    // nSigma = detection threshold in standard deviations above the mean
+    // alpha = weight of each new trace once learned, the baseline adapts over
+    //   roughly 1/alpha traces. 0 for a cumulative mean/variance of every trace.
+    // warmup = number of traces learned before any detections are made
+    // minSigma = standard deviation floor in the units of the trace, prevents
+    //   detections on bins which have not varied yet
+    // gate = if true, detected bins do not update the baseline, so a persistent
+    //   signal is not learned into the baseline
+    // maxDetections = maximum events reported per trace
+    // mergeGap = runs separated by up to this many bins are reported as one event
+    bool Configure(int len,
+                   float nSigma,
+                   float alpha = 0.01f,
+                   int warmup = 20,
+                   float minSigma = 0.5f,
+                   bool gate = true,
+                   int maxDetections = 256,
+                   int mergeGap = 0);
+
+    // Tests a trace against the baseline, then updates the baseline with it.
+    // Returns the number of detection events, see Detections.
+    int Process(const float *trace);
+
+    // Events of the last call to Process, in bin order, valid until the next call
+    const TraceDetection *Detections() const { return detections.data(); }
+    int DetectionCount() const { return detectionCount; }
+    // Number of detected bins in the last call to Process
+    int DetectedBins() const { return detectedBins; }
+    // True if the last call to Process found more than maxDetections events, the
+    //   events after the first maxDetections are dropped
+    bool Overflowed() const { return overflowed; }
+
+    // Current baseline
+    const float *Mean() const { return mean.data(); }
+    float StdDev(int bin) const;
+    int TraceCount() const { return traceCount; }
+
+    // Forget the baseline, the configuration is kept
+    void Reset();
+
+private:
+    int len;
+    int maxDetections;
+    int mergeGap;
+    TraceBaselineParams params;
+
+    std::vector<float> mean;
+    std::vector<float> var;
+    std::vector<float> count;
+    std::vector<uint8_t> mask;
+    std::vector<float> score;
+    int traceCount;
+
+    std::vector<TraceDetection> detections;
+    int detectionCount;
+    int detectedBins;
+    bool overflowed;
+};
@@ -0,0 +1,147 @@
+#include "trace_benchmark.h"
+#include "trace_kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static double GetCurrentSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Prevents the compiler from discarding the kernel results
+static volatile int traceBenchmarkSink;
+
+// Runs the kernel for approximately 'seconds' and returns millions of points per second
+template<typename Kernel>
+static double traceTimeKernel(int traceLength, double seconds, Kernel kernel)
+{
+    // Warm up and estimate the iteration count from a short run
+    int iters = 16;
+    double elapsed = 0.0;
+    while(true) {
+        double start = GetCurrentSeconds();
+        for(int i = 0; i < iters; i++) {
+            kernel();
+        }
+        elapsed = GetCurrentSeconds() - start;
+        if(elapsed > seconds * 0.1 || iters > (1 << 28)) {
+            break;
+        }
+        iters *= 2;
+    }
+
+    iters = (int)(iters * (seconds / elapsed));
+    if(iters < 1) {
+        iters = 1;
+    }
+
+    double start = GetCurrentSeconds();
+    for(int i = 0; i < iters; i++) {
+        kernel();
+    }
+    elapsed = GetCurrentSeconds() - start;
+
+    return ((double)iters * traceLength) / elapsed / 1.0e6;
+}
+
+static void traceBenchmarkIsa(int traceLength, double seconds, std::vector<float> &trace,
+                              std::vector<float> &hold, std::vector<int> &peaks, double *mpts)
+{
+    mpts[0] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceBenchmarkSink = traceArgMax(trace.data(), traceLength);
+    });
+    mpts[1] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceBenchmarkSink = traceFindPeaks(trace.data(), traceLength, (int)peaks.size(), peaks.data());
+    });
+    mpts[2] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceMaxHold(hold.data(), trace.data(), traceLength);
+    });
+    mpts[3] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceMinHold(hold.data(), trace.data(), traceLength);
+    });
+    mpts[4] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceAccumulatePower(hold.data(), trace.data(), traceLength);
+    });
+
+    std::vector<float> mean(traceLength, 0.0f), var(traceLength, 0.0f), count(traceLength, 0.0f);
+    std::vector<float> score(traceLength);
+    std::vector<uint8_t> mask((traceLength + 7) / 8);
+    TraceBaselineParams params = { 0.01f, 36.0f, 0.25f, 20.0f, true };
+    mpts[5] = traceTimeKernel(traceLength, seconds, [&]() {
+        traceBenchmarkSink = traceBaselineUpdate(mean.data(), var.data(), count.data(), trace.data(),
+            traceLength, params, mask.data(), score.data());
+    });
+}
+
+int traceBenchmark(int traceLength, double seconds, TraceBenchmarkResult *results)
+{
+    static const char *names[TRACE_BENCHMARK_KERNEL_COUNT] = {
+        "ArgMax", "FindPeaks(10)", "MaxHold", "MinHold", "AccumulatePower", "BaselineUpdate"
+    };
+
+    if(traceLength <= 0) {
+        return 0;
+    }
+
+    // Noise floor around -100dBm with a few signals
+    std::vector<float> trace(traceLength);
+    srand(0);
+    for(int i = 0; i < traceLength; i++) {
+        trace[i] = -100.0f + (rand() % 1000) / 100.0f;
+    }
+    // Too short to space the signals out, noise only
+    if(traceLength >= 8) {
+        for(int i = 1; i < 8; i++) {
+            trace[(traceLength / 8) * i] = -30.0f - i;
+        }
+    }
+    std::vector<float> hold(trace);
+    std::vector<int> peaks(10);
+
+    TraceIsa isa = traceGetIsa();
+
+    double scalar[TRACE_BENCHMARK_KERNEL_COUNT];
+    traceSetIsa(TraceIsaScalar);
+    traceBenchmarkIsa(traceLength, seconds, trace, hold, peaks, scalar);
+
+    double vector[TRACE_BENCHMARK_KERNEL_COUNT];
+    traceSetIsa(TraceIsaAVX512);
+    traceBenchmarkIsa(traceLength, seconds, trace, hold, peaks, vector);
+
+    traceSetIsa(isa);
+
+    for(int i = 0; i < TRACE_BENCHMARK_KERNEL_COUNT; i++) {
+        results[i].name = names[i];
+        results[i].scalarMpts = scalar[i];
+        results[i].vectorMpts = vector[i];
+    }
+
+    return TRACE_BENCHMARK_KERNEL_COUNT;
+}
+
+void traceBenchmarkPrint(int traceLength, double seconds)
+{
+    static const char *isaNames[] = { "Scalar", "AVX2", "AVX-512" };
+
+    TraceBenchmarkResult results[TRACE_BENCHMARK_KERNEL_COUNT];
+    int count = traceBenchmark(traceLength, seconds, results);
+    if(count == 0) {
+        printf("Trace length %d, nothing to benchmark\n", traceLength);
+        return;
+    }
+
+    TraceIsa isa = traceGetIsa();
+    TraceIsa best = traceSetIsa(TraceIsaAVX512);
+    traceSetIsa(isa);
+
+    printf("Trace length %d, best instruction set %s\n", traceLength, isaNames[best]);
+    for(int i = 0; i < count; i++) {
+        printf("%-16s scalar %9.1f Mpts/s, vector %9.1f Mpts/s, speedup %.2fx\n",
+            results[i].name, results[i].scalarMpts, results[i].vectorMpts,
+            results[i].vectorMpts / results[i].scalarMpts);
+    }
+}
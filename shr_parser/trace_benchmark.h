@@ -0,0 +1,27 @@
+// Copyright Signal Hound 2018
+
+// Measures the throughput of the trace kernels in trace_kernels.h, scalar against
+//   the vectorized implementation selected for the CPU.
+
+#pragma once
+
+const int TRACE_BENCHMARK_KERNEL_COUNT = 6;
+
+// Results of timing one kernel, in millions of trace points per second
+struct TraceBenchmarkResult {
+    const char *name;
+    double scalarMpts;
+    double vectorMpts;
+};
+
+// Times each trace kernel with the scalar implementation and with the best
+//   implementation the CPU supports.
+// traceLength = number of points in each trace, e.g. the sweepLength of an SHR file
+// seconds = approximate duration of the test for each kernel and implementation
+// results = at least TRACE_BENCHMARK_KERNEL_COUNT entries
+// Returns the number of results written, 0 if traceLength <= 0.
+int traceBenchmark(int traceLength, double seconds, TraceBenchmarkResult *results);
+
+// Runs traceBenchmark and prints the results with the speedup of each kernel
+//   over the scalar loop.
+void traceBenchmarkPrint(int traceLength, double seconds);
@@ -0,0 +1,799 @@
+#include "trace_kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRACE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang require each function using AVX intrinsics to be marked with the
+//   instruction set, MSVC compiles intrinsics for any instruction set.
+#if defined(TRACE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TRACE_AVX2 __attribute__((target("avx2,fma")))
+#define TRACE_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define TRACE_AVX2
+#define TRACE_AVX512
+#endif
+
+// 10^(x/10) = 2^(x * log2(10)/10)
+static const float TRACE_DB_TO_LOG2 = 0.33219280948873623f;
+// Number of values summed in float lanes before being added to a double total
+static const int TRACE_SUM_BLOCK = 1024;
+
+struct TraceKernels {
+    TraceIsa isa;
+    int (*argMax)(const float *src, int len);
+    int (*skipBelow)(const float *src, int len, float threshold);
+    void (*maxHold)(float *hold, const float *src, int len);
+    void (*minHold)(float *hold, const float *src, int len);
+    void (*accumulatePower)(float *acc, const float *srcDBm, int len);
+    double (*sumPower)(const float *srcDBm, int len);
+    int (*countAtOrAbove)(const float *src, int len, float threshold);
+    int (*baselineUpdate)(float *mean, float *var, float *count, const float *src, int len,
+                          const TraceBaselineParams &params, uint8_t *mask, float *score);
+};
+
+//
+// Scalar implementations, used as the fallback and for the tail of each vector loop
+//
+
+static int traceArgMaxScalar(const float *src, int len)
+{
+    if(len <= 0) {
+        return -1;
+    }
+
+    int peakIndex = 0;
+    for(int i = 1; i < len; i++) {
+        if(src[i] > src[peakIndex]) {
+            peakIndex = i;
+        }
+    }
+
+    return peakIndex;
+}
+
+// Returns the index of the first value above threshold, len if there are none
+static int traceSkipBelowScalar(const float *src, int len, float threshold)
+{
+    for(int i = 0; i < len; i++) {
+        if(src[i] > threshold) {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+static void traceMaxHoldScalar(float *hold, const float *src, int len)
+{
+    for(int i = 0; i < len; i++) {
+        hold[i] = (src[i] > hold[i]) ? src[i] : hold[i];
+    }
+}
+
+static void traceMinHoldScalar(float *hold, const float *src, int len)
+{
+    for(int i = 0; i < len; i++) {
+        hold[i] = (src[i] < hold[i]) ? src[i] : hold[i];
+    }
+}
+
+static void traceAccumulatePowerScalar(float *acc, const float *srcDBm, int len)
+{
+    for(int i = 0; i < len; i++) {
+        acc[i] += exp2f(srcDBm[i] * TRACE_DB_TO_LOG2);
+    }
+}
+
+static double traceSumPowerScalar(const float *srcDBm, int len)
+{
+    double sum = 0.0;
+    for(int i = 0; i < len; i++) {
+        sum += exp2f(srcDBm[i] * TRACE_DB_TO_LOG2);
+    }
+
+    return sum;
+}
+
+static int traceCountAtOrAboveScalar(const float *src, int len, float threshold)
+{
+    int count = 0;
+    for(int i = 0; i < len; i++) {
+        count += (src[i] >= threshold);
+    }
+
+    return count;
+}
+
+// mask must point at the byte holding bin 0 of src, i.e. src starts on a multiple
+//   of 8 bins, as it does for the tail of each vector loop
+static int traceBaselineUpdateScalar(float *mean, float *var, float *count, const float *src, int len,
+                                     const TraceBaselineParams &params, uint8_t *mask, float *score)
+{
+    memset(mask, 0, (len + 7) / 8);
+
+    int detections = 0;
+    for(int i = 0; i < len; i++) {
+        float d = src[i] - mean[i];
+        float v = (var[i] > params.minVar) ? var[i] : params.minVar;
+        if(count[i] >= params.minCount && d > 0.0f && d * d > params.k2 * v) {
+            mask[i >> 3] |= (uint8_t)(1 << (i & 7));
+            score[i] = d / sqrtf(v);
+            detections++;
+            if(params.gate) {
+                continue;
+            }
+        }
+
+        float n = count[i] + 1.0f;
+        float w = (1.0f / n > params.alpha) ? 1.0f / n : params.alpha;
+        count[i] = n;
+        mean[i] += w * d;
+        var[i] = (1.0f - w) * (var[i] + w * d * d);
+    }
+
+    return detections;
+}
+
+#ifdef TRACE_X86
+
+//
+// AVX2 implementations
+//
+
+// 2^x for x in roughly [-126, 126], relative error ~2e-7
+// Rounds x to the nearest integer n, evaluates 2^(x-n) with a polynomial over
+//   [-0.5, 0.5] and scales the result by 2^n through the exponent bits.
+TRACE_AVX2 static inline __m256 traceExp2AVX2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(126.0f));
+    __m256 n = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 f = _mm256_sub_ps(x, n);
+
+    __m256 p = _mm256_set1_ps(1.5403530393381610e-4f);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.3333558146428443e-3f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(9.6181291076284772e-3f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(5.5504108664821580e-2f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(2.4022650695910071e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(6.9314718055994531e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+TRACE_AVX2 static int traceArgMaxAVX2(const float *src, int len)
+{
+    if(len < 16) {
+        return traceArgMaxScalar(src, len);
+    }
+
+    // Each lane tracks the max and the index of the max for every 8th value.
+    // Only replacing on strictly greater keeps the first index within each lane.
+    __m256 vmax = _mm256_loadu_ps(src);
+    __m256i vidx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i vbest = vidx;
+    const __m256i inc = _mm256_set1_epi32(8);
+
+    int i = 8;
+    for(; i + 8 <= len; i += 8) {
+        vidx = _mm256_add_epi32(vidx, inc);
+        __m256 v = _mm256_loadu_ps(src + i);
+        __m256 gt = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+        vmax = _mm256_blendv_ps(vmax, v, gt);
+        vbest = _mm256_blendv_epi8(vbest, vidx, _mm256_castps_si256(gt));
+    }
+
+    float maxVals[8];
+    int32_t maxIdx[8];
+    _mm256_storeu_ps(maxVals, vmax);
+    _mm256_storeu_si256((__m256i*)maxIdx, vbest);
+
+    // Across lanes pick the max, lowest index on ties
+    int peakIndex = maxIdx[0];
+    float peak = maxVals[0];
+    for(int lane = 1; lane < 8; lane++) {
+        if(maxVals[lane] > peak || (maxVals[lane] == peak && maxIdx[lane] < peakIndex)) {
+            peak = maxVals[lane];
+            peakIndex = maxIdx[lane];
+        }
+    }
+
+    for(; i < len; i++) {
+        if(src[i] > peak) {
+            peak = src[i];
+            peakIndex = i;
+        }
+    }
+
+    return peakIndex;
+}
+
+TRACE_AVX2 static int traceSkipBelowAVX2(const float *src, int len, float threshold)
+{
+    const __m256 thr = _mm256_set1_ps(threshold);
+
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(src + i), thr, _CMP_GT_OQ));
+        if(mask) {
+            break;
+        }
+    }
+
+    return i + traceSkipBelowScalar(src + i, len - i, threshold);
+}
+
+TRACE_AVX2 static void traceMaxHoldAVX2(float *hold, const float *src, int len)
+{
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        _mm256_storeu_ps(hold + i, _mm256_max_ps(_mm256_loadu_ps(hold + i), _mm256_loadu_ps(src + i)));
+    }
+
+    traceMaxHoldScalar(hold + i, src + i, len - i);
+}
+
+TRACE_AVX2 static void traceMinHoldAVX2(float *hold, const float *src, int len)
+{
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        _mm256_storeu_ps(hold + i, _mm256_min_ps(_mm256_loadu_ps(hold + i), _mm256_loadu_ps(src + i)));
+    }
+
+    traceMinHoldScalar(hold + i, src + i, len - i);
+}
+
+TRACE_AVX2 static void traceAccumulatePowerAVX2(float *acc, const float *srcDBm, int len)
+{
+    const __m256 k = _mm256_set1_ps(TRACE_DB_TO_LOG2);
+
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        __m256 p = traceExp2AVX2(_mm256_mul_ps(_mm256_loadu_ps(srcDBm + i), k));
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), p));
+    }
+
+    traceAccumulatePowerScalar(acc + i, srcDBm + i, len - i);
+}
+
+TRACE_AVX2 static double traceSumPowerAVX2(const float *srcDBm, int len)
+{
+    const __m256 k = _mm256_set1_ps(TRACE_DB_TO_LOG2);
+    double sum = 0.0;
+
+    int i = 0;
+    while(i + 8 <= len) {
+        int blockEnd = i + TRACE_SUM_BLOCK;
+        if(blockEnd > len) {
+            blockEnd = len;
+        }
+
+        __m256 vsum = _mm256_setzero_ps();
+        for(; i + 8 <= blockEnd; i += 8) {
+            vsum = _mm256_add_ps(vsum, traceExp2AVX2(_mm256_mul_ps(_mm256_loadu_ps(srcDBm + i), k)));
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, vsum);
+        for(int lane = 0; lane < 8; lane++) {
+            sum += lanes[lane];
+        }
+    }
+
+    return sum + traceSumPowerScalar(srcDBm + i, len - i);
+}
+
+TRACE_AVX2 static int traceCountAtOrAboveAVX2(const float *src, int len, float threshold)
+{
+    const __m256 thr = _mm256_set1_ps(threshold);
+
+    // Compare results are -1 for each lane at or above threshold
+    __m256i vcount = _mm256_setzero_si256();
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        __m256 ge = _mm256_cmp_ps(_mm256_loadu_ps(src + i), thr, _CMP_GE_OQ);
+        vcount = _mm256_sub_epi32(vcount, _mm256_castps_si256(ge));
+    }
+
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, vcount);
+    int count = 0;
+    for(int lane = 0; lane < 8; lane++) {
+        count += lanes[lane];
+    }
+
+    return count + traceCountAtOrAboveScalar(src + i, len - i, threshold);
+}
+
+TRACE_AVX2 static int traceBaselineUpdateAVX2(float *mean, float *var, float *count, const float *src, int len,
+                                              const TraceBaselineParams &params, uint8_t *mask, float *score)
+{
+    const __m256 alpha = _mm256_set1_ps(params.alpha);
+    const __m256 k2 = _mm256_set1_ps(params.k2);
+    const __m256 minVar = _mm256_set1_ps(params.minVar);
+    const __m256 minCount = _mm256_set1_ps(params.minCount);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 gate = params.gate ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : zero;
+
+    // Compare results are -1 for each detected lane
+    __m256i vcount = _mm256_setzero_si256();
+    int i = 0;
+    for(; i + 8 <= len; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i);
+        __m256 m = _mm256_loadu_ps(mean + i);
+        __m256 v = _mm256_loadu_ps(var + i);
+        __m256 n = _mm256_loadu_ps(count + i);
+
+        __m256 d = _mm256_sub_ps(x, m);
+        __m256 vf = _mm256_max_ps(v, minVar);
+        __m256 det = _mm256_and_ps(_mm256_cmp_ps(n, minCount, _CMP_GE_OQ), _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+        det = _mm256_and_ps(det, _mm256_cmp_ps(_mm256_mul_ps(d, d), _mm256_mul_ps(k2, vf), _CMP_GT_OQ));
+
+        int bits = _mm256_movemask_ps(det);
+        mask[i >> 3] = (uint8_t)bits;
+        if(bits) {
+            vcount = _mm256_sub_epi32(vcount, _mm256_castps_si256(det));
+            _mm256_maskstore_ps(score + i, _mm256_castps_si256(det), _mm256_div_ps(d, _mm256_sqrt_ps(vf)));
+        }
+
+        // Gated lanes keep their previous state
+        __m256 keep = _mm256_and_ps(det, gate);
+        __m256 n1 = _mm256_add_ps(n, one);
+        __m256 w = _mm256_max_ps(_mm256_div_ps(one, n1), alpha);
+        __m256 m1 = _mm256_fmadd_ps(w, d, m);
+        __m256 v1 = _mm256_mul_ps(_mm256_sub_ps(one, w), _mm256_fmadd_ps(_mm256_mul_ps(w, d), d, v));
+
+        _mm256_storeu_ps(count + i, _mm256_blendv_ps(n1, n, keep));
+        _mm256_storeu_ps(mean + i, _mm256_blendv_ps(m1, m, keep));
+        _mm256_storeu_ps(var + i, _mm256_blendv_ps(v1, v, keep));
+    }
+
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, vcount);
+    int detections = 0;
+    for(int lane = 0; lane < 8; lane++) {
+        detections += lanes[lane];
+    }
+
+    return detections + traceBaselineUpdateScalar(mean + i, var + i, count + i, src + i, len - i,
+        params, mask + (i >> 3), score + i);
+}
+
+//
+// AVX-512 implementations
+//
+
+// See traceExp2AVX2
+TRACE_AVX512 static inline __m512 traceExp2AVX512(__m512 x)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-126.0f)), _mm512_set1_ps(126.0f));
+    __m512 n = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 f = _mm512_sub_ps(x, n);
+
+    __m512 p = _mm512_set1_ps(1.5403530393381610e-4f);
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.3333558146428443e-3f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(9.6181291076284772e-3f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(5.5504108664821580e-2f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(2.4022650695910071e-1f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(6.9314718055994531e-1f));
+    p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f));
+
+    __m512i e = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23);
+    return _mm512_mul_ps(p, _mm512_castsi512_ps(e));
+}
+
+TRACE_AVX512 static int traceArgMaxAVX512(const float *src, int len)
+{
+    if(len < 32) {
+        return traceArgMaxAVX2(src, len);
+    }
+
+    __m512 vmax = _mm512_loadu_ps(src);
+    __m512i vidx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i vbest = vidx;
+    const __m512i inc = _mm512_set1_epi32(16);
+
+    int i = 16;
+    for(; i + 16 <= len; i += 16) {
+        vidx = _mm512_add_epi32(vidx, inc);
+        __m512 v = _mm512_loadu_ps(src + i);
+        __mmask16 gt = _mm512_cmp_ps_mask(v, vmax, _CMP_GT_OQ);
+        vmax = _mm512_mask_mov_ps(vmax, gt, v);
+        vbest = _mm512_mask_mov_epi32(vbest, gt, vidx);
+    }
+
+    float maxVals[16];
+    int32_t maxIdx[16];
+    _mm512_storeu_ps(maxVals, vmax);
+    _mm512_storeu_si512(maxIdx, vbest);
+
+    int peakIndex = maxIdx[0];
+    float peak = maxVals[0];
+    for(int lane = 1; lane < 16; lane++) {
+        if(maxVals[lane] > peak || (maxVals[lane] == peak && maxIdx[lane] < peakIndex)) {
+            peak = maxVals[lane];
+            peakIndex = maxIdx[lane];
+        }
+    }
+
+    for(; i < len; i++) {
+        if(src[i] > peak) {
+            peak = src[i];
+            peakIndex = i;
+        }
+    }
+
+    return peakIndex;
+}
+
+TRACE_AVX512 static int traceSkipBelowAVX512(const float *src, int len, float threshold)
+{
+    const __m512 thr = _mm512_set1_ps(threshold);
+
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        if(_mm512_cmp_ps_mask(_mm512_loadu_ps(src + i), thr, _CMP_GT_OQ)) {
+            break;
+        }
+    }
+
+    return i + traceSkipBelowScalar(src + i, len - i, threshold);
+}
+
+TRACE_AVX512 static void traceMaxHoldAVX512(float *hold, const float *src, int len)
+{
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        _mm512_storeu_ps(hold + i, _mm512_max_ps(_mm512_loadu_ps(hold + i), _mm512_loadu_ps(src + i)));
+    }
+
+    // Remainder is done with a single masked operation
+    __mmask16 m = (__mmask16)((1u << (len - i)) - 1);
+    __m512 h = _mm512_maskz_loadu_ps(m, hold + i);
+    _mm512_mask_storeu_ps(hold + i, m, _mm512_max_ps(h, _mm512_maskz_loadu_ps(m, src + i)));
+}
+
+TRACE_AVX512 static void traceMinHoldAVX512(float *hold, const float *src, int len)
+{
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        _mm512_storeu_ps(hold + i, _mm512_min_ps(_mm512_loadu_ps(hold + i), _mm512_loadu_ps(src + i)));
+    }
+
+    __mmask16 m = (__mmask16)((1u << (len - i)) - 1);
+    __m512 h = _mm512_maskz_loadu_ps(m, hold + i);
+    _mm512_mask_storeu_ps(hold + i, m, _mm512_min_ps(h, _mm512_maskz_loadu_ps(m, src + i)));
+}
+
+TRACE_AVX512 static void traceAccumulatePowerAVX512(float *acc, const float *srcDBm, int len)
+{
+    const __m512 k = _mm512_set1_ps(TRACE_DB_TO_LOG2);
+
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m512 p = traceExp2AVX512(_mm512_mul_ps(_mm512_loadu_ps(srcDBm + i), k));
+        _mm512_storeu_ps(acc + i, _mm512_add_ps(_mm512_loadu_ps(acc + i), p));
+    }
+
+    __mmask16 m = (__mmask16)((1u << (len - i)) - 1);
+    __m512 p = traceExp2AVX512(_mm512_mul_ps(_mm512_maskz_loadu_ps(m, srcDBm + i), k));
+    _mm512_mask_storeu_ps(acc + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, acc + i), p));
+}
+
+TRACE_AVX512 static double traceSumPowerAVX512(const float *srcDBm, int len)
+{
+    const __m512 k = _mm512_set1_ps(TRACE_DB_TO_LOG2);
+    double sum = 0.0;
+
+    int i = 0;
+    while(i + 16 <= len) {
+        int blockEnd = i + TRACE_SUM_BLOCK;
+        if(blockEnd > len) {
+            blockEnd = len;
+        }
+
+        __m512 vsum = _mm512_setzero_ps();
+        for(; i + 16 <= blockEnd; i += 16) {
+            vsum = _mm512_add_ps(vsum, traceExp2AVX512(_mm512_mul_ps(_mm512_loadu_ps(srcDBm + i), k)));
+        }
+        float lanes[16];
+        _mm512_storeu_ps(lanes, vsum);
+        for(int lane = 0; lane < 16; lane++) {
+            sum += lanes[lane];
+        }
+    }
+
+    return sum + traceSumPowerScalar(srcDBm + i, len - i);
+}
+
+TRACE_AVX512 static int traceCountAtOrAboveAVX512(const float *src, int len, float threshold)
+{
+    const __m512 thr = _mm512_set1_ps(threshold);
+
+    const __m512i one = _mm512_set1_epi32(1);
+
+    __m512i vcount = _mm512_setzero_si512();
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __mmask16 ge = _mm512_cmp_ps_mask(_mm512_loadu_ps(src + i), thr, _CMP_GE_OQ);
+        vcount = _mm512_mask_add_epi32(vcount, ge, vcount, one);
+    }
+
+    int32_t lanes[16];
+    _mm512_storeu_si512(lanes, vcount);
+    int count = 0;
+    for(int lane = 0; lane < 16; lane++) {
+        count += lanes[lane];
+    }
+
+    return count + traceCountAtOrAboveScalar(src + i, len - i, threshold);
+}
+
+TRACE_AVX512 static int traceBaselineUpdateAVX512(float *mean, float *var, float *count, const float *src, int len,
+                                                  const TraceBaselineParams &params, uint8_t *mask, float *score)
+{
+    const __m512 alpha = _mm512_set1_ps(params.alpha);
+    const __m512 k2 = _mm512_set1_ps(params.k2);
+    const __m512 minVar = _mm512_set1_ps(params.minVar);
+    const __m512 minCount = _mm512_set1_ps(params.minCount);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i ione = _mm512_set1_epi32(1);
+
+    __m512i vcount = _mm512_setzero_si512();
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m512 x = _mm512_loadu_ps(src + i);
+        __m512 m = _mm512_loadu_ps(mean + i);
+        __m512 v = _mm512_loadu_ps(var + i);
+        __m512 n = _mm512_loadu_ps(count + i);
+
+        __m512 d = _mm512_sub_ps(x, m);
+        __m512 vf = _mm512_max_ps(v, minVar);
+        __mmask16 det = _mm512_cmp_ps_mask(n, minCount, _CMP_GE_OQ);
+        det = _mm512_mask_cmp_ps_mask(det, d, zero, _CMP_GT_OQ);
+        det = _mm512_mask_cmp_ps_mask(det, _mm512_mul_ps(d, d), _mm512_mul_ps(k2, vf), _CMP_GT_OQ);
+
+        // Little endian, the two mask bytes are bins i..i+7 and i+8..i+15
+        uint16_t bits = (uint16_t)det;
+        memcpy(mask + (i >> 3), &bits, sizeof(bits));
+        if(bits) {
+            vcount = _mm512_mask_add_epi32(vcount, det, vcount, ione);
+            _mm512_mask_storeu_ps(score + i, det, _mm512_div_ps(d, _mm512_sqrt_ps(vf)));
+        }
+
+        // Gated lanes keep their previous state
+        __mmask16 update = params.gate ? (__mmask16)~det : (__mmask16)0xFFFF;
+        __m512 n1 = _mm512_add_ps(n, one);
+        __m512 w = _mm512_max_ps(_mm512_div_ps(one, n1), alpha);
+        __m512 m1 = _mm512_fmadd_ps(w, d, m);
+        __m512 v1 = _mm512_mul_ps(_mm512_sub_ps(one, w), _mm512_fmadd_ps(_mm512_mul_ps(w, d), d, v));
+
+        _mm512_mask_storeu_ps(count + i, update, n1);
+        _mm512_mask_storeu_ps(mean + i, update, m1);
+        _mm512_mask_storeu_ps(var + i, update, v1);
+    }
+
+    int32_t lanes[16];
+    _mm512_storeu_si512(lanes, vcount);
+    int detections = 0;
+    for(int lane = 0; lane < 16; lane++) {
+        detections += lanes[lane];
+    }
+
+    return detections + traceBaselineUpdateScalar(mean + i, var + i, count + i, src + i, len - i,
+        params, mask + (i >> 3), score + i);
+}
+
+//
+// CPU feature detection
+//
+
+static bool traceCpuSupports(TraceIsa isa)
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if(regs[0] < 7) {
+        return false;
+    }
+
+    // AVX and FMA, plus OSXSAVE so XCR0 can be checked for OS support of the
+    //   YMM and ZMM registers
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    bool fma = (regs[2] & (1 << 12)) != 0;
+    if(!osxsave || !avx) {
+        return false;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+
+    __cpuidex(regs, 7, 0);
+    bool avx2 = (regs[1] & (1 << 5)) != 0;
+    bool avx512f = (regs[1] & (1 << 16)) != 0;
+
+    bool hasAVX2 = avx2 && fma && ((xcr0 & 0x6) == 0x6);
+    if(isa == TraceIsaAVX2) {
+        return hasAVX2;
+    }
+    if(isa == TraceIsaAVX512) {
+        return hasAVX2 && avx512f && ((xcr0 & 0xE6) == 0xE6);
+    }
+    return true;
+#else
+    __builtin_cpu_init();
+    if(isa == TraceIsaAVX2) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    if(isa == TraceIsaAVX512) {
+        return __builtin_cpu_supports("avx512f") && traceCpuSupports(TraceIsaAVX2);
+    }
+    return true;
+#endif
+}
+
+#endif // TRACE_X86
+
+static TraceKernels traceMakeKernels(TraceIsa isa)
+{
+    TraceKernels k;
+
+#ifdef TRACE_X86
+    if(isa >= TraceIsaAVX512 && traceCpuSupports(TraceIsaAVX512)) {
+        k.isa = TraceIsaAVX512;
+        k.argMax = traceArgMaxAVX512;
+        k.skipBelow = traceSkipBelowAVX512;
+        k.maxHold = traceMaxHoldAVX512;
+        k.minHold = traceMinHoldAVX512;
+        k.accumulatePower = traceAccumulatePowerAVX512;
+        k.sumPower = traceSumPowerAVX512;
+        k.countAtOrAbove = traceCountAtOrAboveAVX512;
+        k.baselineUpdate = traceBaselineUpdateAVX512;
+        return k;
+    }
+
+    if(isa >= TraceIsaAVX2 && traceCpuSupports(TraceIsaAVX2)) {
+        k.isa = TraceIsaAVX2;
+        k.argMax = traceArgMaxAVX2;
+        k.skipBelow = traceSkipBelowAVX2;
+        k.maxHold = traceMaxHoldAVX2;
+        k.minHold = traceMinHoldAVX2;
+        k.accumulatePower = traceAccumulatePowerAVX2;
+        k.sumPower = traceSumPowerAVX2;
+        k.countAtOrAbove = traceCountAtOrAboveAVX2;
+        k.baselineUpdate = traceBaselineUpdateAVX2;
+        return k;
+    }
+#endif
+
+    k.isa = TraceIsaScalar;
+    k.argMax = traceArgMaxScalar;
+    k.skipBelow = traceSkipBelowScalar;
+    k.maxHold = traceMaxHoldScalar;
+    k.minHold = traceMinHoldScalar;
+    k.accumulatePower = traceAccumulatePowerScalar;
+    k.sumPower = traceSumPowerScalar;
+    k.countAtOrAbove = traceCountAtOrAboveScalar;
+    k.baselineUpdate = traceBaselineUpdateScalar;
+    return k;
+}
+
+static TraceKernels &traceKernels()
+{
+    // Thread safe initialization on first use
+    static TraceKernels kernels = traceMakeKernels(TraceIsaAVX512);
+    return kernels;
+}
+
+TraceIsa traceGetIsa()
+{
+    return traceKernels().isa;
+}
+
+TraceIsa traceSetIsa(TraceIsa isa)
+{
+    traceKernels() = traceMakeKernels(isa);
+    return traceKernels().isa;
+}
+
+int traceArgMax(const float *src, int len)
+{
+    return traceKernels().argMax(src, len);
+}
+
+int traceFindPeaks(const float *src, int len, int maxPeaks, int *peakIndices)
+{
+    if(len <= 0 || maxPeaks <= 0) {
+        return 0;
+    }
+    if(len == 1) {
+        peakIndices[0] = 0;
+        return 1;
+    }
+
+    const TraceKernels &k = traceKernels();
+
+    // peakIndices is kept sorted by amplitude, highest first. Once it is full only
+    //   values above the lowest peak can be a new peak, and the vector kernels are
+    //   used to skip over the runs of values below it, which is most of a trace.
+    int found = 0;
+    int i = 0;
+    while(i < len) {
+        if(found == maxPeaks) {
+            i += k.skipBelow(src + i, len - i, src[peakIndices[found - 1]]);
+            if(i >= len) {
+                break;
+            }
+        }
+
+        float v = src[i];
+        bool isPeak = (i == 0 || v > src[i - 1]) && (i == len - 1 || v >= src[i + 1]);
+        if(isPeak && (found < maxPeaks || v > src[peakIndices[found - 1]])) {
+            // Insert in sorted position, dropping the lowest peak if full.
+            // Ties keep the earlier peak first.
+            int pos = (found < maxPeaks) ? found++ : found - 1;
+            while(pos > 0 && src[peakIndices[pos - 1]] < v) {
+                peakIndices[pos] = peakIndices[pos - 1];
+                pos--;
+            }
+            peakIndices[pos] = i;
+        }
+
+        i++;
+    }
+
+    return found;
+}
+
+void traceMaxHold(float *hold, const float *src, int len)
+{
+    traceKernels().maxHold(hold, src, len);
+}
+
+void traceMinHold(float *hold, const float *src, int len)
+{
+    traceKernels().minHold(hold, src, len);
+}
+
+void traceAccumulatePower(float *acc, const float *srcDBm, int len)
+{
+    traceKernels().accumulatePower(acc, srcDBm, len);
+}
+
+void tracePowerAverageToDBm(float *dstDBm, const float *acc, int count, int len)
+{
+    float scale = (count > 0) ? 1.0f / count : 0.0f;
+    for(int i = 0; i < len; i++) {
+        dstDBm[i] = 10.0f * log10f(acc[i] * scale);
+    }
+}
+
+float traceMeanPowerDBm(const float *srcDBm, int len)
+{
+    if(len <= 0) {
+        return -INFINITY;
+    }
+
+    return (float)(10.0 * log10(traceKernels().sumPower(srcDBm, len) / len));
+}
+
+int traceCountAtOrAbove(const float *src, int len, float threshold)
+{
+    return traceKernels().countAtOrAbove(src, len, threshold);
+}
+
+int traceBaselineUpdate(float *mean, float *var, float *count, const float *src, int len,
+                        const TraceBaselineParams &params, uint8_t *mask, float *score)
+{
+    return traceKernels().baselineUpdate(mean, var, count, src, len, params, mask, score);
+}
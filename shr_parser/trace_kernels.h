@@ -0,0 +1,81 @@
+// Copyright Signal Hound 2018
+
+// Vectorized reductions over float traces.
+// These operate on plain float arrays and can be used on the sweeps returned from
+//   SHRGetSweep/SHRGetMappedSweep, bbFetchTrace_32f and smGetSweep alike.
+// The fastest implementation supported by the CPU (AVX-512, AVX2 or scalar) is
+//   selected the first time any of the functions are called.
+
+#pragma once
+
+#include <cstdint>
+
+enum TraceIsa {
+    TraceIsaScalar = 0,
+    TraceIsaAVX2 = 1,
+    TraceIsaAVX512 = 2
+};
+
+// Returns the instruction set the kernels are currently using.
+TraceIsa traceGetIsa();
+// Force the kernels to use a specific instruction set, useful for benchmarking
+//   against the scalar implementation. If the CPU does not support the requested
+//   instruction set, the best supported one below it is used.
+// Returns the instruction set actually selected.
+// Not thread safe, do not call while the kernels are in use on other threads.
+TraceIsa traceSetIsa(TraceIsa isa);
+
+// Returns the index of the largest value in src, the first one if there are
+//   several. Returns -1 if len is zero.
+int traceArgMax(const float *src, int len);
+
+// Finds the maxPeaks highest local maxima in src.
+// A local maximum is a value larger than its left neighbor and not less than its
+//   right neighbor, the first and last values only need to exceed their one neighbor.
+// peakIndices = at least maxPeaks ints, stores the peak indices sorted by amplitude,
+//   highest first
+// Returns the number of peaks found, at most maxPeaks.
+int traceFindPeaks(const float *src, int len, int maxPeaks, int *peakIndices);
+
+// hold[i] = max(hold[i], src[i])
+void traceMaxHold(float *hold, const float *src, int len);
+// hold[i] = min(hold[i], src[i])
+void traceMinHold(float *hold, const float *src, int len);
+
+// Averaging of log (dBm) traces in linear power.
+// Zero acc, call traceAccumulatePower for each trace, then call
+//   tracePowerAverageToDBm with the number of traces accumulated.
+// acc[i] += 10^(srcDBm[i]/10), acc is in mW
+void traceAccumulatePower(float *acc, const float *srcDBm, int len);
+// dstDBm[i] = 10*log10(acc[i]/count), dst may equal acc
+void tracePowerAverageToDBm(float *dstDBm, const float *acc, int count, int len);
+
+// Returns the average power over all values of a dBm trace, in dBm.
+float traceMeanPowerDBm(const float *srcDBm, int len);
+
+// Returns the number of values in src at or above threshold.
+int traceCountAtOrAbove(const float *src, int len, float threshold);
+
+// Per-bin running baseline, see trace_baseline.h for a complete detector.
+// For each bin, with d = src - mean:
+//   detected if count >= minCount and d > 0 and d^2 > k2 * max(var, minVar)
+//   otherwise (or always if gate is false) the baseline is updated with
+//   w = max(1/(count+1), alpha), count += 1, mean += w*d, var = (1-w)*(var + w*d^2)
+// With alpha = 0 this is Welford's running mean/variance over every trace, with
+//   alpha > 0 it becomes an exponentially weighted mean/variance once count
+//   exceeds 1/alpha.
+struct TraceBaselineParams {
+    float alpha; // EWMA weight, 0 for cumulative statistics
+    float k2; // Detection threshold in variances, (N sigma)^2
+    float minVar; // Variance floor, avoids detections on bins with no variation
+    float minCount; // Bins are not tested until this many traces have been accumulated
+    bool gate; // Detected bins do not update the baseline
+};
+
+// mean/var/count = per-bin state, len floats each, zero to start
+// mask = (len+7)/8 bytes, bit (i%8) of mask[i/8] is set if bin i was detected
+// score = len floats, score[i] = d/sqrt(max(var, minVar)) for detected bins,
+//   not written for other bins
+// Returns the number of detected bins.
+int traceBaselineUpdate(float *mean, float *var, float *count, const float *src, int len,
+                        const TraceBaselineParams &params, uint8_t *mask, float *score);